@@ -0,0 +1,114 @@
+/**********************************************************************
+* Worker placement (DispatcherConfig::affinity) against the kind of work.
+*
+* Each policy runs the same fixed amount of work: compute bound jobs
+* (an xorshift loop that stays in registers) and memory bound jobs
+* (summing a slice of a buffer far bigger than the caches). Physical
+* cores gets one worker per core; logical cores adds one on every SMT
+* sibling, which helps when jobs stall on memory and much less when
+* they keep the core's ALUs busy. Inherit leaves the workers unpinned.
+* Without SMT the first two place the same workers.
+*
+* Usage: HustleBench_AffinityPlacement [buffer MB]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "Work.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int ComputeJobs = 4096;
+static const int ComputeRounds = 20000;
+static const int MemoryPasses = 4;
+static const size_t SliceBytes = 256 * 1024;
+
+static void ComputeJob(void* pUserData) {
+	Sink(XorShiftWork((uint32_t)(uintptr_t)pUserData, ComputeRounds));
+}
+
+static void MemoryJob(void* pUserData) {
+	const uint64_t* pSlice = (const uint64_t*)pUserData;
+	uint64_t iSum = 0;
+	for (size_t i = 0; i < SliceBytes / sizeof(uint64_t); i++)
+		iSum += pSlice[i];
+	Sink(iSum);
+}
+
+static double RunJobs(const std::vector<JobDecl>& jobs, int iPasses) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	auto start = Clock::now();
+	for (int i = 0; i < iPasses; i++) {
+		JobCounter counter;
+		dispatcher.AddJobs(jobs, &counter);
+		dispatcher.WaitForCounter(&counter);
+	}
+
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool Measure(const char* szName, const AffinityPolicy& policy, uint64_t* pBuffer, size_t bufferBytes) {
+
+	DispatcherConfig config;
+	config.affinity = policy;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << szName << "\tfailed: " << dispatcher.GetLastError() << std::endl;
+		return false;
+	}
+
+	std::vector<JobDecl> computeJobs(ComputeJobs);
+	for (int i = 0; i < ComputeJobs; i++)
+		computeJobs[i] = { ComputeJob, (void*)(uintptr_t)i };
+
+	size_t iSlices = bufferBytes / SliceBytes;
+	std::vector<JobDecl> memoryJobs(iSlices);
+	for (size_t i = 0; i < iSlices; i++)
+		memoryJobs[i] = { MemoryJob, (uint8_t*)pBuffer + i * SliceBytes };
+
+	// Warm up the pools
+	RunJobs(computeJobs, 1);
+
+	double dComputeSeconds = RunJobs(computeJobs, 1);
+	double dMemorySeconds = RunJobs(memoryJobs, MemoryPasses);
+
+	std::cout << szName << "\t" << dispatcher.WorkerThreadCount() << "\t" << ComputeJobs / dComputeSeconds / 1000.0 << "\t\t"
+			  << (double)iSlices * SliceBytes * MemoryPasses / dMemorySeconds / 1e9 << std::endl;
+
+	dispatcher.Shutdown();
+	return true;
+}
+
+int main(int argc, char** argv) {
+
+	size_t bufferMB = 512;
+	if (argc > 1)
+		bufferMB = std::stoul(argv[1]);
+
+	size_t bufferBytes = bufferMB * 1024 * 1024;
+	std::unique_ptr<uint64_t[]> pBuffer(new uint64_t[bufferBytes / sizeof(uint64_t)]);
+	for (size_t i = 0; i < bufferBytes / sizeof(uint64_t); i++)
+		pBuffer[i] = i;
+
+	Topology topology = Topology::Detect();
+	std::cout << "CPUs: " << topology.GetCpuCount() << ", cores: " << topology.GetCores().size() << ", allowed: "
+			  << AffinityPolicy::GetAllowedCpus().size() << ", cgroup quota: " << AffinityPolicy::GetCpuQuota() << std::endl;
+
+	std::cout << "policy\t\tworkers\tcompute kjobs/s\tmemory GB/s" << std::endl;
+	if (Measure("physical cores", AffinityPolicy::PhysicalCores(), pBuffer.get(), bufferBytes) == false ||
+		Measure("logical cores", AffinityPolicy::LogicalCores(), pBuffer.get(), bufferBytes) == false ||
+		Measure("inherit\t", AffinityPolicy::Inherit(), pBuffer.get(), bufferBytes) == false)
+		return -1;
+
+	return 0;
+}
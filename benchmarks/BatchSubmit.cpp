@@ -0,0 +1,98 @@
+/**********************************************************************
+* Job submission throughput: AddJob() once per job versus AddJobs()
+* with batches of 1, 64 and 4096.
+*
+* Only the time spent inside the submission calls is counted. Jobs are
+* submitted in windows of 4096, waiting for each window to drain (off
+* the clock) before the next one, so the pool never has to grow. Runs
+* once from the main thread (injection queues) and once from inside a
+* job (the worker's own deques).
+*
+* Usage: HustleBench_BatchSubmit [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int JobCount = 1 << 20;
+static const int WindowSize = 4096;
+static const int BatchSizes[] = { 1, 64, 4096 };
+
+static void EmptyJob(void*) {
+}
+
+/**
+ * @brief Submission rate in jobs per second, for one batch size. iBatchSize 0 means AddJob() per job.
+*/
+static double Submit(int iBatchSize) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	std::vector<JobDecl> jobs(WindowSize);
+	for (auto& job : jobs)
+		job = { EmptyJob, nullptr };
+
+	JobCounter counter;
+	Clock::duration submitTime = Clock::duration::zero();
+
+	for (int iWindow = 0; iWindow < JobCount; iWindow += WindowSize) {
+
+		auto start = Clock::now();
+		if (iBatchSize == 0) {
+			counter.Increment(WindowSize);
+			for (int i = 0; i < WindowSize; i++)
+				dispatcher.AddJob(EmptyJob, nullptr, &counter);
+		}
+		else {
+			for (int i = 0; i < WindowSize; i += iBatchSize)
+				dispatcher.AddJobs(jobs.data() + i, iBatchSize, &counter);
+		}
+		submitTime += Clock::now() - start;
+
+		dispatcher.WaitForCounter(&counter);
+	}
+
+	return JobCount / std::chrono::duration<double>(submitTime).count();
+}
+
+static void PrintTable() {
+	std::cout << "AddJob\t" << (int64_t)Submit(0) << std::endl;
+	for (int iBatchSize : BatchSizes)
+		std::cout << "AddJobs " << iBatchSize << "\t" << (int64_t)Submit(iBatchSize) << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+	config.iJobPoolSize = WindowSize * 2;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "Workers: " << dispatcher.WorkerThreadCount() << std::endl << std::endl;
+
+	std::cout << "From the main thread" << std::endl << "call\t\tjobs/s" << std::endl;
+	PrintTable();
+
+	std::cout << std::endl << "From inside a job" << std::endl << "call\t\tjobs/s" << std::endl;
+	dispatcher.WaitForJob(dispatcher.AddJob([]() { PrintTable(); }));
+
+	dispatcher.Shutdown();
+	return 0;
+}
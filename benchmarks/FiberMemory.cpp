@@ -0,0 +1,131 @@
+/**********************************************************************
+* Memory cost of a wide fan-out with every fiber parked at once.
+*
+* N jobs each touch a few KB of stack and then wait on a shared gate
+* counter, so N fibers are alive together. This is run once with the
+* old configuration (every fiber gets a 1 MB stack) and once with a
+* DispatcherConfig of 64 KB small fibers, each in its own process.
+* Reports reserved address space (VmSize) and peak resident memory
+* (VmHWM) from /proc/self/status.
+*
+* Usage: HustleBench_FiberMemory [job count] [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace Hustle;
+
+static const size_t TouchedStackBytes = 8 * 1024;
+
+static std::atomic<int> s_Started;
+static JobCounter s_Gate;
+
+// Value of a "Name:   1234 kB" line in /proc/self/status, in MB
+static double StatusMB(const char* szName) {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, strlen(szName), szName) == 0)
+			return std::stod(line.substr(strlen(szName) + 1)) / 1024.0;
+	}
+	return -1.0;
+}
+
+static void ParkedJob(void*) {
+
+	// Use some stack, like a real job would
+	volatile char buffer[TouchedStackBytes];
+	for (size_t i = 0; i < sizeof(buffer); i += 64)
+		buffer[i] = (char)i;
+
+	s_Started++;
+	Dispatcher::GetInstance().WaitForCounter(&s_Gate);
+}
+
+static void Run(const char* szMode, bool bStackClasses, int iJobCount, int iWorkers) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	bool bInit;
+	if (bStackClasses) {
+		DispatcherConfig config;
+		config.fiberPools[(int)StackClass::Small] = { iJobCount, 64 * 1024 };
+		config.fiberPools[(int)StackClass::Large] = { 16, 512 * 1024 };
+		config.iJobPoolSize = iJobCount;
+		config.iWorkerThreadCount = iWorkers;
+		bInit = dispatcher.Init(config);
+	}
+	else {
+		bInit = dispatcher.Init(iJobCount, iJobCount, iWorkers);
+	}
+
+	if (bInit == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	s_Gate.SetValue(1);
+	JobCounter done;
+	for (int i = 0; i < iJobCount; i++) {
+		done.Increment();
+		dispatcher.AddJob(ParkedJob, nullptr, &done);
+	}
+
+	// Everything is parked on the gate at this point
+	while (s_Started < iJobCount)
+		Platform::ThreadYield();
+
+	s_Gate.Decrement();
+	dispatcher.WaitForCounter(&done);
+
+	double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << szMode << "\t" << dispatcher.GetFiberPoolTotal() << "\t" << (int64_t)StatusMB("VmSize") << "\t\t"
+		<< (int64_t)StatusMB("VmHWM") << "\t\t" << dSeconds * 1000.0 << std::endl;
+
+	dispatcher.Shutdown();
+}
+
+int main(int argc, char** argv) {
+
+	int iJobCount = 10000;
+	int iWorkers = -1;
+	if (argc > 1)
+		iJobCount = std::stoi(argv[1]);
+	if (argc > 2)
+		iWorkers = std::stoi(argv[2]);
+
+	std::cout << "Parked jobs: " << iJobCount << std::endl;
+	std::cout << "fibers\t\ttotal\tVmSize (MB)\tVmHWM (MB)\ttime (ms)" << std::endl;
+
+	// Each configuration in a fresh process, so the numbers don't include the other one
+	for (int iMode = 0; iMode < 2; iMode++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			if (iMode == 0)
+				Run("1 MB (old)", false, iJobCount, iWorkers);
+			else
+				Run("64 KB small", true, iJobCount, iWorkers);
+			std::cout.flush();
+			_exit(0);
+		}
+
+		int iStatus;
+		waitpid(pid, &iStatus, 0);
+		if (WIFEXITED(iStatus) == false)
+			std::cout << "Run " << iMode << " failed" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+/**********************************************************************
+* Fiber context switch latency: Hustle's compiled in backend against a
+* plain getcontext()/swapcontext() ping-pong. swapcontext() saves and
+* restores the signal mask, which costs a system call per switch.
+**********************************************************************/
+#include "FiberContext.h"
+
+#include <chrono>
+#include <iostream>
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+
+#include <sys/mman.h>
+#include <ucontext.h>
+
+using namespace Hustle;
+
+static const int SwitchCount = 2000000;
+static const size_t StackSize = 64 * 1024;
+
+// Hustle context ping-pong
+static Context::FiberContext* s_pMainContext = nullptr;
+static Context::FiberContext* s_pPingContext = nullptr;
+
+static void PingEntryPoint(void*) {
+	while (true)
+		Context::SwitchTo(s_pMainContext);
+}
+
+static double BenchHustleContext() {
+
+	s_pMainContext = Context::ConvertThread();
+	s_pPingContext = Context::Create(StackSize, PingEntryPoint, nullptr);
+
+	// Warm up
+	for (int i = 0; i < 1000; i++)
+		Context::SwitchTo(s_pPingContext);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < SwitchCount; i++)
+		Context::SwitchTo(s_pPingContext);
+	auto end = std::chrono::steady_clock::now();
+
+	Context::Destroy(s_pPingContext);
+	Context::Destroy(s_pMainContext);
+
+	// Every iteration is a switch in and a switch back out
+	return std::chrono::duration<double, std::nano>(end - start).count() / (SwitchCount * 2.0);
+}
+
+// ucontext ping-pong
+static ucontext_t s_MainUContext;
+static ucontext_t s_PingUContext;
+
+static void PingUContextEntryPoint() {
+	while (true)
+		swapcontext(&s_PingUContext, &s_MainUContext);
+}
+
+static double BenchUContext() {
+
+	void* pStack = mmap(nullptr, StackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	getcontext(&s_PingUContext);
+	s_PingUContext.uc_stack.ss_sp = pStack;
+	s_PingUContext.uc_stack.ss_size = StackSize;
+	s_PingUContext.uc_link = nullptr;
+	makecontext(&s_PingUContext, PingUContextEntryPoint, 0);
+
+	// Warm up
+	for (int i = 0; i < 1000; i++)
+		swapcontext(&s_MainUContext, &s_PingUContext);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < SwitchCount; i++)
+		swapcontext(&s_MainUContext, &s_PingUContext);
+	auto end = std::chrono::steady_clock::now();
+
+	munmap(pStack, StackSize);
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / (SwitchCount * 2.0);
+}
+
+int main() {
+
+	double dHustleNs = BenchHustleContext();
+	double dUContextNs = BenchUContext();
+
+	std::cout << "Fiber switch latency (" << SwitchCount * 2 << " switches)" << std::endl;
+	std::cout << "  Hustle (" << Context::BackendName() << "): " << dHustleNs << " ns/switch" << std::endl;
+	std::cout << "  swapcontext: " << dUContextNs << " ns/switch" << std::endl;
+	std::cout << "  speedup: " << dUContextNs / dHustleNs << "x" << std::endl;
+
+	return 0;
+}
+
+#else
+
+int main() {
+	std::cout << "The ucontext comparison is only available on POSIX platforms" << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,165 @@
+/**********************************************************************
+* Fan-out/gather latency: N jobs that each compute a value, gathered by
+* a parent job, with typed futures against the hand-rolled version.
+*
+*   counter  - results written through pUserData into an array, one
+*              JobCounter for the group (what callers did before
+*              JobFuture)
+*   Get()    - AddJob<R>() per child, then Get() each future in turn
+*   WhenAll  - AddJob<R>() per child, WhenAll(), then Get() each
+*   WhenAny  - time until the first child's result is in
+*
+* The time from the first AddJob() to the sum being ready is recorded
+* for every round, inside a job so waits park the parent's fiber.
+*
+* Usage: HustleBench_FutureGather [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/JobFuture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int FanOuts[] = { 1, 8, 64, 512 };
+static const int ChildWork = 256;
+
+enum class Gather {
+	Counter,
+	Get,
+	WhenAll,
+	WhenAny,
+	Count
+};
+
+static const char* s_szGatherNames[] = { "counter", "Get()", "WhenAll", "WhenAny" };
+
+// A little arithmetic so each child isn't empty
+static int64_t ChildValue(int i) {
+	int64_t iValue = i;
+	for (int j = 0; j < ChildWork; j++)
+		iValue = iValue * 6364136223846793005ll + 1442695040888963407ll;
+	return iValue >> 32;
+}
+
+struct CounterChild {
+	int iIndex;
+	int64_t* pResult;
+};
+
+static void CounterChildJob(void* pUserData) {
+	CounterChild* pChild = (CounterChild*)pUserData;
+	*pChild->pResult = ChildValue(pChild->iIndex);
+}
+
+/**
+ * @brief One fan-out and gather, in microseconds
+*/
+static double RunRound(Gather eGather, int iFanOut, std::vector<CounterChild>& children, std::vector<int64_t>& results,
+					   std::vector<JobFuture<int64_t>>& futures) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	volatile int64_t iSum = 0;
+
+	auto start = Clock::now();
+	switch (eGather) {
+	case Gather::Counter: {
+		JobCounter counter;
+		counter.Increment(iFanOut);
+		for (int i = 0; i < iFanOut; i++) {
+			children[i] = { i, &results[i] };
+			dispatcher.AddJob(CounterChildJob, &children[i], &counter);
+		}
+		dispatcher.WaitForCounter(&counter);
+		for (int i = 0; i < iFanOut; i++)
+			iSum += results[i];
+		break;
+	}
+
+	case Gather::Get:
+	case Gather::WhenAll:
+		for (int i = 0; i < iFanOut; i++)
+			futures[i] = dispatcher.AddJob<int64_t>([i]() { return ChildValue(i); });
+		if (eGather == Gather::WhenAll)
+			WhenAll(futures);
+		for (int i = 0; i < iFanOut; i++)
+			iSum += futures[i].Get();
+		break;
+
+	case Gather::WhenAny: {
+		for (int i = 0; i < iFanOut; i++)
+			futures[i] = dispatcher.AddJob<int64_t>([i]() { return ChildValue(i); });
+		iSum += futures[WhenAny(futures)].Get();
+		double dUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+		// The rest finish off the clock
+		for (auto& future : futures) {
+			if (future.IsValid())
+				iSum += future.Get();
+		}
+		return dUs;
+	}
+
+	default:
+		break;
+	}
+
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static void RunTable() {
+
+	for (int iFanOut : FanOuts) {
+
+		// Fewer rounds for the wide fan-outs, roughly the same number of child jobs for each
+		int iRounds = (std::max)(200, 100000 / iFanOut);
+
+		std::vector<CounterChild> children(iFanOut);
+		std::vector<int64_t> results(iFanOut);
+		std::vector<JobFuture<int64_t>> futures(iFanOut);
+
+		for (int iGather = 0; iGather < (int)Gather::Count; iGather++) {
+
+			// Warm up the pools
+			for (int i = 0; i < 10; i++)
+				RunRound((Gather)iGather, iFanOut, children, results, futures);
+
+			std::vector<double> latencies(iRounds);
+			for (int i = 0; i < iRounds; i++)
+				latencies[i] = RunRound((Gather)iGather, iFanOut, children, results, futures);
+			std::sort(latencies.begin(), latencies.end());
+
+			std::cout << iFanOut << "\t" << s_szGatherNames[iGather] << "\t\t" << latencies[iRounds / 2] << "\t\t"
+				<< latencies[iRounds * 99 / 100] << std::endl;
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(100, 4096, iWorkers) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "Workers: " << dispatcher.WorkerThreadCount() << std::endl << std::endl;
+	std::cout << "fan-out\tgather\t\tp50 (us)\tp99 (us)" << std::endl;
+
+	auto hJob = dispatcher.AddJob([]() { RunTable(); });
+	dispatcher.WaitForJob(hJob);
+
+	dispatcher.Shutdown();
+	return 0;
+}
@@ -0,0 +1,94 @@
+/**********************************************************************
+* Idle CPU usage and wake up latency for each IdlePolicy.
+*
+* For every policy the Dispatcher is started and left with nothing to
+* do, and the process CPU time is sampled over a quiet period. Then the
+* main thread repeatedly waits long enough for the workers to back off
+* completely, submits one job and records how long it took to start.
+*
+* Usage: HustleBench_IdleStrategy [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int ProbeCount = 200;
+static const auto QuietPeriod = std::chrono::milliseconds(500);
+static const auto ProbeGap = std::chrono::milliseconds(5);
+
+struct Probe {
+	Clock::time_point submitted;
+	double dLatencyUs;
+};
+
+static void ProbeJob(void* pUserData) {
+	Probe* pProbe = (Probe*)pUserData;
+	pProbe->dLatencyUs = std::chrono::duration<double, std::micro>(Clock::now() - pProbe->submitted).count();
+}
+
+static void Run(const char* szName, IdlePolicy policy, int iWorkers) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+	config.idlePolicy = policy;
+
+	// The probe has to be started by a worker, not by this thread while it waits
+	config.bHelpWhileWaiting = false;
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return;
+	}
+
+	// Idle CPU, as a percentage of one core per worker
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	std::clock_t cpuStart = std::clock();
+	auto wallStart = Clock::now();
+	std::this_thread::sleep_for(QuietPeriod);
+	double dCpuSeconds = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+	double dWallSeconds = std::chrono::duration<double>(Clock::now() - wallStart).count();
+	double dIdleCpu = 100.0 * dCpuSeconds / dWallSeconds / dispatcher.WorkerThreadCount();
+
+	// Wake up latency from a fully idle state
+	std::vector<Probe> probes(ProbeCount);
+	for (auto& probe : probes) {
+		std::this_thread::sleep_for(ProbeGap);
+		probe.submitted = Clock::now();
+		dispatcher.WaitForJob(dispatcher.AddJob(ProbeJob, &probe));
+	}
+
+	std::vector<double> latencies;
+	for (auto& probe : probes)
+		latencies.push_back(probe.dLatencyUs);
+	std::sort(latencies.begin(), latencies.end());
+
+	std::cout << szName << "\t" << dIdleCpu << "\t\t" << latencies[ProbeCount / 2] << "\t\t" << latencies[ProbeCount * 99 / 100] << std::endl;
+
+	dispatcher.Shutdown();
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	std::cout << "policy\tidle CPU (% per worker)\twake p50 (us)\twake p99 (us)" << std::endl;
+	Run("spin", IdlePolicy::Spin(), iWorkers);
+	Run("yield", IdlePolicy::SpinThenYield(), iWorkers);
+	Run("sleep", IdlePolicy::Sleep(), iWorkers);
+
+	return 0;
+}
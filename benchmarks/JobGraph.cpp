@@ -0,0 +1,210 @@
+/**********************************************************************
+* Running a layered dependency graph every frame, three ways:
+*
+*  graph    - JobGraph declared once, RunGraph() every frame
+*  barrier  - AddJobs() a layer, WaitForCounter(), next layer
+*  blocking - every node queued up front as a job that waits on the
+*             counters of its predecessors, parking a fiber per
+*             unfinished dependency
+*
+* Each node depends on two nodes of the layer before it and does about
+* a microsecond of arithmetic. Shapes are wide (1024 x 4), square
+* (64 x 64) and deep (4 x 1024). Reports time per node and fiber
+* switches per node.
+*
+* Usage: HustleBench_JobGraph [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/JobGraph.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+static const int FrameCount = 20;
+static const int NodeWork = 200;
+
+struct Shape {
+	const char* szName;
+	int iWidth;
+	int iDepth;
+};
+
+static const Shape Shapes[] = {
+	{ "wide", 1024, 4 },
+	{ "square", 64, 64 },
+	{ "deep", 4, 1024 },
+};
+
+struct Node {
+	uint32_t uValue;
+	int iPredecessors[2];
+	int iPredecessorCount;
+	JobCounter done;			// Only used by the blocking version
+	struct Frame* pFrame;
+};
+
+struct Frame {
+	int iWidth;
+	int iDepth;
+	std::unique_ptr<Node[]> pNodes;
+};
+
+static void DoWork(Node* pNode) {
+	uint32_t uValue = pNode->uValue | 1;
+	for (int i = 0; i < NodeWork; i++) {
+		uValue ^= uValue << 13;
+		uValue ^= uValue >> 17;
+		uValue ^= uValue << 5;
+	}
+	pNode->uValue = uValue;
+}
+
+static void WorkJob(void* pUserData) {
+	DoWork((Node*)pUserData);
+}
+
+static void BlockingJob(void* pUserData) {
+	Node* pNode = (Node*)pUserData;
+	for (int i = 0; i < pNode->iPredecessorCount; i++)
+		Dispatcher::GetInstance().WaitForCounter(&pNode->pFrame->pNodes[pNode->iPredecessors[i]].done);
+
+	DoWork(pNode);
+	pNode->done.Decrement();
+}
+
+static void BuildFrame(Frame& frame, const Shape& shape) {
+	frame.iWidth = shape.iWidth;
+	frame.iDepth = shape.iDepth;
+	frame.pNodes.reset(new Node[shape.iWidth * shape.iDepth]);
+
+	for (int iLayer = 0; iLayer < shape.iDepth; iLayer++) {
+		for (int i = 0; i < shape.iWidth; i++) {
+			Node& node = frame.pNodes[iLayer * shape.iWidth + i];
+			node.uValue = iLayer * shape.iWidth + i;
+			node.pFrame = &frame;
+			node.iPredecessorCount = 0;
+
+			if (iLayer > 0) {
+				int iBefore = (iLayer - 1) * shape.iWidth;
+				node.iPredecessors[node.iPredecessorCount++] = iBefore + i;
+				int iOther = iBefore + (i * 7 + 3) % shape.iWidth;
+				if (iOther != iBefore + i)
+					node.iPredecessors[node.iPredecessorCount++] = iOther;
+			}
+		}
+	}
+}
+
+struct Result {
+	double dNsPerNode;
+	double dSwitchesPerNode;
+};
+
+template<class F>
+static Result Measure(int iNodeCount, F&& runFrame) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	// Warm up the pools
+	runFrame();
+
+	uint64_t iSwitches = dispatcher.GetFiberSwitchCount();
+	auto start = std::chrono::steady_clock::now();
+
+	for (int iFrame = 0; iFrame < FrameCount; iFrame++)
+		runFrame();
+
+	double dNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	uint64_t iSwitchCount = dispatcher.GetFiberSwitchCount() - iSwitches;
+
+	double dNodes = (double)iNodeCount * FrameCount;
+	return { dNs / dNodes, iSwitchCount / dNodes };
+}
+
+static void Run(const Shape& shape) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	Frame frame;
+	BuildFrame(frame, shape);
+	int iNodeCount = shape.iWidth * shape.iDepth;
+
+	// Declared once
+	JobGraph graph;
+	for (int i = 0; i < iNodeCount; i++)
+		graph.AddNode(WorkJob, &frame.pNodes[i]);
+	for (int i = 0; i < iNodeCount; i++) {
+		for (int p = 0; p < frame.pNodes[i].iPredecessorCount; p++)
+			graph.AddEdge(frame.pNodes[i].iPredecessors[p], i);
+	}
+
+	Result graphResult = Measure(iNodeCount, [&]() {
+		JobCounter counter;
+		dispatcher.RunGraph(graph, &counter);
+		dispatcher.WaitForCounter(&counter);
+	});
+
+	std::vector<JobDecl> layer(shape.iWidth);
+	Result barrierResult = Measure(iNodeCount, [&]() {
+		JobCounter counter;
+		for (int iLayer = 0; iLayer < shape.iDepth; iLayer++) {
+			for (int i = 0; i < shape.iWidth; i++)
+				layer[i] = { WorkJob, &frame.pNodes[iLayer * shape.iWidth + i] };
+
+			dispatcher.AddJobs(layer, &counter);
+			dispatcher.WaitForCounter(&counter);
+		}
+	});
+
+	std::vector<JobDecl> all(iNodeCount);
+	for (int i = 0; i < iNodeCount; i++)
+		all[i] = { BlockingJob, &frame.pNodes[i] };
+
+	Result blockingResult = Measure(iNodeCount, [&]() {
+		for (int i = 0; i < iNodeCount; i++)
+			frame.pNodes[i].done.SetValue(1);
+
+		JobCounter counter;
+		dispatcher.AddJobs(all, &counter);
+		dispatcher.WaitForCounter(&counter);
+	});
+
+	std::cout << shape.szName << " " << shape.iWidth << "x" << shape.iDepth << "\t"
+		<< graphResult.dNsPerNode << "\t" << graphResult.dSwitchesPerNode << "\t\t"
+		<< barrierResult.dNsPerNode << "\t" << barrierResult.dSwitchesPerNode << "\t\t"
+		<< blockingResult.dNsPerNode << "\t" << blockingResult.dSwitchesPerNode << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	// The blocking version can have every node parked at once
+	DispatcherConfig config;
+	config.fiberPools[(int)StackClass::Small] = { 4096 + 64, 64 * 1024 };
+	config.iJobPoolSize = 4096 + 64;
+	config.iWorkerThreadCount = iWorkers;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "Workers: " << dispatcher.WorkerThreadCount() << std::endl;
+	std::cout << "shape\t\tgraph ns/node\tswitches/node\tbarrier ns/node\tswitches/node\tblocking ns/node\tswitches/node" << std::endl;
+
+	for (auto& shape : Shapes)
+		Run(shape);
+
+	dispatcher.Shutdown();
+	return 0;
+}
@@ -0,0 +1,213 @@
+/**********************************************************************
+* Job queue scaling from 1 to N threads.
+*
+* The first table models the scheduler's hot loop on its own: every task
+* spawns two children until a fixed depth, with all threads sharing one
+* LockedQueue (the old Dispatcher::m_Jobs) versus per-thread work stealing
+* deques fed by an injection queue. The second table runs the same tree
+* through the Dispatcher.
+*
+* Usage: HustleBench_JobQueueScaling [max threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/LockedQueue.h"
+#include "hustle/WorkStealingQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+static const int TreeDepth = 14;						// Each root expands into 2^(depth+1)-1 tasks
+static const int RootCount = 64;
+static const int64_t TasksPerRoot = (1 << (TreeDepth + 1)) - 1;
+static const int64_t TotalTasks = TasksPerRoot * RootCount;
+
+// Tasks are nodes of a complete binary tree, so children can be found without allocating
+static std::vector<char> s_Nodes(TasksPerRoot * RootCount);
+
+static inline char* ChildOf(char* pNode, int iChild) {
+	int64_t iIndex = pNode - s_Nodes.data();
+	int64_t iRoot = iIndex / TasksPerRoot;
+	int64_t iLocal = iIndex % TasksPerRoot;
+	int64_t iChildLocal = iLocal * 2 + 1 + iChild;
+	if (iChildLocal >= TasksPerRoot)
+		return nullptr;
+	return &s_Nodes[iRoot * TasksPerRoot + iChildLocal];
+}
+
+// A small amount of work per task so queue overhead dominates
+static inline void DoWork(char* pNode) {
+	volatile uint32_t uHash = (uint32_t)(uintptr_t)pNode;
+	for (int i = 0; i < 64; i++)
+		uHash = uHash * 16777619u ^ i;
+}
+
+static double BenchGlobalQueue(int iThreadCount) {
+
+	LockedQueue<char*> queue;
+	std::atomic<int64_t> completed = { 0 };
+
+	for (int i = 0; i < RootCount; i++)
+		queue.Push(&s_Nodes[i * TasksPerRoot]);
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < iThreadCount; t++) {
+		threads.emplace_back([&]() {
+			int64_t iLocalCount = 0;
+			while (completed.load(std::memory_order_relaxed) < TotalTasks) {
+				char* pNode = queue.Pop();
+				if (pNode == nullptr) {
+					completed += iLocalCount;
+					iLocalCount = 0;
+					Platform::CpuPause();
+					continue;
+				}
+
+				DoWork(pNode);
+				for (int c = 0; c < 2; c++) {
+					if (char* pChild = ChildOf(pNode, c))
+						queue.Push(pChild);
+				}
+
+				if (++iLocalCount == 64) {
+					completed += iLocalCount;
+					iLocalCount = 0;
+				}
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	auto end = std::chrono::steady_clock::now();
+	return TotalTasks / std::chrono::duration<double>(end - start).count();
+}
+
+static double BenchWorkStealing(int iThreadCount) {
+
+	LockedQueue<char*> injectionQueue;
+	std::vector<WorkStealingQueue<char*>> deques(iThreadCount);
+	std::atomic<int64_t> completed = { 0 };
+
+	for (int i = 0; i < RootCount; i++)
+		injectionQueue.Push(&s_Nodes[i * TasksPerRoot]);
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < iThreadCount; t++) {
+		threads.emplace_back([&, t]() {
+			WorkStealingQueue<char*>& localQueue = deques[t];
+			uint32_t uRandomState = t * 2654435761u + 1;
+			int64_t iLocalCount = 0;
+
+			while (completed.load(std::memory_order_relaxed) < TotalTasks) {
+				char* pNode = localQueue.Pop();
+				if (pNode == nullptr)
+					pNode = injectionQueue.Pop();
+
+				for (int v = 0; pNode == nullptr && v < iThreadCount; v++) {
+					uRandomState ^= uRandomState << 13;
+					uRandomState ^= uRandomState >> 17;
+					uRandomState ^= uRandomState << 5;
+					int iVictim = uRandomState % iThreadCount;
+					if (iVictim != t)
+						pNode = deques[iVictim].Steal();
+				}
+
+				if (pNode == nullptr) {
+					completed += iLocalCount;
+					iLocalCount = 0;
+					Platform::CpuPause();
+					continue;
+				}
+
+				DoWork(pNode);
+				for (int c = 0; c < 2; c++) {
+					if (char* pChild = ChildOf(pNode, c))
+						localQueue.Push(pChild);
+				}
+
+				if (++iLocalCount == 64) {
+					completed += iLocalCount;
+					iLocalCount = 0;
+				}
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	auto end = std::chrono::steady_clock::now();
+	return TotalTasks / std::chrono::duration<double>(end - start).count();
+}
+
+// Dispatcher version of the same tree
+static std::atomic<int64_t> s_DispatcherCompleted;
+
+static void TreeJob(void* pUserData) {
+	char* pNode = (char*)pUserData;
+	DoWork(pNode);
+
+	for (int c = 0; c < 2; c++) {
+		if (char* pChild = ChildOf(pNode, c))
+			Dispatcher::GetInstance().AddJob(TreeJob, pChild);
+	}
+
+	s_DispatcherCompleted.fetch_add(1, std::memory_order_relaxed);
+}
+
+static double BenchDispatcher(int iThreadCount) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(100, 4096, iThreadCount) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return 0.0;
+	}
+
+	s_DispatcherCompleted = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < RootCount; i++)
+		dispatcher.AddJob(TreeJob, &s_Nodes[i * TasksPerRoot]);
+
+	while (s_DispatcherCompleted.load(std::memory_order_relaxed) < TotalTasks)
+		Platform::ThreadYield();
+
+	auto end = std::chrono::steady_clock::now();
+	dispatcher.Shutdown();
+
+	return TotalTasks / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+
+	int iMaxThreads = (std::max)(1, (int)std::thread::hardware_concurrency());
+	if (argc > 1)
+		iMaxThreads = std::stoi(argv[1]);
+
+	std::cout << "Tasks per run: " << TotalTasks << std::endl << std::endl;
+	std::cout << "threads\tglobal queue (jobs/s)\twork stealing (jobs/s)\tratio" << std::endl;
+
+	for (int t = 1; t <= iMaxThreads; t++) {
+		double dGlobal = BenchGlobalQueue(t);
+		double dStealing = BenchWorkStealing(t);
+		std::cout << t << "\t" << (int64_t)dGlobal << "\t\t" << (int64_t)dStealing << "\t\t" << dStealing / dGlobal << std::endl;
+	}
+
+	std::cout << std::endl << "workers\tDispatcher (jobs/s)" << std::endl;
+	for (int t = 1; t <= iMaxThreads; t++)
+		std::cout << t << "\t" << (int64_t)BenchDispatcher(t) << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+/**********************************************************************
+* FiberMutex against SpinLock and std::mutex, taken from inside jobs.
+*
+* short: every job takes the lock around a few hundred nanoseconds of
+*        work, many times. Reports ns per lock/unlock pair.
+* long:  jobs hold the lock for ~20 us at a time while unrelated jobs
+*        are queued alongside them. Reports how many of the unrelated
+*        jobs finished per ms. A worker spinning on a SpinLock or
+*        blocked in std::mutex can't run them, a parked fiber can.
+*
+* Usage: HustleBench_LockContention [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/FiberSync.h"
+#include "hustle/SpinLock.h"
+#include "Work.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int ShortJobCount = 256;
+static const int ShortLocksPerJob = 200;
+static const int ShortWork = 50;
+
+static const int LongJobCount = 64;
+static const int LongLocksPerJob = 4;
+static const auto LongHold = std::chrono::microseconds(20);
+
+// SpinLock with the lock()/unlock() names std::lock_guard wants
+class StdSpinLock {
+public:
+	void lock() { m_Lock.Lock(); }
+	void unlock() { m_Lock.Unlock(); }
+
+private:
+	SpinLock m_Lock;
+};
+
+template<class Mutex>
+static double ShortSections() {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	Mutex mutex;
+	uint32_t uShared = 1;
+	JobCounter counter;
+
+	auto start = Clock::now();
+	for (int i = 0; i < ShortJobCount; i++) {
+		counter.Increment();
+		dispatcher.AddJob([&]() {
+			uint32_t uLocal = 1;
+			for (int j = 0; j < ShortLocksPerJob; j++) {
+				{
+					std::lock_guard<Mutex> lock(mutex);
+					uShared = XorShiftWork(uShared, ShortWork);
+				}
+				uLocal = XorShiftWork(uLocal, ShortWork);
+			}
+			Sink(uLocal);
+		}, JobPriority::Normal, &counter);
+	}
+	dispatcher.WaitForCounter(&counter);
+
+	double dNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	return dNs / ((double)ShortJobCount * ShortLocksPerJob);
+}
+
+template<class Mutex>
+static double LongSections() {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	Mutex mutex;
+	std::atomic<bool> bDone = { false };
+	std::atomic<int64_t> iOtherJobs = { 0 };
+	JobCounter lockers, others;
+
+	auto start = Clock::now();
+	for (int i = 0; i < LongJobCount; i++) {
+		lockers.Increment();
+		dispatcher.AddJob([&]() {
+			for (int j = 0; j < LongLocksPerJob; j++) {
+				std::lock_guard<Mutex> lock(mutex);
+				auto holdEnd = Clock::now() + LongHold;
+				while (Clock::now() < holdEnd) {}
+			}
+		}, JobPriority::Normal, &lockers);
+	}
+
+	// Unrelated work that keeps re-queueing itself until the lockers are done
+	struct Other {
+		static void Run(std::atomic<bool>* pDone, std::atomic<int64_t>* pCount, JobCounter* pCounter) {
+			Sink(XorShiftWork(1, ShortWork));
+			pCount->fetch_add(1, std::memory_order_relaxed);
+			if (pDone->load(std::memory_order_relaxed) == false) {
+				pCounter->Increment();
+				Dispatcher::GetInstance().AddJob([=]() { Run(pDone, pCount, pCounter); }, JobPriority::Normal, pCounter);
+			}
+		}
+	};
+
+	for (int i = 0; i < dispatcher.WorkerThreadCount(); i++) {
+		others.Increment();
+		dispatcher.AddJob([&]() { Other::Run(&bDone, &iOtherJobs, &others); }, JobPriority::Normal, &others);
+	}
+
+	dispatcher.WaitForCounter(&lockers);
+	double dMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	int64_t iCompleted = iOtherJobs;
+
+	bDone = true;
+	dispatcher.WaitForCounter(&others);
+
+	return iCompleted / dMs;
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "Workers: " << dispatcher.WorkerThreadCount() << std::endl;
+	std::cout << "lock\t\tshort (ns/lock)\tlong (unrelated jobs/ms)" << std::endl;
+
+	std::cout << "SpinLock\t" << ShortSections<StdSpinLock>() << "\t\t" << LongSections<StdSpinLock>() << std::endl;
+	std::cout << "std::mutex\t" << ShortSections<std::mutex>() << "\t\t" << LongSections<std::mutex>() << std::endl;
+	std::cout << "FiberMutex\t" << ShortSections<FiberMutex>() << "\t\t" << LongSections<FiberMutex>() << std::endl;
+
+	dispatcher.Shutdown();
+	return 0;
+}
@@ -0,0 +1,196 @@
+/**********************************************************************
+* NUMA locality. The first table is the machine itself: a thread on
+* each node streams through a buffer first touched on each node, so the
+* diagonal is local bandwidth and the rest crosses the interconnect.
+*
+* The second runs a memory bound job mix through the Dispatcher, with
+* DispatcherConfig::bNumaAware on and off. Each producer job fills a
+* fresh buffer (first touch puts it on the producer's node) and fans out
+* reader jobs over it. Readers that stay on the producer's node read
+* local memory; the remote steal count says how many jobs crossed over.
+* On a single node machine both modes place and steal the same way.
+*
+* Usage: HustleBench_NumaLocality [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/Topology.h"
+#include "Work.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t StreamBytes = 64 * 1024 * 1024;
+static const int StreamPasses = 4;
+static const size_t ProducerBytes = 4 * 1024 * 1024;
+static const int ReadersPerProducer = 16;
+static const int ReadPasses = 4;
+static const int Rounds = 20;
+
+#if defined(__linux__)
+static void PinToCpus(const std::vector<int>& cpus) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int iCpu : cpus)
+		CPU_SET(iCpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+#endif
+
+static uint64_t SumBuffer(const uint64_t* pData, size_t iCount) {
+	uint64_t iSum = 0;
+	for (size_t i = 0; i < iCount; i++)
+		iSum += pData[i];
+	return iSum;
+}
+
+/**
+ * @brief GB/s reading memory first touched on one node from a thread on another
+*/
+static double MeasureStream(const Topology::Node& memoryNode, const Topology::Node& runNode) {
+
+	size_t iCount = StreamBytes / sizeof(uint64_t);
+	std::unique_ptr<uint64_t[]> pData(new uint64_t[iCount]);
+
+	std::thread([&]() {
+#if defined(__linux__)
+		PinToCpus(memoryNode.cpus);
+#endif
+		memset(pData.get(), 1, StreamBytes);
+	}).join();
+
+	double dSeconds = 0.0;
+	std::thread([&]() {
+#if defined(__linux__)
+		PinToCpus(runNode.cpus);
+#endif
+		Sink(SumBuffer(pData.get(), iCount));
+
+		auto start = Clock::now();
+		for (int i = 0; i < StreamPasses; i++)
+			Sink(SumBuffer(pData.get(), iCount));
+		dSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	}).join();
+
+	return (double)StreamBytes * StreamPasses / dSeconds / 1e9;
+}
+
+struct ReaderArgs {
+	const uint64_t* pData;
+	size_t iCount;
+	uint64_t iSum;
+};
+
+static void ReaderJob(void* pUserData) {
+	ReaderArgs* pArgs = (ReaderArgs*)pUserData;
+	uint64_t iSum = 0;
+	for (int i = 0; i < ReadPasses; i++)
+		iSum += SumBuffer(pArgs->pData, pArgs->iCount);
+	pArgs->iSum = iSum;
+}
+
+static void ProducerJob(void*) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	// A fresh allocation each time, so first touch puts it on whichever node this runs on
+	size_t iCount = ProducerBytes / sizeof(uint64_t);
+	std::unique_ptr<uint64_t[]> pData(new uint64_t[iCount]);
+	for (size_t i = 0; i < iCount; i++)
+		pData[i] = i;
+
+	size_t iChunk = iCount / ReadersPerProducer;
+	ReaderArgs args[ReadersPerProducer];
+	JobDecl readers[ReadersPerProducer];
+	for (int i = 0; i < ReadersPerProducer; i++) {
+		args[i] = { pData.get() + i * iChunk, iChunk, 0 };
+		readers[i] = { ReaderJob, &args[i] };
+	}
+
+	JobCounter counter;
+	dispatcher.AddJobs(readers, &counter);
+	dispatcher.WaitForCounter(&counter);
+}
+
+static bool MeasureMix(int iWorkers, bool bNumaAware) {
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+	config.bNumaAware = bNumaAware;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return false;
+	}
+
+	std::vector<JobDecl> producers((std::max)(1, dispatcher.WorkerThreadCount()) * 2);
+	for (auto& producer : producers)
+		producer = { ProducerJob, nullptr };
+
+	// Warm up the pools and the allocator
+	JobCounter warmup;
+	dispatcher.AddJobs(producers, &warmup);
+	dispatcher.WaitForCounter(&warmup);
+	DispatcherStats before = dispatcher.GetStats();
+
+	auto start = Clock::now();
+	for (int i = 0; i < Rounds; i++) {
+		JobCounter counter;
+		dispatcher.AddJobs(producers, &counter);
+		dispatcher.WaitForCounter(&counter);
+	}
+	double dNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+	DispatcherStats after = dispatcher.GetStats();
+	uint64_t iSteals = after.iSteals - before.iSteals;
+	uint64_t iRemoteSteals = after.iRemoteSteals - before.iRemoteSteals;
+	double dBytes = (double)producers.size() * Rounds * ProducerBytes * (ReadPasses + 1);
+
+	std::cout << (bNumaAware ? "on" : "off") << "\t" << dispatcher.GetNodeCount() << "\t" << dNs / Rounds / 1e6 << "\t\t"
+			  << dBytes / dNs << "\t" << iSteals << "\t" << iRemoteSteals << std::endl;
+
+	dispatcher.Shutdown();
+	return true;
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	Topology topology = Topology::Detect();
+	std::cout << "Nodes: " << topology.GetNodeCount() << ", CPUs: " << topology.GetCpuCount() << std::endl;
+	for (auto& node : topology.GetNodes())
+		std::cout << "  node " << node.iId << ": " << node.cpus.size() << " CPUs" << std::endl;
+
+	std::cout << std::endl << "stream GB/s, row = memory node, column = reading node" << std::endl;
+	for (auto& memoryNode : topology.GetNodes()) {
+		std::cout << memoryNode.iId;
+		for (auto& runNode : topology.GetNodes())
+			std::cout << "\t" << MeasureStream(memoryNode, runNode);
+		std::cout << std::endl;
+	}
+
+	std::cout << std::endl << "numa\tnodes\tms/round\tGB/s\tsteals\tremote steals" << std::endl;
+	if (MeasureMix(iWorkers, true) == false || MeasureMix(iWorkers, false) == false)
+		return -1;
+
+	return 0;
+}
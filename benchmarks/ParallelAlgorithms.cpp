@@ -0,0 +1,203 @@
+/**********************************************************************
+* ParallelFor / ParallelReduce against a serial loop and against the
+* hand rolled alternative of one job per element.
+*
+* Three kernels over 2^22 elements: array sum, SAXPY (y = a * x + y)
+* and a 256 bin histogram. The one job per element runs queue each
+* element as its own job through AddJobs(), in waves so the job pool
+* stays a sensible size.
+*
+* Usage: HustleBench_ParallelAlgorithms [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/Parallel.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+static const int64_t ElementCount = 1 << 22;
+static const int64_t PerElementCount = 1 << 18;	// One job per element is slow, run it on fewer elements
+static const int PerElementWave = 4096;
+static const int BinCount = 256;
+
+typedef std::array<uint32_t, BinCount> Histogram;
+
+static std::vector<float> s_X, s_Y;
+static std::vector<uint8_t> s_Bytes;
+
+template<class F>
+static double NsPerElement(int64_t iCount, F&& fn) {
+
+	// Best of three
+	double dBest = 1e30;
+	for (int iRun = 0; iRun < 3; iRun++) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		double dNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		dBest = (std::min)(dBest, dNs / iCount);
+	}
+
+	return dBest;
+}
+
+// Queue fn(i) as its own job for every element
+template<class F>
+static void JobPerElement(int64_t iCount, F fn) {
+
+	struct Element {
+		F* pFn;
+		int64_t i;
+	};
+
+	std::vector<Element> elements(PerElementWave);
+	std::vector<JobDecl> jobs(PerElementWave);
+	JobCounter counter;
+
+	for (int64_t iWave = 0; iWave < iCount; iWave += PerElementWave) {
+		for (int j = 0; j < PerElementWave; j++) {
+			elements[j] = { &fn, iWave + j };
+			jobs[j] = { [](void* pData) { Element* pElement = (Element*)pData; (*pElement->pFn)(pElement->i); }, &elements[j] };
+		}
+
+		Dispatcher::GetInstance().AddJobs(jobs.data(), PerElementWave, &counter);
+		Dispatcher::GetInstance().WaitForCounter(&counter);
+	}
+}
+
+static void PrintRow(const char* szKernel, double dSerial, double dParallel, double dPerElement) {
+	std::cout << szKernel << "\t" << dSerial << "\t\t" << dParallel << "\t\t" << dPerElement << "\t\t\t"
+		<< dSerial / dParallel << std::endl;
+}
+
+static void BenchSum() {
+
+	volatile float fSink;
+
+	double dSerial = NsPerElement(ElementCount, [&]() {
+		float fSum = 0.0f;
+		for (int64_t i = 0; i < ElementCount; i++)
+			fSum += s_X[i];
+		fSink = fSum;
+	});
+
+	double dParallel = NsPerElement(ElementCount, [&]() {
+		fSink = ParallelReduce((int64_t)0, ElementCount, (int64_t)0, 0.0f,
+			[](int64_t i) { return s_X[i]; },
+			[](float a, float b) { return a + b; });
+	});
+
+	std::atomic<int64_t> iSum = { 0 };
+	double dPerElement = NsPerElement(PerElementCount, [&]() {
+		JobPerElement(PerElementCount, [&iSum](int64_t i) { iSum.fetch_add((int64_t)s_X[i], std::memory_order_relaxed); });
+	});
+
+	PrintRow("sum", dSerial, dParallel, dPerElement);
+}
+
+static void BenchSaxpy() {
+
+	const float a = 1.0001f;
+
+	double dSerial = NsPerElement(ElementCount, [&]() {
+		for (int64_t i = 0; i < ElementCount; i++)
+			s_Y[i] = a * s_X[i] + s_Y[i];
+	});
+
+	double dParallel = NsPerElement(ElementCount, [&]() {
+		ParallelFor((int64_t)0, ElementCount, (int64_t)0, [a](int64_t i) { s_Y[i] = a * s_X[i] + s_Y[i]; });
+	});
+
+	double dPerElement = NsPerElement(PerElementCount, [&]() {
+		JobPerElement(PerElementCount, [a](int64_t i) { s_Y[i] = a * s_X[i] + s_Y[i]; });
+	});
+
+	PrintRow("saxpy", dSerial, dParallel, dPerElement);
+}
+
+static void BenchHistogram() {
+
+	volatile uint32_t uSink;
+
+	double dSerial = NsPerElement(ElementCount, [&]() {
+		Histogram bins = {};
+		for (int64_t i = 0; i < ElementCount; i++)
+			bins[s_Bytes[i]]++;
+		uSink = bins[0];
+	});
+
+	// One partial histogram per chunk, merged in a single pass over each chunk's bins
+	double dParallel = NsPerElement(ElementCount, [&]() {
+		std::array<std::atomic<uint32_t>, BinCount> bins;
+		for (auto& bin : bins)
+			bin = 0;
+
+		int64_t iGrain = ElementCount / 64;
+		ParallelFor((int64_t)0, ElementCount / iGrain, (int64_t)1, [&](int64_t iChunk) {
+			Histogram local = {};
+			for (int64_t i = iChunk * iGrain; i < (iChunk + 1) * iGrain; i++)
+				local[s_Bytes[i]]++;
+			for (int b = 0; b < BinCount; b++)
+				bins[b].fetch_add(local[b], std::memory_order_relaxed);
+		});
+		uSink = bins[0];
+	});
+
+	std::array<std::atomic<uint32_t>, BinCount> sharedBins;
+	for (auto& bin : sharedBins)
+		bin = 0;
+
+	double dPerElement = NsPerElement(PerElementCount, [&]() {
+		JobPerElement(PerElementCount, [&sharedBins](int64_t i) { sharedBins[s_Bytes[i]].fetch_add(1, std::memory_order_relaxed); });
+	});
+
+	PrintRow("histogram", dSerial, dParallel, dPerElement);
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	s_X.resize(ElementCount);
+	s_Y.resize(ElementCount);
+	s_Bytes.resize(ElementCount);
+
+	uint32_t uRandom = 2463534242u;
+	for (int64_t i = 0; i < ElementCount; i++) {
+		uRandom ^= uRandom << 13;
+		uRandom ^= uRandom >> 17;
+		uRandom ^= uRandom << 5;
+
+		s_X[i] = (float)(uRandom & 0xff);
+		s_Y[i] = 1.0f;
+		s_Bytes[i] = (uint8_t)(uRandom >> 8);
+	}
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+	config.iJobPoolSize = PerElementWave * 2;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "Workers: " << dispatcher.WorkerThreadCount() << std::endl;
+	std::cout << "kernel\t\tserial (ns/elem)\tparallel (ns/elem)\tjob per element (ns/elem)\tspeedup" << std::endl;
+
+	BenchSum();
+	BenchSaxpy();
+	BenchHistogram();
+
+	dispatcher.Shutdown();
+	return 0;
+}
@@ -0,0 +1,222 @@
+/**********************************************************************
+* Job storage layout: one heap allocation per Job (the old
+* ResourcePool::Grow) versus cache line padded slabs.
+*
+* The first table hands pooled Jobs out round robin to N threads, the
+* way a shared free list does, and has each thread update the counters
+* of its own jobs. Neighbouring jobs owned by different threads share
+* cache lines in the per-allocation layout. The second table pushes
+* empty jobs through the Dispatcher. Where the kernel allows it, cache
+* misses are read from the hardware performance counters.
+*
+* Usage: HustleBench_PoolLayout [max threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/ResourcePool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace Hustle;
+
+static const int JobsPerThread = 64;
+static const int Iterations = 200000;
+static const int DispatcherJobCount = 1 << 20;
+static const int DispatcherBatchSize = 1024;
+
+/**
+ * @brief Cache misses for this process and any thread it starts afterwards. Counts from threads are only
+ * included once they've exited. Reports -1 if the counter isn't available (no PMU, perf_event_paranoid, ...)
+*/
+class CacheMissCounter {
+public:
+	CacheMissCounter() :
+		m_iFd(-1) {
+#if defined(__linux__)
+		perf_event_attr attr = {};
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		m_iFd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		if (m_iFd >= 0) {
+			ioctl(m_iFd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(m_iFd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	~CacheMissCounter() {
+#if defined(__linux__)
+		if (m_iFd >= 0)
+			close(m_iFd);
+#endif
+	}
+
+	int64_t Read() {
+		int64_t iCount = -1;
+#if defined(__linux__)
+		if (m_iFd >= 0 && read(m_iFd, &iCount, sizeof(iCount)) != sizeof(iCount))
+			iCount = -1;
+#endif
+		return iCount;
+	}
+
+private:
+	int m_iFd;
+};
+
+static std::string FormatMisses(int64_t iMisses, int64_t iOps) {
+	if (iMisses < 0)
+		return "n/a";
+	return std::to_string((double)iMisses / iOps);
+}
+
+/**
+ * @brief The layout ResourcePool used to have: every resource is its own allocation.
+*/
+class ScatteredJobs {
+public:
+	ScatteredJobs(int iCount) {
+		for (int i = 0; i < iCount; i++)
+			m_Jobs.push_back(new Job());
+	}
+
+	~ScatteredJobs() {
+		for (auto pJob : m_Jobs)
+			delete pJob;
+	}
+
+	Job* operator [](int i) { return m_Jobs[i]; }
+
+private:
+	std::vector<Job*> m_Jobs;
+};
+
+template<class Jobs>
+static void RunCounters(Jobs& jobs, int iThreadCount, double& dOpsPerSec, int64_t& iMisses) {
+
+	std::atomic<bool> bStart = { false };
+	std::vector<std::thread> threads;
+	CacheMissCounter misses;
+
+	for (int t = 0; t < iThreadCount; t++) {
+		threads.emplace_back([&, t]() {
+
+			// Round robin, like consecutive Get()s from threads sharing a free list
+			std::vector<Job*> myJobs;
+			for (int i = 0; i < JobsPerThread; i++)
+				myJobs.push_back(jobs[i * iThreadCount + t]);
+
+			while (bStart == false)
+				std::this_thread::yield();
+
+			// What AddJob() and CompleteJob() do to a job, minus the queues
+			for (int i = 0; i < Iterations; i++) {
+				Job* pJob = myJobs[i % JobsPerThread];
+				pJob->GetCompletion().SetValue(1);
+				pJob->SetUserData(pJob);
+				pJob->GetCompletion().Decrement();
+			}
+		});
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	bStart = true;
+
+	for (auto& thread : threads)
+		thread.join();
+
+	auto end = std::chrono::steady_clock::now();
+
+	dOpsPerSec = (double)Iterations * iThreadCount / std::chrono::duration<double>(end - start).count();
+	iMisses = misses.Read();
+}
+
+static void EmptyJob(void*) {
+}
+
+static void RunDispatcher(int iWorkers, double& dJobsPerSec, int64_t& iMisses) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	CacheMissCounter misses;
+
+	dispatcher.Init(100, DispatcherBatchSize * 2, iWorkers);
+
+	std::vector<JobDecl> jobs(DispatcherBatchSize);
+	for (auto& job : jobs)
+		job = { EmptyJob, nullptr };
+
+	auto start = std::chrono::steady_clock::now();
+
+	JobCounter counter;
+	for (int i = 0; i < DispatcherJobCount; i += DispatcherBatchSize) {
+		dispatcher.AddJobs(jobs.data(), DispatcherBatchSize, &counter);
+		dispatcher.WaitForCounter(&counter);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	// Workers have to exit before their counts are included
+	dispatcher.Shutdown();
+
+	dJobsPerSec = DispatcherJobCount / std::chrono::duration<double>(end - start).count();
+	iMisses = misses.Read();
+}
+
+int main(int argc, char** argv) {
+
+	int iMaxThreads = (std::max)(2, (int)std::thread::hardware_concurrency());
+	if (argc > 1)
+		iMaxThreads = std::stoi(argv[1]);
+
+	std::cout << "sizeof(Job): " << sizeof(Job) << " bytes" << std::endl << std::endl;
+	std::cout << "threads\tscattered (ops/s)\tmisses/op\tslab (ops/s)\tmisses/op\tratio" << std::endl;
+
+	for (int iThreads = 1; iThreads <= iMaxThreads; iThreads *= 2) {
+
+		int iJobCount = JobsPerThread * iThreads;
+
+		ScatteredJobs scattered(iJobCount);
+		ResourcePool<Job> slab;
+		slab.Grow(iJobCount);
+
+		double dScattered, dSlab;
+		int64_t iScatteredMisses, iSlabMisses;
+		RunCounters(scattered, iThreads, dScattered, iScatteredMisses);
+		RunCounters(slab, iThreads, dSlab, iSlabMisses);
+
+		int64_t iOps = (int64_t)Iterations * iThreads;
+		std::cout << iThreads << "\t" << (int64_t)dScattered << "\t\t" << FormatMisses(iScatteredMisses, iOps)
+			<< "\t" << (int64_t)dSlab << "\t" << FormatMisses(iSlabMisses, iOps) << "\t" << dSlab / dScattered << std::endl;
+	}
+
+	std::cout << std::endl << "workers\tDispatcher empty jobs (jobs/s)\tmisses/job" << std::endl;
+
+	for (int iWorkers = 1; iWorkers <= iMaxThreads; iWorkers *= 2) {
+		double dJobsPerSec;
+		int64_t iMisses;
+		RunDispatcher(iWorkers, dJobsPerSec, iMisses);
+
+		std::cout << iWorkers << "\t" << (int64_t)dJobsPerSec << "\t\t\t" << FormatMisses(iMisses, DispatcherJobCount) << std::endl;
+	}
+
+	return 0;
+}
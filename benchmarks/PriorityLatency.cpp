@@ -0,0 +1,101 @@
+/**********************************************************************
+* Latency of latency-critical jobs under a saturating bulk load.
+*
+* The main thread keeps thousands of low priority jobs queued (like
+* examples/basic option 2) and periodically submits a probe job. The
+* time from AddJob() to the probe starting is recorded. Probes are run
+* once at Low priority (same queue as the load, the old single FIFO
+* behavior) and once at High priority.
+*
+* Usage: HustleBench_PriorityLatency [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int ProbeCount = 500;
+static const size_t LoadQueueDepth = 2000;
+
+struct Probe {
+	Clock::time_point submitted;
+	double dLatencyUs;
+};
+
+static std::atomic<int> s_ProbesDone;
+
+static void LoadJob(void*) {
+	// Roughly 20us of busy work
+	auto end = Clock::now() + std::chrono::microseconds(20);
+	while (Clock::now() < end)
+		;
+}
+
+static void ProbeJob(void* pUserData) {
+	Probe* pProbe = (Probe*)pUserData;
+	pProbe->dLatencyUs = std::chrono::duration<double, std::micro>(Clock::now() - pProbe->submitted).count();
+	s_ProbesDone++;
+}
+
+static void RunProbes(const char* szMode, JobPriority eProbePriority) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	std::vector<Probe> probes(ProbeCount);
+	s_ProbesDone = 0;
+
+	for (int i = 0; i < ProbeCount; i++) {
+
+		// Top the bulk load back up so the workers stay saturated
+		while (dispatcher.GetJobQueueDepth(JobPriority::Low) < LoadQueueDepth)
+			dispatcher.AddJob(LoadJob, nullptr, JobPriority::Low);
+
+		probes[i].submitted = Clock::now();
+		dispatcher.AddJob(ProbeJob, &probes[i], eProbePriority);
+
+		std::this_thread::sleep_for(std::chrono::microseconds(500));
+	}
+
+	while (s_ProbesDone < ProbeCount)
+		Platform::ThreadYield();
+
+	std::vector<double> latencies;
+	for (auto& probe : probes)
+		latencies.push_back(probe.dLatencyUs);
+	std::sort(latencies.begin(), latencies.end());
+
+	std::cout << szMode << "\t" << latencies[ProbeCount / 2] << "\t\t" << latencies[ProbeCount * 99 / 100]
+		<< "\t\t" << latencies.back() << std::endl;
+
+	// Let the load drain before the next run
+	while (dispatcher.GetJobQueueDepth() > 0)
+		Platform::ThreadYield();
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(100, 4096, iWorkers) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "probe priority\tp50 (us)\tp99 (us)\tmax (us)" << std::endl;
+	RunProbes("low (FIFO)", JobPriority::Low);
+	RunProbes("high", JobPriority::High);
+
+	dispatcher.Shutdown();
+	return 0;
+}
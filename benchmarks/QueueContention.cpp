@@ -0,0 +1,89 @@
+/**********************************************************************
+* LockedQueue vs BoundedMPMCQueue under contention. P producer threads
+* and P consumer threads move a fixed number of items through one queue,
+* for P = 1, 2, 4 ... 64.
+*
+* Usage: HustleBench_QueueContention [max producers]
+**********************************************************************/
+#include "hustle/BoundedMPMCQueue.h"
+#include "hustle/LockedQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+static const int ItemCount = 1 << 20;
+static int s_Items[ItemCount];
+
+template<class Queue>
+static double Run(Queue& queue, int iThreadPairs) {
+
+	std::atomic<int> iConsumed = { 0 };
+	std::atomic<bool> bStart = { false };
+	std::vector<std::thread> threads;
+
+	int iPerProducer = ItemCount / iThreadPairs;
+	int iTotal = iPerProducer * iThreadPairs;
+
+	for (int t = 0; t < iThreadPairs; t++) {
+		threads.emplace_back([&, t]() {
+			while (bStart == false)
+				std::this_thread::yield();
+
+			for (int i = 0; i < iPerProducer; i++)
+				queue.Push(&s_Items[t * iPerProducer + i]);
+		});
+
+		threads.emplace_back([&]() {
+			while (bStart == false)
+				std::this_thread::yield();
+
+			while (iConsumed.load(std::memory_order_relaxed) < iTotal) {
+				if (queue.Pop())
+					iConsumed.fetch_add(1, std::memory_order_relaxed);
+				else
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	bStart = true;
+
+	for (auto& thread : threads)
+		thread.join();
+
+	auto end = std::chrono::steady_clock::now();
+	return iTotal / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+
+	int iMaxPairs = 64;
+	if (argc > 1)
+		iMaxPairs = std::stoi(argv[1]);
+
+	std::cout << "Items per run: " << ItemCount << std::endl;
+	std::cout << "producers/consumers\tLockedQueue (ops/s)\tBoundedMPMCQueue (ops/s)\tratio" << std::endl;
+
+	for (int iPairs = 1; iPairs <= iMaxPairs; iPairs *= 2) {
+
+		LockedQueue<int*> lockedQueue;
+
+		// Sized to hold every item, so neither queue ever blocks a producer
+		BoundedMPMCQueue<int*> boundedQueue(ItemCount);
+
+		double dLocked = Run(lockedQueue, iPairs);
+		double dBounded = Run(boundedQueue, iPairs);
+
+		std::cout << iPairs << "\t\t\t" << (int64_t)dLocked << "\t\t" << (int64_t)dBounded << "\t\t\t" << dBounded / dLocked << std::endl;
+	}
+
+	return 0;
+}
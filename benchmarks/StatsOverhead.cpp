@@ -0,0 +1,230 @@
+/**********************************************************************
+* Cost of the always on scheduler statistics (Dispatcher::GetStats()).
+*
+* The first table is plain throughput, empty jobs and ~1 us jobs, with
+* the counters in. The second times what a job adds to its worker's
+* counters (a job, a switch, and one queue wait sample in every
+* QueueWaitSampleInterval, two clock reads included) on its own, and
+* reports it as a share of the empty job time above. The last table
+* compares ResourcePool Get()/Release() against the old debug only
+* high water mark, an atomic in use count plus a SpinLock on every
+* Get(), from a growing number of threads.
+*
+* Usage: HustleBench_StatsOverhead [worker threads] [max threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/ResourcePool.h"
+#include "hustle/SpinLock.h"
+#include "hustle/Stats.h"
+#include "Work.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int BatchCount = 100;
+static const int BatchSize = 1024;
+static const int WorkRounds = 400;
+static const int CountIterations = 10000000;
+static const int PoolIterations = 1000000;
+static const int PoolHeld = 4;
+
+static void EmptyJob(void*) {
+}
+
+static void WorkJob(void* pUserData) {
+	Sink(XorShiftWork((uint32_t)(uintptr_t)pUserData, WorkRounds));
+}
+
+static double MeasureJobs(JobEntryPoint entryPoint) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	std::vector<JobDecl> batch(BatchSize);
+	for (int i = 0; i < BatchSize; i++)
+		batch[i] = { entryPoint, (void*)(uintptr_t)i };
+
+	// Warm up the pools
+	JobCounter warmup;
+	dispatcher.AddJobs(batch, &warmup);
+	dispatcher.WaitForCounter(&warmup);
+
+	auto start = Clock::now();
+	for (int i = 0; i < BatchCount; i++) {
+		JobCounter counter;
+		dispatcher.AddJobs(batch, &counter);
+		dispatcher.WaitForCounter(&counter);
+	}
+
+	double dNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	return dNs / ((double)BatchCount * BatchSize);
+}
+
+static uint64_t NowNs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief What the Dispatcher does to a worker's counters per job, without the job
+*/
+static double MeasureCounting() {
+
+	std::unique_ptr<WorkerStats> pStats(new WorkerStats());
+	std::unique_ptr<uint64_t[]> pQueuedTimes(new uint64_t[Dispatcher::QueueWaitSampleInterval]);
+
+	auto start = Clock::now();
+	for (int i = 0; i < CountIterations; i++) {
+
+		// Stamped when queued
+		uint64_t iQueuedTime = (uint32_t)i % Dispatcher::QueueWaitSampleInterval == 0 ? NowNs() : 0;
+		pQueuedTimes[i % Dispatcher::QueueWaitSampleInterval] = iQueuedTime;
+
+		// Counted when run
+		if (iQueuedTime)
+			pStats->CountQueueWait(NowNs() - iQueuedTime);
+		pStats->CountFiberSwitch();
+		pStats->CountJob();
+	}
+
+	double dNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+	DispatcherStats stats;
+	pStats->AddTo(stats);
+	Sink(stats.iJobsExecuted + pQueuedTimes[0]);
+
+	return dNs / CountIterations;
+}
+
+struct PoolItem {
+	int iSomething;
+};
+
+/**
+ * @brief The high water mark as it used to be kept in debug builds
+*/
+class LockedHighWaterPool {
+public:
+	LockedHighWaterPool(int iCount) { m_Pool.Grow(iCount); }
+
+	PoolItem* Get() {
+		PoolItem* pItem = m_Pool.Get();
+		m_iInUse++;
+
+		m_StatsLock.Lock();
+		if (m_iInUse > m_iHighWaterMark)
+			m_iHighWaterMark = m_iInUse;
+		m_StatsLock.Unlock();
+
+		return pItem;
+	}
+
+	void Release(PoolItem* pItem) {
+		m_iInUse--;
+		m_Pool.Release(pItem);
+	}
+
+private:
+	ResourcePool<PoolItem> m_Pool;
+	SpinLock m_StatsLock;
+	int m_iHighWaterMark = 0;
+	std::atomic<int> m_iInUse = { 0 };
+};
+
+class PlainPool {
+public:
+	PlainPool(int iCount) { m_Pool.Grow(iCount); }
+
+	PoolItem* Get() { return m_Pool.Get(); }
+	void Release(PoolItem* pItem) { m_Pool.Release(pItem); }
+
+private:
+	ResourcePool<PoolItem> m_Pool;
+};
+
+template<class Pool>
+static double MeasurePool(int iThreads) {
+
+	Pool pool(iThreads * PoolHeld * 64);
+
+	std::atomic<bool> bGo = { false };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < iThreads; t++) {
+		threads.emplace_back([&]() {
+			while (bGo.load() == false)
+				std::this_thread::yield();
+
+			PoolItem* pHeld[PoolHeld];
+			for (int i = 0; i < PoolIterations; i += PoolHeld) {
+				for (int j = 0; j < PoolHeld; j++)
+					pHeld[j] = pool.Get();
+				for (int j = 0; j < PoolHeld; j++)
+					pool.Release(pHeld[j]);
+			}
+		});
+	}
+
+	auto start = Clock::now();
+	bGo = true;
+	for (auto& thread : threads)
+		thread.join();
+
+	double dNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	return dNs / ((double)iThreads * PoolIterations);
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	int iMaxThreads = (std::max)(1, (int)std::thread::hardware_concurrency());
+	if (argc > 2)
+		iMaxThreads = std::stoi(argv[2]);
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "Workers: " << dispatcher.WorkerThreadCount() << std::endl;
+	std::cout << "jobs\t\tns/job" << std::endl;
+
+	double dEmpty = MeasureJobs(EmptyJob);
+	std::cout << "empty\t\t" << dEmpty << std::endl;
+	std::cout << "1 us work\t" << MeasureJobs(WorkJob) << std::endl;
+
+	DispatcherStats stats = dispatcher.GetStats();
+	std::cout << "executed " << stats.iJobsExecuted << ", switches " << stats.iFiberSwitches << ", steals " << stats.iSteals
+			  << ", fiber pool exhaustions " << stats.iFiberPoolExhaustions << ", queue wait p50 < " << stats.GetQueueWaitPercentile(50)
+			  << " ns, p99 < " << stats.GetQueueWaitPercentile(99) << " ns" << std::endl;
+
+	dispatcher.Shutdown();
+
+	double dCounting = MeasureCounting();
+	std::cout << std::endl << "counting\tns/job\tshare of an empty job" << std::endl;
+	std::cout << "per job\t\t" << dCounting << "\t" << dCounting / dEmpty * 100.0 << "%" << std::endl;
+
+	std::cout << std::endl << "pool threads\tlocked mark (ns/pair)\tshared list mark (ns/pair)" << std::endl;
+	for (int iThreads = 1; iThreads <= iMaxThreads; iThreads *= 2) {
+		double dLocked = MeasurePool<LockedHighWaterPool>(iThreads);
+		double dPlain = MeasurePool<PlainPool>(iThreads);
+		std::cout << iThreads << "\t\t" << dLocked << "\t\t\t" << dPlain << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,197 @@
+/**********************************************************************
+* Memory and throughput of many waits at once, coroutines against
+* fibers.
+*
+* N waiters each keep a few hundred bytes of state across a wait on a
+* shared gate counter, so all N are suspended together. As Task<>
+* coroutines (Task.h) a waiter is its coroutine frame. As fiber jobs it
+* is a parked fiber with its own 64 KB stack. Each mode runs in its own
+* process and reports peak resident memory (VmHWM) above where it was
+* before Init(), per waiter and in total, plus the time to
+* start, suspend, release and finish all of them.
+*
+* Every fiber stack is its own mapping, and Linux caps a process at
+* vm.max_map_count (65530 by default) of those, so the fiber run uses
+* fewer waiters by default. Compare the per waiter columns.
+*
+* Usage: HustleBench_TaskMemory [tasks] [fiber jobs] [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/Task.h"
+#include "Work.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace Hustle;
+
+static const size_t StateBytes = 256;
+
+static std::atomic<int> s_Started;
+static JobCounter s_Gate;
+
+// Value of a "Name:   1234 kB" line in /proc/self/status, in MB
+static double StatusMB(const char* szName) {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, strlen(szName), szName) == 0)
+			return std::stod(line.substr(strlen(szName) + 1)) / 1024.0;
+	}
+	return -1.0;
+}
+
+static Task<uint32_t> WaitingTask(uint32_t uSeed) {
+
+	// State that lives across the wait, so it's part of the frame
+	uint8_t state[StateBytes];
+	for (size_t i = 0; i < StateBytes; i++)
+		state[i] = (uint8_t)(uSeed + i);
+
+	s_Started++;
+	co_await s_Gate;
+
+	co_return state[uSeed % StateBytes];
+}
+
+static void WaitingJob(void* pUserData) {
+
+	volatile uint8_t state[StateBytes];
+	for (size_t i = 0; i < StateBytes; i++)
+		state[i] = (uint8_t)((uintptr_t)pUserData + i);
+
+	s_Started++;
+	Dispatcher::GetInstance().WaitForCounter(&s_Gate);
+
+	Sink(state[(uintptr_t)pUserData % StateBytes]);
+}
+
+static void Report(const char* szMode, int iCount, double dBaseMB, double dSeconds) {
+
+	double dPeakMB = StatusMB("VmHWM") - dBaseMB;
+	std::cout << szMode << "\t" << iCount << "\t" << (int64_t)dPeakMB << "\t\t" << dPeakMB * 1024.0 * 1024.0 / iCount << "\t\t"
+			  << dSeconds * 1e9 / iCount << std::endl;
+}
+
+static void RunTasks(int iCount, int iWorkers) {
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+
+	// From before Init(), the same as the fiber run
+	double dBaseMB = StatusMB("VmHWM");
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	s_Gate.SetValue(1);
+	std::vector<Task<uint32_t>> tasks;
+	tasks.reserve(iCount);
+	for (int i = 0; i < iCount; i++) {
+		tasks.push_back(WaitingTask((uint32_t)i));
+		tasks.back().Start();
+	}
+
+	// Everything is suspended on the gate at this point
+	while (s_Started < iCount)
+		Platform::ThreadYield();
+
+	s_Gate.Decrement();
+	uint32_t uSum = 0;
+	for (auto& task : tasks)
+		uSum += task.Get();
+
+	double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	Sink(uSum);
+
+	Report("tasks", iCount, dBaseMB, dSeconds);
+
+	tasks.clear();
+	dispatcher.Shutdown();
+}
+
+static void RunFiberJobs(int iCount, int iWorkers) {
+
+	// Enough fibers for everyone, with room for the ones the workers hold
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+	config.fiberPools[(int)StackClass::Small] = { iCount + 64, 64 * 1024, 0 };
+
+	// Pools count too: a fiber's stack is the cost of parking a job on it
+	double dBaseMB = StatusMB("VmHWM");
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	s_Gate.SetValue(1);
+	JobCounter done;
+	for (int i = 0; i < iCount; i++) {
+		done.Increment();
+		dispatcher.AddJob(WaitingJob, (void*)(uintptr_t)i, &done);
+	}
+
+	while (s_Started < iCount)
+		Platform::ThreadYield();
+
+	s_Gate.Decrement();
+	dispatcher.WaitForCounter(&done);
+
+	double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	Report("fiber jobs", iCount, dBaseMB, dSeconds);
+
+	dispatcher.Shutdown();
+}
+
+int main(int argc, char** argv) {
+
+	int iTaskCount = 1000000;
+	int iFiberCount = 20000;
+	int iWorkers = -1;
+	if (argc > 1)
+		iTaskCount = std::stoi(argv[1]);
+	if (argc > 2)
+		iFiberCount = std::stoi(argv[2]);
+	if (argc > 3)
+		iWorkers = std::stoi(argv[3]);
+
+	std::cout << "waiters\t\tcount\tpeak RSS (MB)\tbytes/waiter\tns/waiter" << std::endl;
+
+	// Each mode in a fresh process, so the numbers don't include the other one
+	for (int iMode = 0; iMode < 2; iMode++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			if (iMode == 0)
+				RunTasks(iTaskCount, iWorkers);
+			else
+				RunFiberJobs(iFiberCount, iWorkers);
+			std::cout.flush();
+			_exit(0);
+		}
+
+		int iStatus;
+		waitpid(pid, &iStatus, 0);
+		if (WIFEXITED(iStatus) == false)
+			std::cout << "Run " << iMode << " failed" << std::endl;
+	}
+
+	return 0;
+}
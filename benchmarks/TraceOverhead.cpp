@@ -0,0 +1,114 @@
+/**********************************************************************
+* Cost of scheduler tracing.
+*
+* Three loads: batches of empty jobs (the worst case, nothing but
+* scheduling), batches of ~1 us jobs, and jobs that yield 8 times each
+* (a fiber switch per yield). Built with HUSTLE_TRACING, each one is run
+* with recording paused and running (Trace::SetEnabled()) and the
+* difference reported. Without it the macros are compiled out, and the
+* "off" column is the number to compare against a HUSTLE_TRACING build.
+*
+* Usage: HustleBench_TraceOverhead [worker threads] [trace.json]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "hustle/Trace.h"
+#include "Work.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int BatchCount = 100;
+static const int BatchSize = 1024;
+static const int WorkRounds = 400;
+static const int YieldCount = 8;
+
+static void EmptyJob(void*) {
+}
+
+static void WorkJob(void* pUserData) {
+	Sink(XorShiftWork((uint32_t)(uintptr_t)pUserData, WorkRounds));
+}
+
+static void YieldJob(void*) {
+	for (int i = 0; i < YieldCount; i++)
+		Dispatcher::GetInstance().YieldToScheduler();
+}
+
+static double Measure(JobEntryPoint entryPoint) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	std::vector<JobDecl> batch(BatchSize);
+	for (int i = 0; i < BatchSize; i++)
+		batch[i] = { entryPoint, (void*)(uintptr_t)i };
+
+	// Warm up the pools
+	JobCounter warmup;
+	dispatcher.AddJobs(batch, &warmup);
+	dispatcher.WaitForCounter(&warmup);
+
+	auto start = Clock::now();
+	for (int i = 0; i < BatchCount; i++) {
+		JobCounter counter;
+		dispatcher.AddJobs(batch, &counter);
+		dispatcher.WaitForCounter(&counter);
+	}
+
+	double dNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	return dNs / ((double)BatchCount * BatchSize);
+}
+
+static void Run(const char* szName, JobEntryPoint entryPoint) {
+
+#if defined(HUSTLE_TRACING)
+	Trace::SetEnabled(false);
+	double dOff = Measure(entryPoint);
+
+	Trace::Clear();
+	Trace::SetEnabled(true);
+	double dOn = Measure(entryPoint);
+
+	std::cout << szName << "\t" << dOff << "\t\t" << dOn << "\t\t" << (dOn - dOff) / dOff * 100.0 << "%" << std::endl;
+#else
+	std::cout << szName << "\t" << Measure(entryPoint) << "\t\t-\t\t-" << std::endl;
+#endif
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "Workers: " << dispatcher.WorkerThreadCount() << std::endl;
+#if !defined(HUSTLE_TRACING)
+	std::cout << "Tracing compiled out, configure with HUSTLE_TRACING to measure it" << std::endl;
+#endif
+	std::cout << "jobs\t\toff (ns/job)\ton (ns/job)\toverhead" << std::endl;
+
+	Run("empty\t", EmptyJob);
+	Run("1 us work", WorkJob);
+	Run("yield x8", YieldJob);
+
+	if (argc > 2 && dispatcher.DumpTrace(argv[2]) == false)
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+
+	dispatcher.Shutdown();
+	return 0;
+}
@@ -0,0 +1,117 @@
+/**********************************************************************
+* What the main thread gets out of WaitForCounter()/WaitForJob() when
+* it's outside the Dispatcher.
+*
+* fan-out: a batch of small jobs queued from main, then waited on.
+*          "yielding" waits the way WaitForCounter() used to, yielding
+*          the thread until the counter is reached. "helping" is
+*          WaitForCounter(), which runs queued jobs while it waits.
+*          Reports ns per job and the share of jobs main ran.
+* single:  one empty job queued and waited on, over and over.
+*          WaitForJob() against WaitForJob(hJob, true), which runs the
+*          job inline if no worker has started it. Reports ns per job.
+*
+* Usage: HustleBench_WaitHelping [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+#include "Work.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int BatchCount = 50;
+static const int BatchSize = 1024;
+static const int SingleCount = 20000;
+static const int JobWork = 500;
+
+static std::thread::id s_MainThread;
+static std::atomic<int64_t> s_iRanOnMain = { 0 };
+
+static void WorkJob(void* pUserData) {
+	Sink(XorShiftWork((uint32_t)(uintptr_t)pUserData, JobWork));
+
+	if (std::this_thread::get_id() == s_MainThread)
+		s_iRanOnMain.fetch_add(1, std::memory_order_relaxed);
+}
+
+struct Result {
+	double dNsPerJob;
+	double dMainShare;
+};
+
+template<class Wait>
+static Result FanOut(Wait&& wait) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	std::vector<JobDecl> batch(BatchSize);
+	for (int i = 0; i < BatchSize; i++)
+		batch[i] = { WorkJob, (void*)(uintptr_t)i };
+
+	s_iRanOnMain = 0;
+	auto start = Clock::now();
+	for (int i = 0; i < BatchCount; i++) {
+		JobCounter counter;
+		dispatcher.AddJobs(batch, &counter);
+		wait(counter);
+	}
+
+	double dNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	double dJobs = (double)BatchCount * BatchSize;
+	return { dNs / dJobs, s_iRanOnMain / dJobs };
+}
+
+static double Single(bool bRunInline) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	auto start = Clock::now();
+	for (int i = 0; i < SingleCount; i++)
+		dispatcher.WaitForJob(dispatcher.AddJob([]() {}), bRunInline);
+
+	double dNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	return dNs / SingleCount;
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	DispatcherConfig config;
+	config.iWorkerThreadCount = iWorkers;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	s_MainThread = std::this_thread::get_id();
+
+	std::cout << "Workers: " << dispatcher.WorkerThreadCount() << std::endl;
+	std::cout << "wait\t\tfan-out ns/job\tran on main\tsingle ns/job" << std::endl;
+
+	Result yielding = FanOut([](JobCounter& counter) {
+		while (counter.HasReached(0) == false)
+			std::this_thread::yield();
+	});
+	Result helping = FanOut([&](JobCounter& counter) { dispatcher.WaitForCounter(&counter); });
+
+	std::cout << "yielding\t" << yielding.dNsPerJob << "\t\t" << yielding.dMainShare * 100 << "%\t\t-" << std::endl;
+	std::cout << "helping\t\t" << helping.dNsPerJob << "\t\t" << helping.dMainShare * 100 << "%\t\t" << Single(false) << std::endl;
+	std::cout << "inline\t\t-\t\t-\t\t" << Single(true) << std::endl;
+
+	dispatcher.Shutdown();
+	return 0;
+}
@@ -0,0 +1,94 @@
+/**********************************************************************
+* Fiber switches spent waiting on dependency chains.
+*
+* Every root job spawns a child and waits for it, down to a fixed depth,
+* like JobFunction -> SubJob -> ThirdLevelJob in examples/basic. The
+* "polling" rows wait the way WaitForJob() used to: yield back to the
+* scheduler and get switched back in to re-check. The "parked" rows use
+* WaitForJob(), which parks the fiber until the child completes.
+*
+* Usage: HustleBench_WaitParking [worker threads]
+**********************************************************************/
+#include "hustle/Dispatcher.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+using namespace Hustle;
+
+static bool s_bPolling = false;
+static std::atomic<int> s_RootsDone;
+
+static void ChainJob(void* pUserData) {
+
+	intptr_t iDepth = (intptr_t)pUserData;
+	if (iDepth == 0)
+		return;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	JobHandle hChild = dispatcher.AddJob(ChainJob, (void*)(iDepth - 1));
+
+	if (s_bPolling) {
+		while (hChild->GetCompletion().GetValue() > 0)
+			dispatcher.YieldToScheduler();
+	}
+	else {
+		dispatcher.WaitForJob(hChild);
+	}
+}
+
+static void RootJob(void* pUserData) {
+	ChainJob(pUserData);
+	s_RootsDone++;
+}
+
+static void RunChains(const char* szMode, bool bPolling, int iRoots, int iDepth) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	s_bPolling = bPolling;
+	s_RootsDone = 0;
+
+	uint64_t iSwitchesBefore = dispatcher.GetFiberSwitchCount();
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iRoots; i++)
+		dispatcher.AddJob(RootJob, (void*)(intptr_t)iDepth);
+
+	while (s_RootsDone < iRoots)
+		Platform::ThreadYield();
+
+	auto end = std::chrono::steady_clock::now();
+	uint64_t iSwitches = dispatcher.GetFiberSwitchCount() - iSwitchesBefore;
+	int64_t iJobs = (int64_t)iRoots * (iDepth + 1);
+
+	std::cout << szMode << "\t" << iRoots << "\t" << iDepth << "\t" << iJobs << "\t" << iSwitches << "\t\t"
+		<< (double)iSwitches / iJobs << "\t\t" << std::chrono::duration<double, std::milli>(end - start).count() << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+	int iWorkers = -1;
+	if (argc > 1)
+		iWorkers = std::stoi(argv[1]);
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(1000, 1000, iWorkers) == false) {
+		std::cout << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	std::cout << "mode\troots\tdepth\tjobs\tswitches\tswitches/job\tms" << std::endl;
+
+	// The examples/basic shape, then progressively deeper chains
+	const int Shapes[][2] = { { 300, 2 }, { 3000, 2 }, { 100, 16 }, { 32, 64 } };
+	for (auto& shape : Shapes) {
+		RunChains("polling", true, shape[0], shape[1]);
+		RunChains("parked", false, shape[0], shape[1]);
+	}
+
+	dispatcher.Shutdown();
+	return 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+/**********************************************************************
+* Busy work and a result sink shared by the stand alone benchmarks.
+**********************************************************************/
+
+#include <stdint.h>
+
+// Only ever written, by Sink()
+static volatile uint64_t s_uSink;
+
+/**
+ * @brief Stores a result where the compiler has to assume it's read, so the work that made it can't be dropped
+*/
+static inline void Sink(uint64_t uValue) {
+	s_uSink = uValue;
+}
+
+/**
+ * @brief iRounds of xorshift on uValue, a loop that stays in registers
+*/
+static inline uint32_t XorShiftWork(uint32_t uValue, int iRounds) {
+	uValue |= 1;
+	for (int i = 0; i < iRounds; i++) {
+		uValue ^= uValue << 13;
+		uValue ^= uValue >> 17;
+		uValue ^= uValue << 5;
+	}
+	return uValue;
+}
@@ -0,0 +1,66 @@
+#include "Suite.h"
+
+#include "hustle/Dispatcher.h"
+
+#include <benchmark/benchmark.h>
+#include <vector>
+
+using namespace Hustle;
+
+static void EmptyJob(void*) {
+}
+
+// One empty job queued and waited on, over and over. Latency of the round trip from outside the Dispatcher.
+static void BM_AddJob_WaitForJob(benchmark::State& state) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	bool bRunInline = state.range(0) != 0;
+
+	for (auto _ : state)
+		dispatcher.WaitForJob(dispatcher.AddJob(EmptyJob, nullptr), bRunInline);
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AddJob_WaitForJob)->ArgName("inline")->Arg(0)->Arg(1)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
+
+// Batches of empty jobs queued with AddJobs() and waited on. Nothing but scheduling overhead.
+static void BM_EmptyJobs(benchmark::State& state) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	std::vector<JobDecl> batch(state.range(0), { EmptyJob, nullptr });
+
+	for (auto _ : state) {
+		JobCounter counter;
+		dispatcher.AddJobs(batch, &counter);
+		dispatcher.WaitForCounter(&counter);
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EmptyJobs)->ArgName("batch")->RangeMultiplier(16)->Range(16, 4096)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
+
+static void FanOutJob(void* pUserData) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	int iChildren = (int)(intptr_t)pUserData;
+
+	JobCounter counter;
+	for (int i = 0; i < iChildren; i++) {
+		counter.Increment();
+		dispatcher.AddJob(EmptyJob, nullptr, &counter);
+	}
+
+	// Parks the fiber until the last child is done
+	dispatcher.WaitForCounter(&counter);
+}
+
+// A job that spawns children onto its worker's deque, for the others to steal, and waits for all of them
+static void BM_FanOutFanIn(benchmark::State& state) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	for (auto _ : state)
+		dispatcher.WaitForJob(dispatcher.AddJob(FanOutJob, (void*)(intptr_t)state.range(0)));
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOutFanIn)->ArgName("children")->RangeMultiplier(8)->Range(8, 512)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
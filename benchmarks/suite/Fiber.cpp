@@ -0,0 +1,60 @@
+#include "Suite.h"
+
+#include "FiberContext.h"
+#include "hustle/Dispatcher.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace Hustle;
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+
+static const size_t PingStackSize = 64 * 1024;
+
+static void PingEntryPoint(void* pData) {
+	Context::FiberContext** ppBack = (Context::FiberContext**)pData;
+	while (true)
+		Context::SwitchTo(*ppBack);
+}
+
+// Raw context switch, a switch into a fiber and one back out per iteration
+static void BM_FiberSwitch_Context(benchmark::State& state) {
+
+	// The thread may already be a fiber, if it helped out in a wait. Leave that context alone.
+	Context::FiberContext* pThreadContext = Context::GetCurrent();
+	bool bConverted = pThreadContext == nullptr;
+	if (bConverted)
+		pThreadContext = Context::ConvertThread();
+
+	Context::FiberContext* pPingContext = Context::Create(PingStackSize, PingEntryPoint, &pThreadContext);
+
+	for (auto _ : state)
+		Context::SwitchTo(pPingContext);
+	state.SetItemsProcessed(state.iterations() * 2);
+
+	Context::Destroy(pPingContext);
+	if (bConverted)
+		Context::Destroy(pThreadContext);
+}
+BENCHMARK(BM_FiberSwitch_Context)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
+
+#endif
+
+static const int YieldsPerJob = 1000;
+
+static void YieldJob(void*) {
+	for (int i = 0; i < YieldsPerJob; i++)
+		Dispatcher::GetInstance().YieldToScheduler();
+}
+
+// A job yielding to its worker's scheduler over and over: out to the scheduler, a pass of its loop, and back in.
+// Each submitting thread runs one such job at a time.
+static void BM_FiberSwitch_Yield(benchmark::State& state) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	for (auto _ : state)
+		dispatcher.WaitForJob(dispatcher.AddJob(YieldJob, nullptr));
+
+	state.SetItemsProcessed(state.iterations() * YieldsPerJob);
+}
+BENCHMARK(BM_FiberSwitch_Yield)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
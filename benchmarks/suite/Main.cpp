@@ -0,0 +1,60 @@
+/**********************************************************************
+* Google Benchmark suite for the scheduler and its primitives. One
+* binary, so every number lands in the same report, and the report can
+* be written as JSON for tracking over time:
+*
+*   Hustle_Bench --benchmark_out=hustle.json --benchmark_out_format=json
+*
+* The Dispatcher is brought up once, before any benchmark runs, with
+* --hustle_workers=N workers (default: one per logical core, less one).
+* Thread sweeps vary the threads using a primitive, or submitting jobs.
+* For a sweep over worker counts, run the binary once per count.
+*
+* Usage: Hustle_Bench [--hustle_workers=N] [benchmark flags]
+**********************************************************************/
+#include "Suite.h"
+
+#include "hustle/Dispatcher.h"
+
+#include <benchmark/benchmark.h>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <thread>
+
+using namespace Hustle;
+
+int MaxBenchThreads() {
+	return (std::max)(1, (int)std::thread::hardware_concurrency());
+}
+
+int main(int argc, char** argv) {
+
+	// Take our own flag out before Google Benchmark sees the rest
+	DispatcherConfig config;
+	int iArgCount = 0;
+	for (int i = 0; i < argc; i++) {
+		if (strncmp(argv[i], "--hustle_workers=", 17) == 0)
+			config.iWorkerThreadCount = std::stoi(argv[i] + 17);
+		else
+			argv[iArgCount++] = argv[i];
+	}
+	argc = iArgCount;
+
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	if (dispatcher.Init(config) == false) {
+		std::cerr << "Failed: " << dispatcher.GetLastError() << std::endl;
+		return -1;
+	}
+
+	benchmark::AddCustomContext("hustle_workers", std::to_string(dispatcher.WorkerThreadCount()));
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	dispatcher.Shutdown();
+	return 0;
+}
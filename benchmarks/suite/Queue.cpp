@@ -0,0 +1,22 @@
+#include "Suite.h"
+
+#include "hustle/BoundedMPMCQueue.h"
+#include "hustle/LockedQueue.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace Hustle;
+
+// Every thread pushes then pops one item on a shared queue. The pop may get another thread's item.
+template<class Queue>
+static void BM_Queue_PushPop(benchmark::State& state) {
+	static Queue s_Queue;
+
+	for (auto _ : state) {
+		s_Queue.Push(&state);
+		benchmark::DoNotOptimize(s_Queue.Pop());
+	}
+	state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK_TEMPLATE(BM_Queue_PushPop, LockedQueue<void*>)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Queue_PushPop, BoundedMPMCQueue<void*>)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
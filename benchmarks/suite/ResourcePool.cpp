@@ -0,0 +1,48 @@
+#include "Suite.h"
+
+#include "hustle/BoundedMPMCQueue.h"
+#include "hustle/ResourcePool.h"
+
+#include <benchmark/benchmark.h>
+#include <memory>
+
+using namespace Hustle;
+
+struct PoolItem {
+	int iSomething;
+};
+
+// Plenty for every thread's magazine plus what each one holds at once
+static const int PoolSize = 16 * 1024;
+static const int HeldPerThread = 4;
+
+// One pool per free list, grown once by whichever benchmark thread gets here first
+template<class FreeList>
+static ResourcePool<PoolItem, FreeList>* NewGrownPool() {
+	auto* pPool = new ResourcePool<PoolItem, FreeList>();
+	pPool->Grow(PoolSize);
+	return pPool;
+}
+
+template<class FreeList>
+static ResourcePool<PoolItem, FreeList>& GrownPool() {
+	static std::unique_ptr<ResourcePool<PoolItem, FreeList>> s_pPool(NewGrownPool<FreeList>());
+	return *s_pPool;
+}
+
+// Every thread takes a few resources from a shared pool and hands them back, mostly through its own magazine
+template<class FreeList>
+static void BM_ResourcePool_GetRelease(benchmark::State& state) {
+	auto& pool = GrownPool<FreeList>();
+
+	PoolItem* pHeld[HeldPerThread];
+	for (auto _ : state) {
+		for (int i = 0; i < HeldPerThread; i++)
+			pHeld[i] = pool.Get();
+		for (int i = 0; i < HeldPerThread; i++)
+			pool.Release(pHeld[i]);
+	}
+	state.SetItemsProcessed(state.iterations() * HeldPerThread);
+}
+BENCHMARK_TEMPLATE(BM_ResourcePool_GetRelease, LockedQueue<PoolItem*>)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ResourcePool_GetRelease, BoundedMPMCQueue<PoolItem*>)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
@@ -0,0 +1,35 @@
+#include "Suite.h"
+
+#include "hustle/SpinLock.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace Hustle;
+
+static SpinLock s_Lock;
+static int s_iShared = 0;
+
+// Every thread hammers one lock around a tiny critical section
+static void BM_SpinLock_Contended(benchmark::State& state) {
+	for (auto _ : state) {
+		s_Lock.Lock();
+		s_iShared++;
+		s_Lock.Unlock();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SpinLock_Contended)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
+
+// Each thread has a lock of its own, the cost of an uncontended Lock()/Unlock()
+static void BM_SpinLock_Uncontended(benchmark::State& state) {
+	SpinLock lock;
+	int iValue = 0;
+	for (auto _ : state) {
+		lock.Lock();
+		iValue++;
+		lock.Unlock();
+		benchmark::DoNotOptimize(iValue);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SpinLock_Uncontended)->ThreadRange(1, MaxBenchThreads())->UseRealTime();
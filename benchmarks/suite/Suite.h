@@ -0,0 +1,6 @@
+#pragma once
+
+#include <algorithm>
+
+// Upper end of the thread sweeps: one per logical core
+int MaxBenchThreads();
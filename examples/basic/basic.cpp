@@ -1,6 +1,6 @@
 #include <iostream>
 #include <string>
-#include <windows.h>
+#include <vector>
 
 #include "hustle/Job.h"
 #include "hustle/Dispatcher.h"
@@ -47,15 +47,13 @@ int main()
         case 1:
             std::cout << "Adding 300 jobs to queue";
 
-            for (auto x = 0; x < 300; x++)
-                Dispatcher::GetInstance().AddJob(JobFunction, nullptr);
+            Dispatcher::GetInstance().AddJobs(std::vector<JobDecl>(300, { JobFunction, nullptr }), nullptr);
 
             break;
         case 2:
             std::cout << "Adding 3000 jobs to queue";
 
-            for (auto x = 0; x < 3000; x++)
-                Dispatcher::GetInstance().AddJob(JobFunction, nullptr);
+            Dispatcher::GetInstance().AddJobs(std::vector<JobDecl>(3000, { JobFunction, nullptr }), nullptr);
 
             break;
         case 3:
@@ -66,11 +64,18 @@ int main()
             std::cout << "available fibers: " << Dispatcher::GetInstance().GetFiberPoolFree() << std::endl;
             std::cout << "total fiber pool size: " << Dispatcher::GetInstance().GetFiberPoolTotal() << std::endl;
 
-            // Print out the high water mark for the various queues
-#ifdef _DEBUG
-            std::cout << "Free Job High Water Mark: " << Dispatcher::GetInstance().GetFreeJobHighWaterMark() << std::endl;
-            std::cout << "Free Fiber High Water Mark: " << Dispatcher::GetInstance().GetFreeFiberHighWaterMark() << std::endl;
-#endif
+            // Print out what the scheduler has been up to, and the high water mark for the pools
+            {
+                DispatcherStats stats = Dispatcher::GetInstance().GetStats();
+                std::cout << "jobs executed: " << stats.iJobsExecuted << std::endl;
+                std::cout << "fiber switches: " << stats.iFiberSwitches << std::endl;
+                std::cout << "steals: " << stats.iSteals << std::endl;
+                std::cout << "remote steals: " << stats.iRemoteSteals << std::endl;
+                std::cout << "fiber pool exhaustions: " << stats.iFiberPoolExhaustions << std::endl;
+                std::cout << "queue wait p50/p99 (ns, under): " << stats.GetQueueWaitPercentile(50) << "/" << stats.GetQueueWaitPercentile(99) << std::endl;
+                std::cout << "Job High Water Mark: " << stats.iJobPoolHighWaterMark << std::endl;
+                std::cout << "Fiber High Water Mark: " << stats.iFiberPoolHighWaterMark[(int)StackClass::Small] << std::endl;
+            }
             break;
         case 0:
             bRunning = false;
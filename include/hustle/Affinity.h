@@ -0,0 +1,95 @@
+#pragma once
+/**********************************************************************
+* Which CPUs the Dispatcher's workers go on. A policy picks the CPUs
+* (every logical CPU, one per physical core, or an explicit set), and
+* whatever it picks is cut down to the CPUs the process is allowed on
+* (sched_getaffinity(), which includes any cgroup cpuset). The default
+* worker count also respects a cgroup CPU quota.
+**********************************************************************/
+
+#include "Topology.h"
+
+#include <string>
+#include <vector>
+
+namespace Hustle {
+
+	/**
+	 * @brief Where Dispatcher::Init() puts its workers. Part of DispatcherConfig.
+	*/
+	struct AffinityPolicy {
+
+		enum class Mode {
+			LogicalCores,		// Pin a worker to each logical CPU, SMT siblings included
+			PhysicalCores,		// Pin a worker to one logical CPU of each physical core, leaving the siblings idle
+			CpuSet,				// Pin a worker to each CPU in cpus
+			Inherit				// Don't pin, workers run wherever the process is allowed to
+		};
+
+		Mode eMode = Mode::LogicalCores;
+
+		// The CPUs to use with Mode::CpuSet
+		std::vector<int> cpus;
+
+		// Keep the first CPU for the thread that calls Init(): it goes last in the placement order, and isn't
+		// counted in the default number of workers
+		bool bReserveFirstCpu = true;
+
+		// Cap the default number of workers at the process's cgroup CPU quota (cpu.max), rounded up
+		bool bHonorCpuQuota = true;
+
+		static AffinityPolicy LogicalCores() { return {}; }
+
+		static AffinityPolicy PhysicalCores() {
+			AffinityPolicy policy;
+			policy.eMode = Mode::PhysicalCores;
+			return policy;
+		}
+
+		static AffinityPolicy CpuSet(std::vector<int> cpus) {
+			AffinityPolicy policy;
+			policy.eMode = Mode::CpuSet;
+			policy.cpus = std::move(cpus);
+			return policy;
+		}
+
+		static AffinityPolicy Inherit() {
+			AffinityPolicy policy;
+			policy.eMode = Mode::Inherit;
+			return policy;
+		}
+
+		/**
+		 * @brief The CPUs to place workers on, in the order to use them
+		 * @param topology - The machine
+		 * @param allowedCpus - CPUs the process may run on, see GetAllowedCpus(). Empty for no restriction.
+		 * @param bNodeOrder - Go NUMA node by node, rather than by CPU number
+		 * @return Empty if nothing is left, which can only happen with Mode::CpuSet
+		*/
+		std::vector<int> GetPlacement(const Topology& topology, const std::vector<int>& allowedCpus, bool bNodeOrder) const;
+
+		/**
+		 * @brief Workers to start when DispatcherConfig::iWorkerThreadCount is -1
+		 * @param iPlacementCount - Size of what GetPlacement() returned
+		 * @param iCpuQuota - See GetCpuQuota()
+		*/
+		int GetDefaultWorkerCount(int iPlacementCount, int iCpuQuota) const;
+
+		/**
+		 * @brief CPUs the process may run on, ascending. Empty if the platform can't say.
+		*/
+		static std::vector<int> GetAllowedCpus();
+
+		/**
+		 * @brief The process's cgroup CPU quota, in whole CPUs rounded up
+		 * @return 0 if there's no quota, or no cgroups
+		*/
+		static int GetCpuQuota();
+
+		/**
+		 * @brief Read a CPU quota from a cgroup directory: cpu.max (v2), or cpu.cfs_quota_us and cpu.cfs_period_us (v1)
+		 * @return 0 if neither is there, or the quota is unlimited
+		*/
+		static int ReadCgroupCpuQuota(const std::string& cgroupDir);
+	};
+}
@@ -0,0 +1,216 @@
+#pragma once
+/**********************************************************************
+* Bounded multi-producer/multi-consumer queue, based on Dmitry Vyukov's
+* sequence numbered ring buffer:
+* https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+*
+* Has the same Push()/Pop()/Size() surface as LockedQueue so it can be
+* used in its place. While the ring has room it never takes a lock and
+* never allocates. Only the ring is bounded: Push() on a full ring
+* spills to an overflow RingBuffer behind a SpinLock, which grows
+* without limit, rather than waiting for a consumer or failing. Use
+* TryPush() to get a bounded queue. Pushes keep spilling until the
+* overflow list drains and Pop() empties the ring before it, so a single
+* producer still sees FIFO order, but with several producers racing a
+* spill, or consumers racing the drain, items can come out of order.
+* PushBulk() is a Push() per item. T must be a pointer type.
+**********************************************************************/
+
+#include "Platform.h"
+#include "RingBuffer.h"
+#include "SpinLock.h"
+
+#include <assert.h>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Hustle {
+
+	template<class T>
+	class BoundedMPMCQueue {
+	public:
+
+		// Covers the Dispatcher's default pools, bigger pools spill to the overflow list
+		static const size_t DefaultCapacity = 1 << 12;
+
+		/**
+		 * @brief Create the queue. The ring is allocated here.
+		 * @param capacity - Number of items the ring holds before spilling, rounded up to a power of two
+		*/
+		BoundedMPMCQueue(size_t capacity = DefaultCapacity) {
+
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+
+			m_iMask = size - 1;
+			m_pCells = new Cell[size];
+			for (size_t i = 0; i < size; i++)
+				m_pCells[i].sequence.store(i, std::memory_order_relaxed);
+
+			m_EnqueuePos.store(0, std::memory_order_relaxed);
+			m_DequeuePos.store(0, std::memory_order_relaxed);
+		}
+
+		~BoundedMPMCQueue() {
+			delete[] m_pCells;
+		}
+
+		BoundedMPMCQueue(const BoundedMPMCQueue&) = delete;
+		BoundedMPMCQueue& operator=(const BoundedMPMCQueue&) = delete;
+
+		/**
+		 * @brief Add an item, unless the queue is full
+		 * @return false if the queue was full
+		*/
+		bool TryPush(T val) {
+			Cell* pCell;
+			size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+
+			for (;;) {
+				pCell = &m_pCells[pos & m_iMask];
+				size_t sequence = pCell->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+				if (diff == 0) {
+					// The cell is free, try to claim it
+					if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0) {
+					// The cell still holds an item from a lap ago, we're full
+					return false;
+				}
+				else {
+					// Another producer got here first
+					pos = m_EnqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			pCell->data = val;
+			pCell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		/**
+		 * @brief Add an item, spilling to the overflow list if the ring is full
+		*/
+		void Push(T val) {
+			if (m_iOverflowCount.load(std::memory_order_acquire) == 0 && TryPush(val))
+				return;
+
+			m_OverflowLock.Lock();
+			m_Overflow.Push(val);
+			m_iOverflowCount.fetch_add(1, std::memory_order_release);
+			m_OverflowLock.Unlock();
+		}
+
+		/**
+		 * @brief Remove the oldest item
+		 * @return The item, or nullptr if the queue is empty
+		*/
+		T Pop() {
+			T val = PopRing();
+			if (val != nullptr || m_iOverflowCount.load(std::memory_order_acquire) == 0)
+				return val;
+
+			// The ring has drained past everything pushed before the spill
+			m_OverflowLock.Lock();
+			if (m_Overflow.Empty() == false) {
+				val = m_Overflow.Pop();
+				m_iOverflowCount.fetch_sub(1, std::memory_order_release);
+			}
+			m_OverflowLock.Unlock();
+			return val;
+		}
+
+		/**
+		 * @brief Push several items. Same as calling Push() for each, there is no lock to amortize.
+		*/
+		void PushBulk(T* pItems, size_t iCount) {
+			for (size_t i = 0; i < iCount; i++)
+				Push(pItems[i]);
+		}
+
+		/**
+		 * @brief Pop up to iMaxCount items, oldest first
+		 * @return The number of items written to pItems
+		*/
+		size_t PopBulk(T* pItems, size_t iMaxCount) {
+			size_t iCount = 0;
+			while (iCount < iMaxCount) {
+				T val = Pop();
+				if (val == nullptr)
+					break;
+				pItems[iCount++] = val;
+			}
+			return iCount;
+		}
+
+		/**
+		 * @brief Approximate number of items in the queue
+		*/
+		size_t Size() {
+			size_t enqueuePos = m_EnqueuePos.load(std::memory_order_relaxed);
+			size_t dequeuePos = m_DequeuePos.load(std::memory_order_relaxed);
+			size_t size = enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+			return size + m_iOverflowCount.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Number of items the ring holds before Push() spills
+		*/
+		size_t Capacity() { return m_iMask + 1; }
+
+	private:
+
+		/**
+		 * @brief Remove the oldest item from the ring, ignoring the overflow list
+		*/
+		T PopRing() {
+			Cell* pCell;
+			size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+
+			for (;;) {
+				pCell = &m_pCells[pos & m_iMask];
+				size_t sequence = pCell->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+				if (diff == 0) {
+					// The cell has been published, try to claim it
+					if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0) {
+					// Nothing has been published here yet, we're empty
+					return nullptr;
+				}
+				else {
+					// Another consumer got here first
+					pos = m_DequeuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			T val = pCell->data;
+			pCell->sequence.store(pos + m_iMask + 1, std::memory_order_release);
+			return val;
+		}
+
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T data;
+		};
+
+		// Producers and consumers each get their own cache line
+		alignas(Platform::CacheLineSize) Cell* m_pCells;
+		size_t m_iMask;
+		alignas(Platform::CacheLineSize) std::atomic<size_t> m_EnqueuePos;
+		alignas(Platform::CacheLineSize) std::atomic<size_t> m_DequeuePos;
+
+		// Only touched once the ring has filled up
+		alignas(Platform::CacheLineSize) std::atomic<size_t> m_iOverflowCount{ 0 };
+		SpinLock m_OverflowLock;
+		RingBuffer<T> m_Overflow;
+	};
+}
@@ -1,18 +1,116 @@
 #pragma once
 
+#include "Affinity.h"
+#include "BoundedMPMCQueue.h"
 #include "Fiber.h"
 #include "Job.h"
+#include "JobCounter.h"
+#include "JobGraph.h"
 #include "LockedQueue.h"
 #include "ResourcePool.h"
 #include "SpinLock.h"
+#include "Stats.h"
 #include "WorkerThread.h"
 
+#include <atomic>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <queue>
 #include <map>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace Hustle {
 
+	template<class R>
+	class JobFuture;
+
+	// Queue type behind the Dispatcher's injection and ready queues and its pool free lists.
+	// Configure with HUSTLE_LOCKFREE_QUEUES to swap the SpinLock'd std::queue for the lock-free ring.
+#if defined(HUSTLE_LOCKFREE_QUEUES)
+	template<class T>
+	using DispatcherQueue = BoundedMPMCQueue<T>;
+#else
+	template<class T>
+	using DispatcherQueue = LockedQueue<T>;
+#endif
+
+	/**
+	 * @brief Size of one of the Dispatcher's fiber pools
+	*/
+	struct FiberPoolConfig {
+		int iFiberCount;		// Fibers allocated up front. 0 to run this class on the other class's pool instead.
+		size_t stackSize;		// Bytes of stack per fiber, not counting the guard page
+
+		// Fibers the pool may add, a few at a time, once iFiberCount are all in use. -1 for DefaultFiberOverflowFactor
+		// times iFiberCount. A job that finds the reserve used up too runs on its worker's own stack instead, and
+		// jobs that worker starts while that job waits get fibers past the reserve.
+		int iOverflowCount = -1;
+	};
+
+	/**
+	 * @brief What a worker does when it finds nothing to run. It spins (CpuPause()) for iSpinCount empty passes,
+	 * then gives up its time slice (ThreadYield()) for iYieldCount more, then sleeps until new work is submitted.
+	 * Spinning wakes up fastest, sleeping costs no CPU while idle.
+	*/
+	struct IdlePolicy {
+		static const uint32_t Forever = UINT32_MAX;
+
+		uint32_t iSpinCount = 128;
+		uint32_t iYieldCount = 16;
+		bool bSleep = true;			// false to keep yielding once the spins and yields are used up
+
+		// Never stop spinning, lowest latency and a full core per idle worker
+		static IdlePolicy Spin() { return { Forever, 0, false }; }
+
+		// Spin briefly, then yield forever. Other threads get the core, but idle workers still show up as busy.
+		static IdlePolicy SpinThenYield() { return { 128, Forever, false }; }
+
+		// Spin, yield, then sleep. The default.
+		static IdlePolicy Sleep() { return {}; }
+	};
+
+	// Overflow reserve for a FiberPoolConfig that leaves iOverflowCount at -1, as a multiple of iFiberCount. The same
+	// room as the single growth step pools used to take before they had a limit.
+	static const int DefaultFiberOverflowFactor = 10;
+
+	// Share of its current size a fiber pool grows by when it dips into the overflow reserve
+	static const float FiberPoolGrowthFactor = 0.25f;
+
+	/**
+	 * @brief Everything Dispatcher::Init() needs to know
+	*/
+	struct DispatcherConfig {
+
+		// One pool per StackClass, indexed by it. With bNumaAware, every NUMA node with workers gets pools of these sizes.
+		FiberPoolConfig fiberPools[StackClassCount] = {
+			{ 128, 64 * 1024 },		// StackClass::Small
+			{ 16, 512 * 1024 },		// StackClass::Large
+		};
+
+		int iJobPoolSize = 1024;
+		int iWorkerThreadCount = -1;		// -1 for one thread per CPU the affinity policy places on, see AffinityPolicy::GetDefaultWorkerCount()
+
+		// Which CPUs the workers are pinned to
+		AffinityPolicy affinity;
+
+		IdlePolicy idlePolicy;
+
+		// Threads outside the Dispatcher (the main thread, typically) run queued jobs while they wait in WaitForJob()
+		// or WaitForCounter(), rather than just yielding. The wait can then run on past the target by as long as the
+		// job the thread picked up takes.
+		bool bHelpWhileWaiting = true;
+
+		// Place workers one NUMA node after another, give each node its own job and fiber pools (first touched by a
+		// worker on the node), and have workers steal from their own node before looking further. false puts every
+		// job and fiber in one set of pools and steals from anyone, as on a single node machine.
+		bool bNumaAware = true;
+	};
+
 	class Dispatcher {
 	public:		
 
@@ -25,11 +123,19 @@ namespace Hustle {
 		 * @brief Initialize the job system. Only to be called once.
 		 * @param iFiberPoolSize - The number of fibers to allocate in fiber pool
 		 * @param iJobPoolSize - The number of items to allocate in the job pool
-		 * @param iWorkerThreadCount - The number of worker threads to allocate. -1 for one thread per logical core.
+		 * @param iWorkerThreadCount - The number of worker threads to allocate. -1 for one per CPU the default AffinityPolicy
+		 * places workers on, capped by the cgroup CPU quota, less one for the reserved first CPU (see AffinityPolicy::GetDefaultWorkerCount()).
 		 * @return
 		*/
 		bool Init(int iFiberPoolSize, int iJobPoolSize, int iWorkerThreadCount = -1);
 
+		/**
+		 * @brief Initialize the job system with a pool of fibers per StackClass. Only to be called once.
+		 * @param config - Pool sizes and worker count
+		 * @return
+		*/
+		bool Init(const DispatcherConfig& config);
+
 		/**
 		 * @brief Stop the job system. All pools will be destroyed.
 		*/
@@ -42,18 +148,148 @@ namespace Hustle {
 		int WorkerThreadCount() { return m_iWorkerThreadCount; }
 		
 		/**
-		 * @brief Put a new job onto the global queue
+		 * @brief Queue a new job. Jobs added from inside a job go onto the current worker's deque, 
+		 * anything else goes onto the global injection queue.
 		 * @param entryPoint - Function to invoke for the job
 		 * @param pUserData - A pointer to data that will be passed into the entry point function
+		 * @param pCounter - Optional counter to decrement when the job completes. The caller is responsible for incrementing it.
+		 * @param ePriority - Queue to put the job on
+		 * @param eStackClass - Fiber pool to run the job on
+		 * @return - Handle to the queued job
+		*/
+		JobHandle AddJob(JobEntryPoint entryPoint, void* pUserData, JobCounter* pCounter = nullptr, JobPriority ePriority = JobPriority::Normal,
+						 StackClass eStackClass = StackClass::Small);
+
+		/**
+		 * @brief Queue a new job at the given priority.
+		*/
+		JobHandle AddJob(JobEntryPoint entryPoint, void* pUserData, JobPriority ePriority) {
+			return AddJob(entryPoint, pUserData, nullptr, ePriority);
+		}
+
+		/**
+		 * @brief Queue a callable with no arguments, typically a lambda. The callable (captures included) is
+		 * stored inside the pooled Job, so this doesn't allocate. Captures bigger than JobEntryPointCapacity
+		 * bytes won't compile.
+		 * @param fn - Callable to invoke for the job
+		 * @param ePriority - Queue to put the job on
+		 * @param pCounter - Optional counter to decrement when the job completes. The caller is responsible for incrementing it.
+		 * @param eStackClass - Fiber pool to run the job on
 		 * @return - Handle to the queued job
 		*/
-		JobHandle AddJob(JobEntryPoint entryPoint, void* pUserData);
+		template<class F, class = std::enable_if_t<std::is_invocable_v<F&>>>
+		JobHandle AddJob(F&& fn, JobPriority ePriority = JobPriority::Normal, JobCounter* pCounter = nullptr, StackClass eStackClass = StackClass::Small) {
+
+			Job* pJob = AcquireJob();
+
+			pJob->SetEntryPoint([fn = std::forward<F>(fn)](void*) mutable { fn(); });
+			pJob->SetUserData(nullptr);
+
+			return QueueJob(pJob, pCounter, ePriority, eStackClass);
+		}
+
+		/**
+		 * @brief Queue a callable that returns an R, e.g. AddJob<int>([]() { return 42; }). The result is kept in
+		 * the pooled Job (on the heap only if it's bigger than JobResultCapacity bytes), which isn't recycled until
+		 * both the job and the future are done with it. Include JobFuture.h to use this.
+		 * @param fn - Callable to invoke for the job, its return value converted to R
+		 * @param ePriority - Queue to put the job on
+		 * @param pCounter - Optional counter to decrement when the job completes. The caller is responsible for incrementing it.
+		 * @param eStackClass - Fiber pool to run the job on
+		 * @return - Future for the result
+		*/
+		template<class R, class F, class = std::enable_if_t<std::is_invocable_r_v<R, F&>>>
+		JobFuture<R> AddJob(F&& fn, JobPriority ePriority = JobPriority::Normal, JobCounter* pCounter = nullptr, StackClass eStackClass = StackClass::Small) {
+
+			Job* pJob = AcquireJob();
+
+			pJob->SetEntryPoint([fn = std::forward<F>(fn)](void* pArg) mutable {
+				if constexpr (std::is_void_v<R>)
+					fn();
+				else
+					((Job*)pArg)->EmplaceResult<R>(fn());
+			});
+			pJob->SetUserData(pJob);
+
+			// One for the run, one for the future
+			pJob->GetRefCount().store(2, std::memory_order_relaxed);
+
+			return JobFuture<R>(QueueJob(pJob, pCounter, ePriority, eStackClass));
+		}
 
 		/**
-		 * @brief - Poll for the job to reach completion. Will not return until the specified job is complete.
-		 * @param hJob - Handle for the job to poll for completion
+		 * @brief Queue a short callback that runs on the dequeuing thread's own stack instead of a pooled fiber.
+		 * This is how suspended coroutines (see Task.h) are resumed: their state lives in their own frame, so
+		 * they don't need a stack of their own. Waiting in the callback makes the thread run other work meanwhile.
+		 * @param entryPoint - Callback
+		 * @param pUserData - Passed to the callback
+		 * @param ePriority - Queue to put the callback on
 		*/
-		void WaitForJob(JobHandle hJob);
+		void AddContinuation(JobEntryPoint entryPoint, void* pUserData, JobPriority ePriority = JobPriority::Normal);
+
+		/**
+		 * @brief Queue a group of jobs that all decrement the same counter as they complete. The counter is the
+		 * completion handle for the whole batch. Jobs are taken from the pool and pushed onto the queues in bulk,
+		 * BulkChunkSize at a time, rather than locking the pool and queue once per job.
+		 * @param pJobs - Array of job declarations
+		 * @param iCount - Number of entries in pJobs
+		 * @param pCounter - Incremented by iCount before any job is queued. May be nullptr.
+		*/
+		void AddJobs(const JobDecl* pJobs, int iCount, JobCounter* pCounter);
+
+		/**
+		 * @brief Queue every JobDecl in a contiguous container (std::vector, std::array, a C array, ...)
+		*/
+		template<class Container, class = decltype(std::data(std::declval<const Container&>()))>
+		void AddJobs(const Container& jobs, JobCounter* pCounter) {
+			AddJobs(std::data(jobs), (int)std::size(jobs), pCounter);
+		}
+
+		// Most jobs AddJobs() takes from the pool and pushes in one go. Its scratch arrays are on the stack,
+		// which may be a small fiber stack, so this stays modest.
+		static constexpr int BulkChunkSize = 64;
+
+		/**
+		 * @brief Run every node of a graph, each one as soon as its last predecessor finishes. Successors are queued
+		 * by the job that releases them (or run straight away on the same fiber, if it's the first one released and
+		 * has the same priority and stack class), so no fiber is ever parked on a dependency. The graph must not be
+		 * changed or run again until the run is complete.
+		 * @param graph - Graph to run
+		 * @param pCounter - Incremented by the node count, and decremented as each node completes. May be nullptr.
+		 * @return false, with nothing queued and the counter left alone, if the graph has a cycle and could never finish
+		*/
+		bool RunGraph(JobGraph& graph, JobCounter* pCounter);
+
+		/**
+		 * @brief - Wait for the job to reach completion. Will not return until the specified job is complete.
+		 * From inside a job the fiber is parked until the job finishes, freeing the worker to run something else.
+		 * @param hJob - Handle for the job to wait on
+		 * @param bRunInline - If no worker has started the job yet, run it right here on the caller's stack instead.
+		 * Skipped from a job whose stack class is smaller than the waited on job's.
+		*/
+		void WaitForJob(JobHandle hJob, bool bRunInline = false);
+
+		/**
+		 * @brief Wait until a counter drops to (or below) the target value. From inside a job the fiber is
+		 * parked on the counter and only resumed once the target is reached. Any other thread runs queued
+		 * jobs while it waits, unless DispatcherConfig::bHelpWhileWaiting was turned off.
+		 * @param pCounter - Counter passed to AddJobs()/AddJob()
+		 * @param iTarget - Value to wait for, 0 to wait for every job
+		*/
+		void WaitForCounter(JobCounter* pCounter, int iTarget = 0);
+
+		/**
+		 * @brief Polled by WaitUntil() between jobs
+		 * @return true once the wait is over
+		*/
+		typedef bool (*WaitCondition)(void* pWaitObject);
+
+		/**
+		 * @brief Wait for a condition outside of a fiber, the way WaitForCounter() does: run queued jobs and woken
+		 * fibers until it holds, or just yield if helping is off. For the fiber synchronization primitives, which
+		 * can't park a job running on a worker's own stack.
+		*/
+		void WaitUntil(WaitCondition pfnDone, void* pWaitObject);
 
 		/**
 		 * @brief If in a job, give execution control back to the scheduler. If called outside a job, invoke the system Yield().
@@ -64,51 +300,308 @@ namespace Hustle {
 		 * @brief Query the current number of items in the job queue
 		 * @return The current number of items in the job queue 
 		*/
-		size_t GetJobQueueDepth() { return m_Jobs.Size(); }
+		size_t GetJobQueueDepth();
+
+		/**
+		 * @brief Query the current number of queued jobs at one priority
+		 * @return The current number of items in the priority's queues
+		*/
+		size_t GetJobQueueDepth(JobPriority ePriority);
 
 		/**
 		 * @brief Query the current number of free jobs in the job pool
 		 * @return Free job count
 		*/
-		size_t GetFreeJobCount() { return m_JobPool.GetFreeCount(); }
+		size_t GetFreeJobCount();
 
 		/**
 		 * @brief Query the total number of jobs in the job pool
 		 * @return Total job pool item count
 		*/
-		size_t GetFreeJobTotal() { return m_JobPool.GetTotalCount(); }
+		size_t GetFreeJobTotal();
 
-#ifdef _DEBUG
-		int GetFreeJobHighWaterMark() { return m_JobPool.GetHighWaterMark(); }
-		int GetFreeFiberHighWaterMark() { return m_FiberPool.GetHighWaterMark(); }
-#endif
+		/**
+		 * @brief Total number of times the schedulers have switched into a fiber, to start or resume a job
+		*/
+		uint64_t GetFiberSwitchCount();
+
+		/**
+		 * @brief Add up every worker's counters, and the pools' high water marks. Workers keep counting while this
+		 * runs, so the numbers may be a few jobs apart from each other.
+		 * @return Totals since Init()
+		*/
+		DispatcherStats GetStats();
+
+		// One job in this many has its queue wait timed for DispatcherStats, so most jobs never read the clock
+		static const uint32_t QueueWaitSampleInterval = 16;
+
+		// Most jobs a thread runs nested on its own stack, each waiting on the next. Past the first, only continuations
+		// (see AddContinuation()) nest. A wait at this depth only resumes woken fibers and takes no more jobs from the
+		// queues until it's over.
+		static const int MaxThreadStackDepth = 8;
+
+		/**
+		 * @brief Number of workers currently asleep, waiting for work
+		*/
+		int GetSleepingWorkerCount() { return m_iSleepingWorkers.load(std::memory_order_relaxed); }
+
+		/**
+		 * @brief Fibers in every pool, free or not
+		*/
+		size_t GetFiberPoolTotal();
+
+		/**
+		 * @brief Free fibers in every pool
+		*/
+		size_t GetFiberPoolFree();
+
+		/**
+		 * @brief Fibers in the pools a stack class runs on, on every node. Classes sharing a pool report the same numbers.
+		*/
+		size_t GetFiberPoolTotal(StackClass eStackClass);
+		size_t GetFiberPoolFree(StackClass eStackClass);
+
+		/**
+		 * @brief NUMA nodes the workers were placed on. Each has its own pools, unless DispatcherConfig::bNumaAware is off.
+		*/
+		int GetNodeCount() { return m_iNodeCount; }
 
-		size_t GetFiberPoolTotal() { return m_FiberPool.GetTotalCount(); }
-		size_t GetFiberPoolFree() { return m_FiberPool.GetFreeCount(); }
+		/**
+		 * @brief Write what every thread has been doing (job starts and ends, fiber switches, steals, idle periods and
+		 * waits) to a file as Chrome trace JSON, for chrome://tracing or ui.perfetto.dev. See Trace.h.
+		 * @param path - File to write
+		 * @return false if the file couldn't be written, or tracing was compiled out (no HUSTLE_TRACING)
+		*/
+		bool DumpTrace(const std::string& path);
 
 		std::string GetLastError() { return m_LastError; }
 
 	private:
 		Dispatcher();
-		static DWORD WINAPI Scheduler(LPVOID pData);
+		static void Scheduler(WorkerThread* pWorkerThread);
+
+		/**
+		 * @brief Find the next job for a worker, highest priority first. Every NormalPriorityInterval'th call starts with
+		 * Normal and every LowPriorityInterval'th call starts with Low, so a flood of higher priority work can't starve them.
+		 * @param pWorkerThread - The worker looking for a job
+		 * @param uRandomState - Per worker xorshift state used to pick steal victims
+		 * @param iDispatchCount - Per worker count of calls, drives the anti-starvation passes
+		 * @return The job, or nullptr if nothing was found
+		*/
+		Job* GetNextJob(WorkerThread* pWorkerThread, uint32_t& uRandomState, uint32_t& iDispatchCount);
+
+		/**
+		 * @brief Find a job of one priority: the worker's own deque (LIFO), then the injection queue, then steal (FIFO) from another worker.
+		 * pWorkerThread is nullptr for a thread helping out in WaitForCounter(), which only has the last two.
+		*/
+		Job* GetNextJob(WorkerThread* pWorkerThread, uint32_t& uRandomState, JobPriority ePriority);
+
+		static const uint32_t NormalPriorityInterval = 4;
+		static const uint32_t LowPriorityInterval = 16;
+
+		/**
+		 * @brief Take a free job from the pool
+		*/
+		Job* AcquireJob();
+
+		/**
+		 * @brief Finish setting up a job whose entry point is already set, then push it onto a queue
+		*/
+		JobHandle QueueJob(Job* pJob, JobCounter* pCounter, JobPriority ePriority, StackClass eStackClass = StackClass::Small);
+
+		typedef ResourcePool<Fiber, DispatcherQueue<Fiber*>> FiberPool;
+		typedef ResourcePool<Job, DispatcherQueue<Job*>> JobPool;
+
+		/**
+		 * @brief A NUMA node's job and fiber pools. Created by the first worker on the node, so the pools' memory and
+		 * every resource in them is first touched (and so placed) on that node.
+		*/
+		struct NodePools {
+			// One per stack class
+			FiberPool fiberPools[StackClassCount];
+
+			// Pool each stack class actually uses. A class configured with no fibers points at the other class's pool.
+			FiberPool* pFiberPoolForClass[StackClassCount];
+
+			JobPool jobPool;
+		};
+
+		/**
+		 * @brief Create a node's pools, sized by the DispatcherConfig passed to Init(). Called on a thread running on the node.
+		*/
+		void CreateNodePools(int iNode);
+
+		/**
+		 * @brief The node whose pools take a node's jobs and fibers: itself, or node 0 when not NUMA aware
+		*/
+		int GetPoolNode(int iNode) { return m_bNumaAware ? iNode : 0; }
+
+		/**
+		 * @brief Node of the calling thread: its worker's, or for any other thread the node of the CPU it's on right now
+		*/
+		int GetThreadNode();
+
+		/**
+		 * @brief The pool jobs of a stack class take their fibers from, on a node
+		*/
+		FiberPool& GetFiberPool(int iNode, StackClass eStackClass) { return *m_NodePools[GetPoolNode(iNode)]->pFiberPoolForClass[(int)eStackClass]; }
+
+		/**
+		 * @brief The pool the calling thread takes jobs from
+		*/
+		JobPool& GetJobPool() { return m_NodePools[GetPoolNode(GetThreadNode())]->jobPool; }
+
+		/**
+		 * @brief Return a job to the pool of the node it came from
+		*/
+		void ReleaseJob(Job* pJob) {
+
+			// Held by a JobFuture as well. Whoever lets go last releases it. Without one there's no need for the RMW.
+			std::atomic<int>& iRefCount = pJob->GetRefCount();
+			if (iRefCount.load(std::memory_order_acquire) != 1 && iRefCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+
+			iRefCount.store(1, std::memory_order_relaxed);
+			pJob->DestroyResult();
+			pJob->SetContinuation(false);
+			m_NodePools[pJob->GetNode()]->jobPool.Release(pJob);
+		}
+
+		/**
+		 * @brief Queue a graph node whose predecessors have all finished
+		*/
+		void QueueGraphNode(JobGraph* pGraph, JobGraph::NodeId node, JobCounter* pCounter);
+
+		/**
+		 * @brief Body of a graph node's job. Runs the node, releases its successors, and keeps going with the first
+		 * successor that became ready if it can run on this fiber.
+		*/
+		void RunGraphNodes(JobGraph* pGraph, JobGraph::NodeId node, JobCounter* pCounter);
+
+		/**
+		 * @brief Signal a finished job's counters, then return the job to the pool.
+		*/
+		void CompleteJob(Job* pJob);
+
+		/**
+		 * @brief Signal anyone waiting on a finished job: its completion, then its group counter
+		*/
+		void SignalJob(Job* pJob);
+
+		/**
+		 * @brief Start a dequeued job on a pooled fiber and deal with it once it switches out. If the pool and its
+		 * overflow reserve are used up, the job runs to completion on the calling thread's stack instead.
+		 * @param pThisFiber - The calling thread's own fiber, for the job to return to
+		 * @param bGrowPastMax - Grow the pool past its overflow reserve rather than run the job on this thread's stack
+		 * @return false if the job didn't get a fiber: WaitForJob() had already run it inline, or the pool ran out
+		*/
+		bool RunJob(Job* pJob, Fiber* pThisFiber, bool bGrowPastMax = false);
+
+		/**
+		 * @brief Run a started job to completion on the calling thread's own stack, without a fiber. HelpUntil()
+		 * stops taking jobs at MaxThreadStackDepth, so the nest never goes deeper than that.
+		*/
+		void RunJobOnThreadStack(Job* pJob);
+
+		/**
+		 * @brief WaitForJob() side of running a job inline
+		 * @return false if the job had already been started, or needs a bigger stack than the caller's
+		*/
+		bool RunJobInline(Job* pJob);
+
+		/**
+		 * @brief Run queued jobs and woken fibers on the calling thread's own stack until the condition holds.
+		 * For threads outside the Dispatcher, and for a job a worker runs on its own stack when its fiber pool is used up.
+		 * Waiting in a job on the thread's stack, every job it starts but continuations gets a fiber, even past the
+		 * pool's overflow reserve. With MaxThreadStackDepth jobs nested on the thread already it only resumes woken fibers.
+		*/
+		void HelpUntil(WaitCondition pfnDone, void* pWaitObject);
+
+		/**
+		 * @brief Queue a parked fiber to be resumed. Goes onto the current worker's ready list, or the global one from any other thread.
+		*/
+		void ReadyFiber(Fiber* pFiber);
+
+		/**
+		 * @brief Let sleeping workers know there's new work
+		 * @param iCount - How many pieces of work were added, at most this many workers are woken
+		*/
+		void WakeWorkers(int iCount);
+
+		/**
+		 * @brief Called by a worker that found nothing to do, backs off according to the idle policy
+		 * @param pWorkerThread - The idle worker
+		 * @param iIdlePasses - Number of empty passes in a row before this one
+		*/
+		void Idle(WorkerThread* pWorkerThread, uint32_t iIdlePasses);
+
+		/**
+		 * @brief Whether any queue has a job or ready fiber in it. Workers check this after announcing they are about to sleep.
+		*/
+		bool HasQueuedWork();
+
+		/**
+		 * @brief Deal with a fiber that just switched back to the scheduler: finished, parked, or yielded.
+		*/
+		void OnFiberSwitchedOut(Fiber* pFiber);
+
+		/**
+		 * @brief Counters for the calling thread: its worker's, or the shared block for threads helping out in a wait
+		*/
+		WorkerStats& GetThreadStats();
+
+		/**
+		 * @brief Stamp the queue time on every QueueWaitSampleInterval'th job this thread queues, clear it on the rest
+		*/
+		void StampQueuedTime(Job* pJob);
 		
 		int m_iWorkerThreadCount;
 		WorkerThread* m_pWorkerThreads;
 		std::atomic<uint32_t> m_RunningThreads;
 
-		// Pool of available fibers
-		ResourcePool<Fiber>	m_FiberPool;
+		// Job and fiber pools, one set per node the workers are on, or a single set when not NUMA aware
+		std::vector<std::unique_ptr<NodePools>> m_NodePools;
+
+		// NUMA nodes with workers on them, numbered from 0 in the OS's order
+		int m_iNodeCount;
+		bool m_bNumaAware;
+
+		// Indices of the workers on each node, and the node of each logical CPU (-1 for those without workers)
+		std::vector<std::vector<int>> m_NodeWorkers;
+		std::vector<int> m_NodeOfCpu;
+
+		// What Init() was given, for the workers that create their node's pools
+		DispatcherConfig m_Config;
 
-		// Queue of jobs to run
-		LockedQueue<Job*> m_Jobs;
+		// Jobs submitted from outside of the worker threads, one queue per priority
+		DispatcherQueue<Job*> m_InjectedJobs[JobPriorityCount];
 
-		// The pool of Job objects to use for scheduling
-		ResourcePool<Job> m_JobPool;
+		// Fibers woken by threads that aren't workers
+		DispatcherQueue<Fiber*> m_ReadyFibers;
+
+		IdlePolicy m_IdlePolicy;
+		bool m_bHelpWhileWaiting;
+
+		// Counters for threads outside the Dispatcher that run jobs in HelpUntil(). Any number of them, so it's shared.
+		WorkerStats m_HelperStats;
+
+		// Sleeping workers block on this until it changes. Bumped whenever work is added while any are asleep.
+		alignas(Platform::CacheLineSize) std::atomic<uint32_t> m_iWakeEpoch;
+		std::atomic<int> m_iSleepingWorkers;
 
 		// Holds any errors that occur by the scheduler or worker threads.
 		std::string m_LastError;
 
 		// Allow the WorkerThread class access to Scheduler()
 		friend class WorkerThread;
+
+		// Allow JobCounter and the fiber sync primitives to hand woken fibers back via ReadyFiber()
+		friend class JobCounter;
+		friend class FiberSemaphore;
+		friend class FiberEvent;
+
+		// Futures let go of their job with ReleaseJob()
+		template<class R>
+		friend class JobFuture;
 	};
 }
\ No newline at end of file
@@ -1,20 +1,61 @@
 #pragma once
 
-#include <map>
-#include <windows.h>
+#include "Platform.h"
+
+#include <stddef.h>
 
 namespace Hustle {
 	class Job;
+	class JobCounter;
 
 	class Fiber {
 	public:
+		// Matches the default stack reservation CreateFiber() uses on Windows
+		static const size_t DefaultStackSize = 1024 * 1024;
+
 		Fiber();
+
+		/**
+		 * @brief Create a fiber with its own stack
+		 * @param stackSize - Bytes of stack. Overflowing it faults on the guard page below it.
+		*/
+		explicit Fiber(size_t stackSize);
 		Fiber(const Fiber& fiber);
 		Fiber(void* pFiberHandle);
 		~Fiber();
 
 		void Activate(Job* pJob, Fiber* pParent);
 
+		/**
+		 * @brief Switch back into a fiber that yielded or was parked. The fiber may have last run on a different thread.
+		 * @param pParent - The scheduler fiber to return to
+		*/
+		void Resume(Fiber* pParent);
+
+		/**
+		 * @brief Puts a fiber that has just switched out onto the wait list of whatever it's waiting for. Called by the
+		 * scheduler, never by the fiber itself.
+		 * @return false if the wait is already over and the fiber should be resumed right away
+		*/
+		typedef bool (*ParkFunction)(void* pWaitObject, Fiber* pFiber, int iWaitTarget);
+
+		/**
+		 * @brief Called from inside the fiber. Switch back to the scheduler, which parks the fiber with
+		 * pfnPark(pWaitObject, this, iWaitTarget). It stays parked until handed to Dispatcher::ReadyFiber().
+		*/
+		void Park(ParkFunction pfnPark, void* pWaitObject, int iWaitTarget);
+
+		/**
+		 * @brief Called from inside the fiber. Switch back to the scheduler and stay parked until the counter reaches iTarget.
+		*/
+		void WaitForCounter(JobCounter* pCounter, int iTarget);
+
+		/**
+		 * @brief Called by the scheduler once a Waiting fiber has switched out
+		 * @return false if the fiber should be resumed right away
+		*/
+		bool FinishParking() { return m_pfnPark(m_pWaitObject, this, m_iWaitTarget); }
+
 		enum class State {
 			None,		// Created, but never activated
 			Running,	// Running a job
@@ -27,18 +68,31 @@ namespace Hustle {
 		Job* CurrentJob() { return m_pJob; }
 		void* GetFiberHandle() { return m_hFiber; }
 
-		static Fiber* Fiber::GetCurrentFiber();
+		// NUMA node (Dispatcher's numbering) of the pool the fiber belongs to, so it goes back to the right one
+		void SetNode(int iNode) { m_iNode = iNode; }
+		int GetNode() { return m_iNode; }
+
+		/**
+		 * @brief The fiber running the calling job, or nullptr outside of a job (including in the scheduler itself)
+		*/
+		static Fiber* GetCurrentFiber();
+
+		/**
+		 * @brief Turn the calling thread into a fiber so it can switch to other fibers.
+		 * @return OS handle for the thread's fiber, to be wrapped with Fiber(void* pFiberHandle)
+		*/
+		static void* ConvertCurrentThread();
 
-		void SwitchTo() { ::SwitchToFiber(m_hFiber); }
+		void SwitchTo();
 
 	private:
 
 		// The while(1) loop to process the jobs
-		static void __stdcall Run(void* pData);
+		static void HUSTLE_FIBER_CALL Run(void* pData);
 
 		State	m_eState;
 
-		// Handle returned by CreateFiber()
+		// Handle returned by CreateFiber() on Windows, or a Context::FiberContext* everywhere else
 		void* m_hFiber;
 
 		// Parent fiber to switch to when the current job is complete
@@ -47,8 +101,19 @@ namespace Hustle {
 		// Current job being executed
 		Job* m_pJob;
 
-		// A map of the fibers, keyed on the pointer returned by CreateFiber()
-		// This allows us to call the Win32 GetCurrentFiber() function and grab the Fiber object. 
-		static std::map<void*, Fiber*>	s_FiberMap;
+		// What the fiber is waiting on while in the Waiting state, and how to park it there
+		ParkFunction m_pfnPark;
+		void* m_pWaitObject;
+		int m_iWaitTarget;
+
+		// Link for the wait lists of JobCounter and the fiber sync primitives
+		Fiber* m_pNextWaiter;
+		friend class JobCounter;
+		friend class FiberWaitList;
+
+		// Wraps a thread converted with ConvertCurrentThread() rather than running jobs. GetCurrentFiber() reports nullptr while it runs.
+		bool m_bThreadFiber;
+
+		int m_iNode;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,180 @@
+#pragma once
+/**********************************************************************
+* Synchronization primitives for code running in jobs. When they have
+* to wait, the current fiber is parked on the primitive and the worker
+* goes on to run other jobs, rather than spinning the way a SpinLock
+* does. Parked fibers are handed back to the scheduler by whoever ends
+* the wait. Called from a thread that isn't running a job, or from a
+* job running on a worker's own stack, they wait the way
+* Dispatcher::WaitForCounter() does, running other jobs meanwhile.
+**********************************************************************/
+
+#include "Platform.h"
+#include "SpinLock.h"
+
+#include <atomic>
+
+namespace Hustle {
+	class Fiber;
+
+	/**
+	 * @brief FIFO list of parked fibers, linked through the fibers themselves
+	*/
+	class FiberWaitList {
+	public:
+		FiberWaitList() :
+			m_pHead(nullptr),
+			m_pTail(nullptr) {
+		}
+
+		bool Empty() const { return m_pHead == nullptr; }
+
+		void PushBack(Fiber* pFiber);
+
+		/**
+		 * @return The longest waiting fiber, or nullptr if the list is empty
+		*/
+		Fiber* PopFront();
+
+	private:
+		Fiber* m_pHead;
+		Fiber* m_pTail;
+	};
+
+	/**
+	 * @brief Counting semaphore. Acquire() takes a unit, parking the fiber while there are none, and Release()
+	 * resumes parked fibers with the units it gives back. Not strictly FIFO: a fiber that arrives while a unit
+	 * is on its way to a parked one may take it first. Must not be destroyed while a Release() might still be running.
+	*/
+	class FiberSemaphore {
+	public:
+		explicit FiberSemaphore(int iCount = 0) :
+			m_iCount(iCount),
+			m_iWaiterCount(0) {
+		}
+
+		FiberSemaphore(const FiberSemaphore&) = delete;
+		FiberSemaphore& operator=(const FiberSemaphore&) = delete;
+
+		/**
+		 * @brief Take a unit, waiting for one if there are none
+		*/
+		void Acquire();
+
+		/**
+		 * @brief Take a unit if one is available right now
+		 * @return true if a unit was taken
+		*/
+		bool TryAcquire() {
+			int iCount = m_iCount.load(std::memory_order_relaxed);
+			while (iCount > 0) {
+				if (m_iCount.compare_exchange_weak(iCount, iCount - 1, std::memory_order_acquire, std::memory_order_relaxed))
+					return true;
+			}
+			return false;
+		}
+
+		/**
+		 * @brief Give back iCount units, resuming up to that many parked fibers
+		*/
+		void Release(int iCount = 1);
+
+		/**
+		 * @brief Units available right now
+		*/
+		int GetCount() const { return m_iCount.load(std::memory_order_relaxed); }
+
+	private:
+
+		/**
+		 * @brief Scheduler side of Acquire(), see Fiber::ParkFunction
+		*/
+		static bool Park(void* pWaitObject, Fiber* pFiber, int iWaitTarget);
+
+		std::atomic<int> m_iCount;
+
+		// Fibers parked, or about to be, in Acquire(). Release() only takes the wait lock when this isn't 0.
+		std::atomic<int> m_iWaiterCount;
+
+		SpinLock m_WaitLock;
+		FiberWaitList m_Waiters;
+	};
+
+	/**
+	 * @brief Mutual exclusion for jobs. A contended Lock() spins briefly, then parks the fiber until the holder
+	 * unlocks. Not recursive. Meets the Lockable requirements, so std::lock_guard and std::unique_lock work with it.
+	*/
+	class FiberMutex {
+	public:
+		// Attempts at the lock before parking, for critical sections shorter than a fiber switch
+		static const int SpinCount = 64;
+
+		FiberMutex() :
+			m_Semaphore(1) {
+		}
+
+		void lock() { Lock(); }
+		bool try_lock() { return TryLock(); }
+		void unlock() { Unlock(); }
+
+		void Lock() {
+			for (int i = 0; i < SpinCount; i++) {
+				if (m_Semaphore.TryAcquire())
+					return;
+				Platform::CpuPause();
+			}
+
+			m_Semaphore.Acquire();
+		}
+
+		bool TryLock() { return m_Semaphore.TryAcquire(); }
+
+		void Unlock() { m_Semaphore.Release(); }
+
+	private:
+		FiberSemaphore m_Semaphore;
+	};
+
+	/**
+	 * @brief Manual reset event. Wait() parks the fiber until Set() is called, and returns straight away while
+	 * the event stays set. It may be destroyed as soon as Wait() returns.
+	*/
+	class FiberEvent {
+	public:
+		FiberEvent(bool bSet = false) :
+			m_bSet(bSet) {
+		}
+
+		FiberEvent(const FiberEvent&) = delete;
+		FiberEvent& operator=(const FiberEvent&) = delete;
+
+		/**
+		 * @brief Set the event and resume every fiber waiting on it
+		*/
+		void Set();
+
+		/**
+		 * @brief Clear the event, so later calls to Wait() wait again
+		*/
+		void Reset() { m_bSet.store(false, std::memory_order_relaxed); }
+
+		bool IsSet() const { return m_bSet.load(std::memory_order_acquire); }
+
+		/**
+		 * @brief Wait for the event to be set
+		*/
+		void Wait();
+
+	private:
+
+		/**
+		 * @brief Scheduler side of Wait(), see Fiber::ParkFunction
+		*/
+		static bool Park(void* pWaitObject, Fiber* pFiber, int iWaitTarget);
+
+		std::atomic<bool> m_bSet;
+
+		SpinLock m_WaitLock;
+		FiberWaitList m_Waiters;
+	};
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <assert.h>
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+
+namespace Hustle {
+
+	template<class Signature, size_t Capacity>
+	class InlineFunction;
+
+	/**
+	 * @brief Type erased callable, like std::function, except the target is always stored inside the object.
+	 * Anything bigger than Capacity bytes is a compile error instead of a heap allocation, so creating, moving
+	 * and calling one never touches the heap. Like std::function it can be copied, so the target has to be copyable
+	 * too: a lambda capturing a move-only value doesn't convert.
+	*/
+	template<class R, class... Args, size_t Capacity>
+	class InlineFunction<R(Args...), Capacity> {
+	public:
+
+		InlineFunction() :
+			m_pInvoke(nullptr),
+			m_pManage(nullptr) {
+		}
+
+		InlineFunction(std::nullptr_t) :
+			InlineFunction() {
+		}
+
+		// Copying is type erased, so a move-only target has to be turned away here, while its type is still known
+		template<class F, class Target = typename std::decay<F>::type,
+			class = typename std::enable_if<!std::is_same<Target, InlineFunction>::value && !std::is_same<Target, std::nullptr_t>::value &&
+				std::is_copy_constructible<Target>::value>::type>
+		InlineFunction(F&& fn) {
+
+			static_assert(sizeof(Target) <= Capacity, "Callable is too big for InlineFunction, capture less or capture a pointer");
+			static_assert(alignof(Target) <= alignof(max_align_t), "Callable is over-aligned for InlineFunction");
+
+			new (m_Storage) Target(std::forward<F>(fn));
+			m_pInvoke = &Invoke<Target>;
+			m_pManage = &Manage<Target>;
+		}
+
+		InlineFunction(const InlineFunction& other) :
+			InlineFunction() {
+			CopyFrom(other);
+		}
+
+		InlineFunction(InlineFunction&& other) noexcept :
+			InlineFunction() {
+			MoveFrom(other);
+		}
+
+		~InlineFunction() {
+			Reset();
+		}
+
+		InlineFunction& operator=(const InlineFunction& other) {
+			if (this != &other) {
+				Reset();
+				CopyFrom(other);
+			}
+			return *this;
+		}
+
+		InlineFunction& operator=(InlineFunction&& other) noexcept {
+			if (this != &other) {
+				Reset();
+				MoveFrom(other);
+			}
+			return *this;
+		}
+
+		InlineFunction& operator=(std::nullptr_t) {
+			Reset();
+			return *this;
+		}
+
+		R operator()(Args... args) const {
+			assert(m_pInvoke != nullptr);
+			return m_pInvoke(const_cast<unsigned char*>(m_Storage), std::forward<Args>(args)...);
+		}
+
+		explicit operator bool() const { return m_pInvoke != nullptr; }
+
+	private:
+
+		enum class Operation {
+			Copy,
+			Move,
+			Destroy
+		};
+
+		typedef R(*InvokeFn)(void* pStorage, Args... args);
+		typedef void(*ManageFn)(Operation eOp, void* pDest, void* pSource);
+
+		template<class Target>
+		static R Invoke(void* pStorage, Args... args) {
+			return (*static_cast<Target*>(pStorage))(std::forward<Args>(args)...);
+		}
+
+		template<class Target>
+		static void Manage(Operation eOp, void* pDest, void* pSource) {
+			switch (eOp) {
+			case Operation::Copy:
+				new (pDest) Target(*static_cast<const Target*>(pSource));
+				break;
+			case Operation::Move:
+				new (pDest) Target(std::move(*static_cast<Target*>(pSource)));
+				static_cast<Target*>(pSource)->~Target();
+				break;
+			case Operation::Destroy:
+				static_cast<Target*>(pDest)->~Target();
+				break;
+			}
+		}
+
+		void Reset() {
+			if (m_pManage)
+				m_pManage(Operation::Destroy, m_Storage, nullptr);
+
+			m_pInvoke = nullptr;
+			m_pManage = nullptr;
+		}
+
+		void CopyFrom(const InlineFunction& other) {
+			if (other.m_pManage) {
+				other.m_pManage(Operation::Copy, m_Storage, const_cast<unsigned char*>(other.m_Storage));
+				m_pInvoke = other.m_pInvoke;
+				m_pManage = other.m_pManage;
+			}
+		}
+
+		void MoveFrom(InlineFunction& other) {
+			if (other.m_pManage) {
+				other.m_pManage(Operation::Move, m_Storage, other.m_Storage);
+				m_pInvoke = other.m_pInvoke;
+				m_pManage = other.m_pManage;
+				other.m_pInvoke = nullptr;
+				other.m_pManage = nullptr;
+			}
+		}
+
+		alignas(max_align_t) unsigned char m_Storage[Capacity];
+		InvokeFn m_pInvoke;
+		ManageFn m_pManage;
+	};
+}
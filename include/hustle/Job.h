@@ -1,42 +1,194 @@
 #pragma once
 
-#include <functional>
-#include "SpinLock.h"
+#include "InlineFunction.h"
+#include "JobCounter.h"
+
+#include <assert.h>
+#include <atomic>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
 
 namespace Hustle {
-	typedef std::function<void(void* pArg)> JobEntryPoint;
+	// Size of the inline capture storage in a JobEntryPoint. With the two function pointers it makes a 64 byte callable.
+	static const size_t JobEntryPointCapacity = 48;
+
+	// Lambda captures are stored inside the Job itself, so queueing a job never allocates
+	typedef InlineFunction<void(void* pArg), JobEntryPointCapacity> JobEntryPoint;
+
+	// Size of the result storage in a Job, for Dispatcher::AddJob<R>(). Bigger results go on the heap.
+	static const size_t JobResultCapacity = 32;
+
+	/**
+	 * @brief Scheduling priority. Workers always look for higher priority jobs first, 
+	 * except for a periodic pass that favors lower priorities so they can't starve.
+	*/
+	enum class JobPriority {
+		High,
+		Normal,
+		Low,
+		Count
+	};
+
+	static const int JobPriorityCount = (int)JobPriority::Count;
+
+	/**
+	 * @brief Which fiber pool a job runs on. Small stacks keep big fan-outs cheap, Large is for jobs with deep
+	 * call stacks or big locals. Sizes and counts are set by DispatcherConfig.
+	*/
+	enum class StackClass {
+		Small,
+		Large,
+		Count
+	};
 
-	class Job : public SpinLock {
+	static const int StackClassCount = (int)StackClass::Count;
+
+	/**
+	 * @brief Description of a job to queue with Dispatcher::AddJobs()
+	*/
+	struct JobDecl {
+		JobEntryPoint entryPoint;
+		void* pUserData;
+		JobPriority ePriority = JobPriority::Normal;
+		StackClass eStackClass = StackClass::Small;
+	};
+
+	class Job {
 	public:
+
+		/**
+		 * @brief Who started the job. Normally the worker that dequeued it, but WaitForJob() can also run a job inline
+		 * before any worker gets to it. That job is still in its queue, so it isn't released until the worker that
+		 * eventually pops it and the inline run are both done with it.
+		*/
+		enum class RunState {
+			Queued,			// Waiting in a queue
+			Started,		// Dequeued and run by a worker
+			Inline,			// Being run inline by WaitForJob()
+			InlineDone,		// Finished inline, still in a queue. The worker that pops it releases it.
+			InlinePopped,	// Popped while still running inline. The inline run releases it.
+		};
+
 		Job() :
 			m_pUserData(nullptr),
-			m_JobEntrypoint(nullptr) {
+			m_JobEntrypoint(nullptr),
+			m_pCounter(nullptr),
+			m_ePriority(JobPriority::Normal),
+			m_eStackClass(StackClass::Small),
+			m_eRunState(RunState::Queued),
+			m_iQueuedTime(0),
+			m_iNode(0),
+			m_bContinuation(false),
+			m_iRefCount(1),
+			m_pfnDestroyResult(nullptr) {
 		}
-		
-		Job(const Job&) = default;
-
-		/*Job& operator=(const Job&) {
-			return Job();
-		}*/
 
 		Job(JobEntryPoint entryPoint, void* pUserData = nullptr) :
-			m_JobEntrypoint(entryPoint),
-			m_pUserData(pUserData) {
+			m_pUserData(pUserData),
+			m_JobEntrypoint(std::move(entryPoint)),
+			m_pCounter(nullptr),
+			m_ePriority(JobPriority::Normal),
+			m_eStackClass(StackClass::Small),
+			m_eRunState(RunState::Queued),
+			m_iQueuedTime(0),
+			m_iNode(0),
+			m_bContinuation(false),
+			m_iRefCount(1),
+			m_pfnDestroyResult(nullptr) {
 
 		}
 
-		void SetEntryPoint(JobEntryPoint entryPoint) { m_JobEntrypoint = entryPoint; }
+		void SetEntryPoint(JobEntryPoint entryPoint) { m_JobEntrypoint = std::move(entryPoint); }
 		JobEntryPoint& GetEntryPoint() { return m_JobEntrypoint; }
 
 		void SetUserData(void* pUserData) { m_pUserData = pUserData; }
 		void* GetUserData() { return m_pUserData; }
 
+		// Optional counter shared with other jobs, decremented when this job completes
+		void SetCounter(JobCounter* pCounter) { m_pCounter = pCounter; }
+		JobCounter* GetCounter() { return m_pCounter; }
+
+		void SetPriority(JobPriority ePriority) { m_ePriority = ePriority; }
+		JobPriority GetPriority() { return m_ePriority; }
+
+		void SetStackClass(StackClass eStackClass) { m_eStackClass = eStackClass; }
+		StackClass GetStackClass() { return m_eStackClass; }
+
+		// Counter private to this job. 1 while queued or running, 0 once complete.
+		JobCounter& GetCompletion() { return m_Completion; }
+
+		std::atomic<RunState>& GetRunState() { return m_eRunState; }
+
+		// When the job was queued in steady_clock nanoseconds, if it was picked to sample the queue wait. 0 if not.
+		void SetQueuedTime(uint64_t iQueuedTime) { m_iQueuedTime = iQueuedTime; }
+		uint64_t GetQueuedTime() { return m_iQueuedTime; }
+
+		// NUMA node (Dispatcher's numbering) of the pool the job belongs to. Set once, when the pool creates it.
+		void SetNode(int iNode) { m_iNode = iNode; }
+		int GetNode() { return m_iNode; }
+
+		// Runs on the dequeuing thread's own stack rather than a pooled fiber, see Dispatcher::AddContinuation()
+		void SetContinuation(bool bContinuation) { m_bContinuation = bContinuation; }
+		bool IsContinuation() { return m_bContinuation; }
+
+		// 1 while only the run holds the job, plus one for a JobFuture. The job goes back to the pool when it drops to 0.
+		std::atomic<int>& GetRefCount() { return m_iRefCount; }
+
+		// Whether an R fits in the job itself
+		template<class R>
+		static constexpr bool IsInlineResult = sizeof(R) <= JobResultCapacity && alignof(R) <= alignof(max_align_t);
+
+		/**
+		 * @brief Construct the job's result, see Dispatcher::AddJob<R>(). It lives until the job is released.
+		*/
+		template<class R, class... Args>
+		void EmplaceResult(Args&&... args) {
+			assert(m_pfnDestroyResult == nullptr);
+			if constexpr (IsInlineResult<R>) {
+				new (m_ResultStorage) R(std::forward<Args>(args)...);
+				m_pfnDestroyResult = [](void* pStorage) { ((R*)pStorage)->~R(); };
+			}
+			else {
+				*(R**)m_ResultStorage = new R(std::forward<Args>(args)...);
+				m_pfnDestroyResult = [](void* pStorage) { delete *(R**)pStorage; };
+			}
+		}
+
+		template<class R>
+		R& GetResult() {
+			assert(m_pfnDestroyResult != nullptr);
+			if constexpr (IsInlineResult<R>)
+				return *std::launder((R*)m_ResultStorage);
+			else
+				return **(R**)m_ResultStorage;
+		}
+
+		void DestroyResult() {
+			if (m_pfnDestroyResult) {
+				m_pfnDestroyResult(m_ResultStorage);
+				m_pfnDestroyResult = nullptr;
+			}
+		}
+
 	private:
 
 		void* m_pUserData;		// User data to be passed into the entrypoint function
 		JobEntryPoint	m_JobEntrypoint;	// Entrypoint function to be called for the job
+		JobCounter* m_pCounter;		// Group counter from AddJobs(), may be nullptr
+		JobCounter m_Completion;	// What WaitForJob() waits on
+		JobPriority m_ePriority;	// Which queue the job goes onto
+		StackClass m_eStackClass;	// Which fiber pool the job runs on
+		std::atomic<RunState> m_eRunState;	// Claimed by whoever starts the job
+		uint64_t m_iQueuedTime;		// For the queue wait histogram in DispatcherStats
+		int m_iNode;				// Which pool to release the job to
+		bool m_bContinuation;		// Skip the fiber, see Dispatcher::AddContinuation()
+		std::atomic<int> m_iRefCount;	// Run plus JobFuture, see GetRefCount()
+		void (*m_pfnDestroyResult)(void* pStorage);	// Set once a result has been constructed
+		alignas(max_align_t) unsigned char m_ResultStorage[JobResultCapacity];	// Result of AddJob<R>(), or a pointer to it
 
 	};
 
 	typedef Job* JobHandle;
-}
\ No newline at end of file
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "SpinLock.h"
+
+#include <atomic>
+
+namespace Hustle {
+	class Fiber;
+
+	/**
+	 * @brief Atomic completion counter, as described in the Naughty Dog fiber talk.
+	 * Dispatcher::AddJobs() raises it by the number of jobs added and every job lowers it by one when it
+	 * finishes, so a single Dispatcher::WaitForCounter() covers a whole group of jobs.
+	 *
+	 * Fibers waiting on the counter are parked on its wait list and handed back to the scheduler by
+	 * Decrement() once the value reaches their target, so they are never polled. While nothing is parked,
+	 * Decrement() is a single compare-exchange and never takes the wait lock.
+	*/
+	class JobCounter {
+	public:
+
+		/**
+		 * @brief Something other than a fiber waiting on the counter, a suspended coroutine (see Task.h) for one.
+		 * Owned by the waiter, and must stay put until Decrement() calls pfnWake, which is its last touch of it.
+		*/
+		struct Waiter {
+			void (*pfnWake)(Waiter* pWaiter) = nullptr;
+			int iTarget = 0;
+			Waiter* pNext = nullptr;
+		};
+
+		JobCounter(int iValue = 0) :
+			m_iState(iValue * ValueStep),
+			m_pWaiters(nullptr),
+			m_pOtherWaiters(nullptr) {
+		}
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		/**
+		 * @brief Current value of the counter
+		*/
+		int GetValue() const { return ValueOf(m_iState.load(std::memory_order_acquire)); }
+
+		/**
+		 * @brief Overwrite the value. Only safe when no jobs reference the counter and nothing is waiting on it.
+		*/
+		void SetValue(int iValue) { m_iState.store(iValue * ValueStep, std::memory_order_release); }
+
+		/**
+		 * @brief Raise the counter, typically by the number of jobs about to be queued
+		 * @return The new value
+		*/
+		int Increment(int iCount = 1) { return ValueOf(m_iState.fetch_add(iCount * ValueStep, std::memory_order_acq_rel)) + iCount; }
+
+		/**
+		 * @brief Lower the counter, typically when a job completes. Any parked fibers whose target has been reached are made ready.
+		 * @return The new value
+		*/
+		int Decrement(int iCount = 1);
+
+		/**
+		 * @brief Check whether the counter is at (or below) iTarget. Once this returns true the caller may destroy the counter.
+		*/
+		bool HasReached(int iTarget);
+
+		/**
+		 * @brief Park a fiber until the counter drops to (or below) iTarget. Called by the scheduler once the fiber has switched out.
+		 * @param pFiber - The waiting fiber
+		 * @param iTarget - Value the fiber is waiting for
+		 * @return false if the target had already been reached and the fiber should be resumed right away
+		*/
+		bool AddWaiter(Fiber* pFiber, int iTarget);
+
+		/**
+		 * @brief Have Decrement() call pWaiter->pfnWake once the counter drops to (or below) pWaiter->iTarget
+		 * @return false if the target had already been reached, in which case pfnWake won't be called
+		*/
+		bool AddWaiter(Waiter* pWaiter);
+
+		/**
+		 * @brief Take a waiter added with AddWaiter() off the list, so it won't be woken
+		 * @return false if a Decrement() got to it first, in which case pfnWake has been or is about to be called
+		*/
+		bool RemoveWaiter(Waiter* pWaiter);
+
+	private:
+
+		// The value lives in the upper bits of m_iState, the lowest bit is set while anything is on a wait list
+		static const int WaitersFlag = 1;
+		static const int ValueStep = 2;
+
+		static int ValueOf(int iState) { return (iState & ~WaitersFlag) / ValueStep; }
+
+		/**
+		 * @brief Clear WaitersFlag once both lists are empty. Called with the wait lock held.
+		*/
+		void UpdateWaitersFlag();
+
+		// Value and WaitersFlag in one word, so a Decrement() can't slip in between AddWaiter() setting the flag and reading the value
+		std::atomic<int> m_iState;
+
+		// Intrusive list of parked fibers, linked through Fiber::m_pNextWaiter
+		SpinLock m_WaitLock;
+		Fiber* m_pWaiters;
+		Waiter* m_pOtherWaiters;
+	};
+}
@@ -0,0 +1,244 @@
+#pragma once
+/**********************************************************************
+* Typed results for jobs.
+*
+* Dispatcher::AddJob<R>() queues a callable returning R and hands back a
+* JobFuture<R>. The result is built in the pooled Job's own storage, so
+* small results don't allocate, and the job isn't recycled until both
+* the run and the future are done with it. Get() waits for the job,
+* parking the fiber when called from a job, and takes the result.
+*
+* WhenAll() and WhenAny() wait on several futures at once. The caller is
+* parked (or helps) once for the whole set instead of once per future.
+**********************************************************************/
+
+#include "Dispatcher.h"
+#include "Job.h"
+#include "JobCounter.h"
+
+#include <assert.h>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace Hustle {
+
+	/**
+	 * @brief Result of a job queued with Dispatcher::AddJob<R>(). Move-only. Get() takes the result once, after
+	 * which the future is empty. A future dropped without Get() lets go of the job, which runs regardless.
+	*/
+	template<class R>
+	class [[nodiscard]] JobFuture {
+	public:
+		JobFuture() :
+			m_pJob(nullptr) {
+		}
+
+		JobFuture(JobFuture&& other) noexcept :
+			m_pJob(std::exchange(other.m_pJob, nullptr)) {
+		}
+
+		JobFuture& operator=(JobFuture&& other) noexcept {
+			if (this != &other) {
+				Reset();
+				m_pJob = std::exchange(other.m_pJob, nullptr);
+			}
+			return *this;
+		}
+
+		JobFuture(const JobFuture&) = delete;
+		JobFuture& operator=(const JobFuture&) = delete;
+
+		~JobFuture() {
+			Reset();
+		}
+
+		/**
+		 * @brief Whether the future still refers to a job, i.e. it came from AddJob<R>() and Get() hasn't been called
+		*/
+		bool IsValid() const { return m_pJob != nullptr; }
+
+		/**
+		 * @brief Whether the job has finished, so Get() won't wait
+		*/
+		bool IsReady() const {
+			assert(m_pJob);
+			return m_pJob->GetCompletion().HasReached(0);
+		}
+
+		/**
+		 * @brief Wait for the job to finish. From a job, the fiber is parked meanwhile.
+		*/
+		void Wait() const {
+			assert(m_pJob);
+			Dispatcher::GetInstance().WaitForJob(m_pJob);
+		}
+
+		/**
+		 * @brief Wait() for the job, then take its result and let go of the job
+		*/
+		R Get() {
+			Wait();
+			if constexpr (std::is_void_v<R>) {
+				Reset();
+			}
+			else {
+				R result = std::move(m_pJob->GetResult<R>());
+				Reset();
+				return result;
+			}
+		}
+
+		/**
+		 * @brief The job, to use with WaitForJob() or co_await in a Task. Only good for as long as the future holds it.
+		*/
+		JobHandle GetHandle() const { return m_pJob; }
+
+	private:
+		explicit JobFuture(Job* pJob) :
+			m_pJob(pJob) {
+		}
+
+		void Reset() {
+			if (m_pJob) {
+				Dispatcher::GetInstance().ReleaseJob(m_pJob);
+				m_pJob = nullptr;
+			}
+		}
+
+		Job* m_pJob;
+
+		// Dispatcher::AddJob<R>() hands out the futures
+		friend class Dispatcher;
+	};
+
+	namespace Detail {
+
+		// Waiters for up to this many futures live on the caller's stack, which may be a small fiber stack
+		static const int InlineFutureWaiters = 16;
+
+		struct FutureWaiter : JobCounter::Waiter {
+			JobCounter* pPending;	// Futures still not done
+			Job* pJob;				// nullptr if the job was done before the waiter could be added
+		};
+
+		inline void WakeFutureWaiter(JobCounter::Waiter* pWaiter) {
+			static_cast<FutureWaiter*>(pWaiter)->pPending->Decrement();
+		}
+
+		/**
+		 * @brief Wait until iWanted of the jobs are done, parking the caller once for all of them. Every waiter lives
+		 * on this stack, so each one has been woken or taken back off its job's counter by the time this returns.
+		 * @param getJob - Called with 0 to iCount - 1 for the jobs
+		*/
+		template<class GetJob>
+		void WaitForJobs(int iCount, int iWanted, GetJob getJob) {
+
+			assert(iWanted > 0 && iWanted <= iCount);
+
+			// Enough done already, nothing to park for
+			int iDone = 0;
+			for (int i = 0; i < iCount && iDone < iWanted; i++) {
+				assert(getJob(i) != nullptr && "Waiting on an empty future");
+				if (getJob(i)->GetCompletion().HasReached(0))
+					iDone++;
+			}
+			if (iDone >= iWanted)
+				return;
+
+			FutureWaiter inlineWaiters[InlineFutureWaiters];
+			std::unique_ptr<FutureWaiter[]> pHeapWaiters;
+			FutureWaiter* pWaiters = inlineWaiters;
+			if (iCount > InlineFutureWaiters) {
+				pHeapWaiters.reset(new FutureWaiter[iCount]);
+				pWaiters = pHeapWaiters.get();
+			}
+
+			// Every future lowers this once, when its job finishes or its waiter is taken back
+			JobCounter pending(iCount);
+			for (int i = 0; i < iCount; i++) {
+
+				FutureWaiter& waiter = pWaiters[i];
+				waiter.pfnWake = WakeFutureWaiter;
+				waiter.pPending = &pending;
+				waiter.pJob = getJob(i);
+				if (waiter.pJob->GetCompletion().AddWaiter(&waiter) == false) {
+					waiter.pJob = nullptr;
+					pending.Decrement();
+				}
+			}
+
+			Dispatcher& dispatcher = Dispatcher::GetInstance();
+			dispatcher.WaitForCounter(&pending, iCount - iWanted);
+			if (iWanted == iCount)
+				return;
+
+			// Done waiting, take back the waiters that haven't been woken. One that has may still be in its wake
+			// call, so wait for every last one before the stack goes away.
+			for (int i = 0; i < iCount; i++) {
+				if (pWaiters[i].pJob && pWaiters[i].pJob->GetCompletion().RemoveWaiter(&pWaiters[i]))
+					pending.Decrement();
+			}
+			dispatcher.WaitForCounter(&pending);
+		}
+	}
+
+	/**
+	 * @brief Wait for every future's job to finish. Their Get()s won't wait after this.
+	*/
+	template<class R, class... Rest>
+	void WhenAll(JobFuture<R>& first, JobFuture<Rest>&... rest) {
+		Job* pJobs[] = { first.GetHandle(), rest.GetHandle()... };
+		int iCount = 1 + (int)sizeof...(Rest);
+		Detail::WaitForJobs(iCount, iCount, [&](int i) { return pJobs[i]; });
+	}
+
+	/**
+	 * @brief Wait for every future in a contiguous container (std::vector, std::array, a C array, ...)
+	*/
+	template<class Container, class = decltype(std::data(std::declval<Container&>()))>
+	void WhenAll(Container& futures) {
+		auto pFutures = std::data(futures);
+		int iCount = (int)std::size(futures);
+		if (iCount > 0)
+			Detail::WaitForJobs(iCount, iCount, [pFutures](int i) { return pFutures[i].GetHandle(); });
+	}
+
+	/**
+	 * @brief Wait for at least one of the futures' jobs to finish
+	 * @return Index of the first future, in argument order, that is ready
+	*/
+	template<class R, class... Rest>
+	int WhenAny(JobFuture<R>& first, JobFuture<Rest>&... rest) {
+		Job* pJobs[] = { first.GetHandle(), rest.GetHandle()... };
+		int iCount = 1 + (int)sizeof...(Rest);
+		Detail::WaitForJobs(iCount, 1, [&](int i) { return pJobs[i]; });
+
+		for (int i = 0; i < iCount; i++) {
+			if (pJobs[i]->GetCompletion().HasReached(0))
+				return i;
+		}
+		return -1;
+	}
+
+	/**
+	 * @brief Wait for at least one future in a contiguous container to be ready
+	 * @return Index of the first future that is ready, -1 for an empty container
+	*/
+	template<class Container, class = decltype(std::data(std::declval<Container&>()))>
+	int WhenAny(Container& futures) {
+		auto pFutures = std::data(futures);
+		int iCount = (int)std::size(futures);
+		if (iCount == 0)
+			return -1;
+
+		Detail::WaitForJobs(iCount, 1, [pFutures](int i) { return pFutures[i].GetHandle(); });
+
+		for (int i = 0; i < iCount; i++) {
+			if (pFutures[i].IsReady())
+				return i;
+		}
+		return -1;
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Job.h"
+#include "Platform.h"
+
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Hustle {
+
+	/**
+	 * @brief A set of jobs and the order they have to run in, declared once and run as many times as needed
+	 * with Dispatcher::RunGraph().
+	 *
+	 * Every node keeps an atomic count of the predecessors it is still waiting for. A node is only queued once
+	 * that count reaches zero, by whichever predecessor finished last, so nothing ever waits on a dependency.
+	 * Adding nodes or edges is the only thing that allocates; running the graph again does not.
+	*/
+	class JobGraph {
+	public:
+		typedef int NodeId;
+
+		JobGraph() :
+			m_bPrepared(false),
+			m_bAcyclic(true) {
+		}
+
+		JobGraph(const JobGraph&) = delete;
+		JobGraph& operator=(const JobGraph&) = delete;
+
+		/**
+		 * @brief Add a job to the graph
+		 * @param entryPoint - Function to invoke for the job
+		 * @param pUserData - A pointer to data that will be passed into the entry point function
+		 * @param ePriority - Queue the job goes onto once it's ready
+		 * @param eStackClass - Fiber pool to run the job on
+		 * @return Id to use with AddEdge()
+		*/
+		NodeId AddNode(JobEntryPoint entryPoint, void* pUserData, JobPriority ePriority = JobPriority::Normal,
+					   StackClass eStackClass = StackClass::Small) {
+
+			Node node;
+			node.entryPoint = std::move(entryPoint);
+			node.pUserData = pUserData;
+			node.ePriority = ePriority;
+			node.eStackClass = eStackClass;
+
+			m_Nodes.push_back(std::move(node));
+			m_bPrepared = false;
+
+			return (NodeId)m_Nodes.size() - 1;
+		}
+
+		/**
+		 * @brief Add a callable with no arguments, typically a lambda, to the graph. Same capture limit as Dispatcher::AddJob().
+		*/
+		template<class F, class = std::enable_if_t<std::is_invocable_v<F&>>>
+		NodeId AddNode(F&& fn, JobPriority ePriority = JobPriority::Normal, StackClass eStackClass = StackClass::Small) {
+			return AddNode([fn = std::forward<F>(fn)](void*) mutable { fn(); }, nullptr, ePriority, eStackClass);
+		}
+
+		/**
+		 * @brief Make one node wait for another. The graph must stay acyclic.
+		 * @param before - Has to finish first
+		 * @param after - Only starts once before (and every other predecessor) has finished
+		*/
+		void AddEdge(NodeId before, NodeId after) {
+			assert(before >= 0 && before < (NodeId)m_Nodes.size());
+			assert(after >= 0 && after < (NodeId)m_Nodes.size());
+			assert(before != after);
+
+			m_Edges.push_back({ before, after });
+			m_bPrepared = false;
+		}
+
+		/**
+		 * @brief Number of nodes, which is also how much Dispatcher::RunGraph() raises its counter by
+		*/
+		int GetNodeCount() const { return (int)m_Nodes.size(); }
+
+		/**
+		 * @brief Whether the graph can run to completion, i.e. has no cycles
+		*/
+		bool IsAcyclic();
+
+	private:
+
+		struct Node {
+			JobEntryPoint entryPoint;
+			void* pUserData = nullptr;
+			JobPriority ePriority = JobPriority::Normal;
+			StackClass eStackClass = StackClass::Small;
+			int iFirstSuccessor = 0;		// Index into m_Successors
+			int iSuccessorCount = 0;
+			int iPredecessorCount = 0;
+		};
+
+		// Predecessors a node is still waiting for in the current run. Padded, since every predecessor of a
+		// node decrements it, possibly all at once from different workers.
+		struct alignas(Platform::CacheLineSize) PendingCount {
+			std::atomic<int> iValue = { 0 };
+		};
+
+		/**
+		 * @brief Flatten the edge list into per-node successor ranges, find the roots and check for cycles. Only
+		 * does any work (and allocates) after nodes or edges have been added.
+		*/
+		void Prepare();
+
+		/**
+		 * @brief Reset every node's pending count for a new run
+		*/
+		void Reset();
+
+		/**
+		 * @brief A predecessor of the node has finished
+		 * @return true if it was the last one, and the node is ready to run
+		*/
+		bool Release(NodeId node) {
+			return m_pPending[node].iValue.fetch_sub(1, std::memory_order_acq_rel) == 1;
+		}
+
+		std::vector<Node> m_Nodes;
+		std::vector<std::pair<NodeId, NodeId>> m_Edges;
+
+		std::vector<NodeId> m_Successors;		// Every node's successors, back to back
+		std::vector<NodeId> m_Roots;			// Nodes with no predecessors, queued to start a run
+		std::unique_ptr<PendingCount[]> m_pPending;
+		bool m_bPrepared;
+		bool m_bAcyclic;
+
+		// Allow the Dispatcher to run the graph
+		friend class Dispatcher;
+	};
+}
@@ -1,6 +1,6 @@
 #pragma once
-#include <queue>
 
+#include "RingBuffer.h"
 #include "SpinLock.h"
 
 namespace Hustle {
@@ -10,35 +10,53 @@ namespace Hustle {
 
 		void Push(T val) {
 			Lock();
-			m_Queue.push(val);
-			
+			m_Queue.Push(val);
+
 			Unlock();
 		}
 
 		T Pop() {
 			T val;
 			Lock();
-			if (m_Queue.size() == 0) {
-				val = nullptr;
-			}
-			else {
-				val = m_Queue.front();
-				m_Queue.pop();
-			}
+			val = m_Queue.Pop();
 			Unlock();
 			return val;
 		}
 
+		/**
+		 * @brief Push several items under a single lock
+		*/
+		void PushBulk(T* pItems, size_t iCount) {
+			Lock();
+			for (size_t i = 0; i < iCount; i++)
+				m_Queue.Push(pItems[i]);
+			Unlock();
+		}
+
+		/**
+		 * @brief Pop up to iMaxCount items, oldest first, under a single lock
+		 * @return The number of items written to pItems
+		*/
+		size_t PopBulk(T* pItems, size_t iMaxCount) {
+			size_t iCount = 0;
+			Lock();
+			while (iCount < iMaxCount && m_Queue.Empty() == false)
+				pItems[iCount++] = m_Queue.Pop();
+			Unlock();
+			return iCount;
+		}
+
 		size_t Size() {
 			size_t size;
 			Lock();
-			size = m_Queue.size();
+			size = m_Queue.Size();
 			Unlock();
 			return size;
 		}
 
 	private:
-		std::queue<T>	m_Queue;
+		// A ring buffer rather than std::queue, so steady state Push()/Pop() doesn't allocate
+		RingBuffer<T>	m_Queue;
 	};
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,146 @@
+#pragma once
+/**********************************************************************
+* Data parallel loops on top of the Dispatcher.
+*
+* The range is split in half recursively. The upper half of every split
+* is queued as a job and the lower half is worked on right away, so the
+* biggest pieces of work sit at the steal end of each worker's deque and
+* an idle worker takes half of whatever is left in one go. The caller
+* runs the first chunk itself and then waits (parking its fiber when
+* called from a job) until every chunk is done.
+**********************************************************************/
+
+#include "Dispatcher.h"
+#include "JobCounter.h"
+#include "Platform.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace Hustle {
+
+	namespace Detail {
+
+		// Chunk size used when the caller passes a grain of 0: roughly 8 chunks per thread
+		template<class Index>
+		Index AutoGrain(Index count) {
+			Index chunks = (Index)(8 * (Dispatcher::GetInstance().WorkerThreadCount() + 1));
+			return (std::max)((Index)1, (Index)(count / chunks));
+		}
+
+		// One chunk's partial result for ParallelReduce(). Padded, since neighbouring chunks are written at
+		// the same time from different workers.
+		template<class T>
+		struct alignas(Platform::CacheLineSize) PartialResult {
+			T value;
+		};
+
+		template<class Index, class Leaf>
+		struct ParallelRange {
+			Index grain;
+			Leaf* pLeaf;			// Called with each chunk, [begin, end)
+			JobCounter counter;		// Queued chunks that haven't finished
+		};
+
+		/**
+		 * @brief Queue the upper half of the range until what's left fits in a grain, then run that
+		*/
+		template<class Index, class Leaf>
+		void SplitRange(ParallelRange<Index, Leaf>* pRange, Index begin, Index end) {
+
+			while (end - begin > pRange->grain) {
+				Index mid = begin + (end - begin) / 2;
+
+				// Raised before the job exists, so the counter can't hit zero while there's work left to queue
+				pRange->counter.Increment();
+				Dispatcher::GetInstance().AddJob([pRange, mid, end]() { SplitRange(pRange, mid, end); },
+												 JobPriority::Normal, &pRange->counter);
+				end = mid;
+			}
+
+			(*pRange->pLeaf)(begin, end);
+		}
+
+		template<class Index, class Leaf>
+		void RunRange(Index begin, Index end, Index grain, Leaf& leaf) {
+
+			ParallelRange<Index, Leaf> range;
+			range.grain = grain;
+			range.pLeaf = &leaf;
+
+			SplitRange(&range, begin, end);
+			Dispatcher::GetInstance().WaitForCounter(&range.counter);
+		}
+	}
+
+	/**
+	 * @brief Call fn(i) for every i in [begin, end), in parallel. Returns once every call has returned.
+	 * @param begin - First index
+	 * @param end - One past the last index
+	 * @param grain - Most indices handled by one job. 0 picks a size from the worker count.
+	 * @param fn - Called once per index, from any worker (or the calling thread)
+	*/
+	template<class Index, class F>
+	void ParallelFor(Index begin, Index end, Index grain, F&& fn) {
+
+		static_assert(std::is_integral<Index>::value, "ParallelFor needs an integer index");
+
+		if (end <= begin)
+			return;
+
+		if (grain <= 0)
+			grain = Detail::AutoGrain<Index>(end - begin);
+
+		auto leaf = [&fn](Index chunkBegin, Index chunkEnd) {
+			for (Index i = chunkBegin; i < chunkEnd; i++)
+				fn(i);
+		};
+
+		Detail::RunRange(begin, end, grain, leaf);
+	}
+
+	/**
+	 * @brief Reduce map(i) over [begin, end) in parallel. Every chunk folds its indices into its own partial
+	 * result, then the partials are combined in index order, so combine only needs to be associative.
+	 * @param begin - First index
+	 * @param end - One past the last index
+	 * @param grain - Most indices handled by one job. 0 picks a size from the worker count.
+	 * @param identity - Value that combine leaves unchanged, and the result for an empty range
+	 * @param map - T map(Index i)
+	 * @param combine - T combine(const T& left, const T& right)
+	 * @return The combined result
+	*/
+	template<class Index, class T, class Map, class Combine>
+	T ParallelReduce(Index begin, Index end, Index grain, T identity, Map&& map, Combine&& combine) {
+
+		static_assert(std::is_integral<Index>::value, "ParallelReduce needs an integer index");
+
+		if (end <= begin)
+			return identity;
+
+		if (grain <= 0)
+			grain = Detail::AutoGrain<Index>(end - begin);
+
+		// Halving never leaves a chunk shorter than half a grain (rounded up), so dividing a chunk's start
+		// by that gives every chunk its own slot, and the slots are in index order.
+		Index slotSize = (grain + 1) / 2;
+		std::vector<Detail::PartialResult<T>> partials((size_t)((end - begin) / slotSize + 1), Detail::PartialResult<T>{ identity });
+
+		auto leaf = [&](Index chunkBegin, Index chunkEnd) {
+			T value = identity;
+			for (Index i = chunkBegin; i < chunkEnd; i++)
+				value = combine(value, map(i));
+
+			partials[(size_t)((chunkBegin - begin) / slotSize)].value = value;
+		};
+
+		Detail::RunRange(begin, end, grain, leaf);
+
+		T result = identity;
+		for (auto& partial : partials)
+			result = combine(result, partial.value);
+
+		return result;
+	}
+}
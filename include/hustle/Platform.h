@@ -0,0 +1,142 @@
+#pragma once
+/**********************************************************************
+* Thin platform layer so the rest of Hustle can stay OS agnostic.
+* Windows uses the Win32 API, everything else is treated as POSIX.
+**********************************************************************/
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+	#define HUSTLE_PLATFORM_WINDOWS 1
+	#include <Windows.h>
+
+	#if defined(_MSC_VER)
+		// WaitOnAddress() and friends
+		#pragma comment(lib, "Synchronization.lib")
+	#endif
+
+	// Calling convention required for fiber entry points
+	#define HUSTLE_FIBER_CALL __stdcall
+#else
+	#define HUSTLE_PLATFORM_POSIX 1
+	#include <sched.h>
+
+	#if defined(__linux__)
+		#include <linux/futex.h>
+		#include <sys/syscall.h>
+		#include <unistd.h>
+	#else
+		#include <time.h>
+	#endif
+
+	#if defined(__x86_64__) || defined(__i386__)
+		#include <immintrin.h>
+		#include <x86intrin.h>
+	#else
+		#include <chrono>
+	#endif
+
+	#define HUSTLE_FIBER_CALL
+#endif
+
+namespace Hustle {
+	namespace Platform {
+
+		// Assumed size of a cache line, used to pad data written by different threads onto separate lines
+		static const size_t CacheLineSize = 64;
+
+		/**
+		 * @brief Issue a CPU relax hint (x86 PAUSE / ARM YIELD) inside of a spin loop.
+		*/
+		inline void CpuPause() noexcept {
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+			YieldProcessor();	// Under the hood will call _mm_pause()
+#elif defined(__x86_64__) || defined(__i386__)
+			_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+			asm volatile("yield");
+#endif
+		}
+
+		/**
+		 * @brief A cheap, monotonic tick count for timestamps: the TSC on x86, the performance counter on Windows.
+		 * The tick rate isn't known up front, so measure it against std::chrono to convert.
+		*/
+		inline uint64_t ReadTicks() noexcept {
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return (uint64_t)counter.QuadPart;
+#elif defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+		}
+
+		/**
+		 * @brief The logical CPU the calling thread is running on. Only a hint, the thread can be moved at any time.
+		 * @return The CPU number, or -1 if the OS can't say
+		*/
+		inline int GetCurrentCpu() noexcept {
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+			return (int)GetCurrentProcessorNumber();
+#elif defined(__linux__)
+			return sched_getcpu();
+#else
+			return -1;
+#endif
+		}
+
+		/**
+		 * @brief Give the remainder of this thread's time slice back to the OS.
+		*/
+		inline void ThreadYield() noexcept {
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+			SwitchToThread();
+#else
+			sched_yield();
+#endif
+		}
+
+		/**
+		 * @brief Block the calling thread while *pAddress still holds uExpected, until another thread calls
+		 * WakeAddress() on it. May return spuriously, so callers re-check their condition.
+		*/
+		inline void WaitOnAddress(std::atomic<uint32_t>* pAddress, uint32_t uExpected) noexcept {
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+			::WaitOnAddress(pAddress, &uExpected, sizeof(uExpected), INFINITE);
+#elif defined(__linux__)
+			syscall(SYS_futex, (uint32_t*)pAddress, FUTEX_WAIT_PRIVATE, uExpected, nullptr, nullptr, 0);
+#else
+			// No futex here, nap briefly instead. Wake ups are late by up to the nap, but still happen.
+			if (pAddress->load(std::memory_order_acquire) == uExpected) {
+				timespec nap = { 0, 200 * 1000 };
+				nanosleep(&nap, nullptr);
+			}
+#endif
+		}
+
+		/**
+		 * @brief Wake up to iCount threads blocked in WaitOnAddress() on pAddress. The caller changes the value first.
+		*/
+		inline void WakeAddress(std::atomic<uint32_t>* pAddress, int iCount) noexcept {
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+			if (iCount == INT32_MAX) {
+				::WakeByAddressAll(pAddress);
+			}
+			else {
+				for (int i = 0; i < iCount; i++)
+					::WakeByAddressSingle(pAddress);
+			}
+#elif defined(__linux__)
+			syscall(SYS_futex, (uint32_t*)pAddress, FUTEX_WAKE_PRIVATE, iCount, nullptr, nullptr, 0);
+#else
+			(void)pAddress;
+			(void)iCount;
+#endif
+		}
+	}
+}
@@ -1,14 +1,32 @@
 #pragma once
 
+#include "InlineFunction.h"
 #include "LockedQueue.h"
+#include "Platform.h"
+#include "ThreadSlot.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <new>
 #include <queue>
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
 
 namespace Hustle {
 
-	template<class T>
+	/**
+	 * @brief Pool of pre-allocated resources. Each Grow() allocates one contiguous slab, and every resource in it
+	 * starts on its own cache line and is padded out to a whole number of lines, so resources handed to different
+	 * threads never share a line.
+	 *
+	 * Each thread keeps a small magazine of free resources in front of the shared free list, so most Get()/Release()
+	 * calls are thread local. Only once the shared list is empty does Get() go through the other threads' magazines.
+	 * @tparam T - Resource type
+	 * @tparam FreeList - Queue of available resources. LockedQueue<T*> or BoundedMPMCQueue<T*>
+	*/
+	template<class T, class FreeList = LockedQueue<T*>>
 	class ResourcePool {
 	public:
 
@@ -16,20 +34,30 @@ namespace Hustle {
 		 * @brief Default constructor for the ResourcePool. 
 		*/
 		ResourcePool() :
-			m_fGrowthFactor(0.0f),
-			m_iInUseCounter(0),
 			m_pPool(nullptr),
-			m_iResourcCount(0) {
-			
+			m_iResourcCount(0),
+			m_fGrowthFactor(0.0f),
+			m_iMaxCount(0),
+			m_iHighWaterMark(0) {
+
+			// The first chunk covers most programs, so their threads never allocate a magazine mid-run
+			m_MagazineChunks[0].store(new Magazine[MagazineChunkSize], std::memory_order_relaxed);
 		}
 		
 		~ResourcePool() {
 
 			// Delete all of the resources
 			for (auto pResource : m_Pool)
-				delete pResource;
+				pResource->~T();
+
+			for (auto& pChunk : m_MagazineChunks)
+				delete[] pChunk.load(std::memory_order_relaxed);
+
+			for (auto pSlab : m_Slabs)
+				::operator delete(pSlab, std::align_val_t(alignof(Slot)));
 			
 			// Empty out the pool
+			m_Slabs.clear();
 			m_Pool.clear();
 
 		}
@@ -41,14 +69,27 @@ namespace Hustle {
 		T* Get() {
 			
 			T* pResource = nullptr;
-			pResource = m_FreeResources.Pop();
 
-			if (pResource) {
-				m_iInUseCounter++;
+			// Common case: straight off of this thread's magazine, without a lock
+			Magazine* pMagazine = GetMagazine();
+			if (pMagazine) {
+				pResource = pMagazine->Pop();
+				if (pResource == nullptr) {
+					Refill(pMagazine);
+					UpdateHighWaterMark();
+					pResource = pMagazine->Pop();
+				}
+			}
+			else {
+				pResource = m_FreeResources.Pop();
+				UpdateHighWaterMark();
+			}
 
-				// Only called in DEBUG mode
-				HighWaterCheck();
-			} else {
+			// The shared list is empty too, but other threads' magazines may not be
+			if (pResource == nullptr)
+				pResource = Scavenge();
+
+			if (pResource == nullptr) {
 
 				// Are we allowing dynamic pool resizing?
 				if (m_fGrowthFactor > 0.0f) {		
@@ -56,46 +97,116 @@ namespace Hustle {
 					// Take the resize lock
 					m_ResizeLock.Lock();
 
-					// What if...the resize alredy occured somewhere else?
+					// What if...the resize alredy occured somewhere else? Or other threads are holding on to free resources?
 					pResource = m_FreeResources.Pop();
+					if (pResource == nullptr)
+						pResource = Scavenge();
 
 					// Got one - great!
 					if (pResource) {
-						m_iInUseCounter++;
-
-						// Only called in DEBUG mode
-						HighWaterCheck();
-
 						m_ResizeLock.Unlock(); 
 						return pResource;
 					}
 
-					// Still nothing available - let's grow the pool
-					int iGrowSize = (int)(m_iResourcCount * m_fGrowthFactor);
-					assert(iGrowSize != 0);
+					// Still nothing available - let's grow the pool, but no further than the cap
+					int iTotal = m_iResourcCount.load(std::memory_order_relaxed);
+					int iGrowSize = (std::max)(1, (int)(iTotal * m_fGrowthFactor));
+					if (m_iMaxCount > 0)
+						iGrowSize = (std::min)(iGrowSize, m_iMaxCount - iTotal);
+
+					if (iGrowSize <= 0) {
+						m_ResizeLock.Unlock();
+						return nullptr;
+					}
 					Grow(iGrowSize);
 					
 					// Alright...get one for real this time
 					pResource = m_FreeResources.Pop();
 					assert(pResource != nullptr);
+					UpdateHighWaterMark();
 
 					m_ResizeLock.Unlock();
-
-					// Bump our counters					
-					m_iInUseCounter++;
-
-					// Only called in DEBUG mode
-					HighWaterCheck();					
 				}
 			}			
 
 			return pResource;
 		} // end of ResourcePool::Get()
 
+		/**
+		 * @brief Get(), but when nothing is free the pool grows by one even past SetMaxCount(). For callers that
+		 * can't wait for a resource to come back.
+		 * @return A pointer to the resource (T), never nullptr
+		*/
+		T* GetPastMax() {
+
+			T* pResource = Get();
+			if (pResource)
+				return pResource;
+
+			m_ResizeLock.Lock();
+
+			// Another thread may take the one we add before we get to it, so keep going until we have one
+			pResource = m_FreeResources.Pop();
+			while (pResource == nullptr) {
+				Grow(1);
+				pResource = m_FreeResources.Pop();
+			}
+			UpdateHighWaterMark();
+
+			m_ResizeLock.Unlock();
+
+			return pResource;
+		}
+
+		/**
+		 * @brief Obtain several resources at once. Empties this thread's magazine first and takes the rest off the
+		 * shared free list with one PopBulk(), only falling back to Get() (scavenging or growing) for what's left.
+		 * @param ppResources - Receives the resources
+		 * @param iCount - Number of resources wanted
+		 * @return The number written to ppResources. Less than iCount only if the pool ran out and can't grow.
+		*/
+		int GetBulk(T** ppResources, int iCount) {
+
+			int iTaken = 0;
+
+			Magazine* pMagazine = GetMagazine();
+			while (pMagazine && iTaken < iCount) {
+				T* pResource = pMagazine->Pop();
+				if (pResource == nullptr)
+					break;
+
+				ppResources[iTaken++] = pResource;
+			}
+
+			if (iTaken < iCount) {
+				iTaken += (int)m_FreeResources.PopBulk(ppResources + iTaken, iCount - iTaken);
+				UpdateHighWaterMark();
+			}
+
+			while (iTaken < iCount) {
+				T* pResource = Get();
+				if (pResource == nullptr)
+					break;
+
+				ppResources[iTaken++] = pResource;
+			}
+
+			return iTaken;
+		}
+
 		void Release(T* pResource) {
 
-			m_iInUseCounter--;
-			m_FreeResources.Push(pResource);
+			Magazine* pMagazine = GetMagazine();
+			if (pMagazine == nullptr) {
+				m_FreeResources.Push(pResource);
+				return;
+			}
+
+			// A full magazine hands a batch back, so resources released on one thread can be used by the others
+			if (pMagazine->Size() >= MagazineCapacity)
+				Flush(pMagazine);
+
+			pMagazine->Push(pResource);
 		}
 
 		/**
@@ -105,21 +216,56 @@ namespace Hustle {
 		*/
 		int Grow(int iCount) {
 
-			// TODO: Can this be optimized?
+			if (iCount <= 0)
+				return m_iResourcCount.load(std::memory_order_relaxed);
+
+			// One allocation for the whole step, rather than one per resource scattered around the heap
+			Slot* pSlab = (Slot*)::operator new(sizeof(Slot) * iCount, std::align_val_t(alignof(Slot)));
+			m_Slabs.push_back(pSlab);
+
 			for (int i = 0; i < iCount; i++) {
-				T* pResource = new T();
+				T* pResource = nullptr;
+				if (m_Constructor)
+					pResource = m_Constructor(pSlab[i].storage);
+				else if constexpr (std::is_default_constructible_v<T>)
+					pResource = new (pSlab[i].storage) T();
+
+				// Resources without a default constructor need SetConstructor()
+				assert(pResource != nullptr);
+
 				m_Pool.push_back(pResource);
+				m_iResourcCount.fetch_add(1, std::memory_order_relaxed);
 				m_FreeResources.Push(pResource);
-				m_iResourcCount++;
 			}
 
-			return m_iResourcCount;
+			return m_iResourcCount.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Placement constructs a resource in the storage it's given, and returns it. For resources that need
+		 * constructor arguments. Must be set before the first Grow().
+		*/
+		typedef InlineFunction<T*(void* pStorage), 32> Constructor;
+
+		void SetConstructor(Constructor constructor) {
+			m_Constructor = std::move(constructor);
 		}
 
-		int GetTotalCount() { return m_iResourcCount; }
+		int GetTotalCount() { return m_iResourcCount.load(std::memory_order_relaxed); }
 
+		/**
+		 * @brief Number of free resources, on the shared free list and in every thread's magazine. Magazines are read
+		 * without synchronizing with their owners, so while other threads are using the pool this is approximate.
+		*/
 		size_t GetFreeCount() {
-			return m_FreeResources.Size();
+			size_t iCount = m_FreeResources.Size();
+			for (auto& pChunk : m_MagazineChunks) {
+				Magazine* pMagazines = pChunk.load(std::memory_order_acquire);
+				for (int i = 0; pMagazines && i < MagazineChunkSize; i++)
+					iCount += pMagazines[i].Size();
+			}
+
+			return iCount;
 		}
 
 		float GetGrowthFactor() {
@@ -130,6 +276,19 @@ namespace Hustle {
 			m_fGrowthFactor = fFactor;
 		}
 
+		/**
+		 * @brief Most resources Get() may grow the pool to. Once it's there, Get() returns nullptr when nothing is free.
+		 * Grow() itself isn't limited.
+		 * @param iMaxCount - 0 for no limit
+		*/
+		void SetMaxCount(int iMaxCount) {
+			m_iMaxCount = iMaxCount;
+		}
+
+		int GetMaxCount() {
+			return m_iMaxCount;
+		}
+
 		/**
 		 * @brief Array operator to allow for direct access to the entire pool (use at your own risk)
 		 * @param i Index of the pool item to access
@@ -139,55 +298,211 @@ namespace Hustle {
 			return m_Pool[i];
 		}
 
-#ifdef _DEBUG 
+		/**
+		 * @brief Fetch the highest number of resources that have been out of the shared free list at once. It's only
+		 * checked as resources leave the shared list, not on every Get(), so it's cheap enough to always be on. Free
+		 * resources cached in a thread's magazine count as in use, so it can overstate the peak by a magazine per thread.
+		 * @return Highest number of items requested by the application
+		*/
+		int GetHighWaterMark() { return m_iHighWaterMark.load(std::memory_order_relaxed); }
+
+		// Most resources a thread's magazine holds before handing some back to the shared free list
+		static const int MagazineCapacity = 32;
+
+		// Number of resources moved between a magazine and the shared free list at once
+		static const int MagazineBatch = MagazineCapacity / 2;
+
+		// Magazines are allocated this many at a time. The first chunk up front, the rest the first time a thread in their range uses the pool
+		static const int MagazineChunkSize = 64;
+
+	private:
+
+		/**
+		 * @brief Small stack of free resources owned by one thread (see ThreadSlot), so most Get() and Release()
+		 * calls never touch the shared free list. Refilled from and flushed to it MagazineBatch resources at a time.
+		 * It's a fixed size Chase-Lev deque (see WorkStealingQueue): the owner pushes and pops the bottom without a
+		 * lock, and Flush() and Scavenge() take the oldest resources off the top with a CAS.
+		*/
+		struct alignas(Platform::CacheLineSize) Magazine {
+			static_assert((MagazineCapacity & (MagazineCapacity - 1)) == 0, "MagazineCapacity must be a power of two");
+
+			std::atomic<T*> pItems[MagazineCapacity] = {};
+			std::atomic<int64_t> iTop = { 0 };
+			std::atomic<int64_t> iBottom = { 0 };
+
+			T* Get(int64_t i) { return pItems[i & (MagazineCapacity - 1)].load(std::memory_order_relaxed); }
+			void Put(int64_t i, T* pResource) { pItems[i & (MagazineCapacity - 1)].store(pResource, std::memory_order_relaxed); }
+
+			/**
+			 * @brief Number of resources held. Exact on the owner with nobody stealing, approximate elsewhere.
+			*/
+			int Size() {
+				int64_t iCount = iBottom.load(std::memory_order_relaxed) - iTop.load(std::memory_order_relaxed);
+				return iCount > 0 ? (int)iCount : 0;
+			}
+
+			/**
+			 * @brief Owner only, and only when there's room
+			*/
+			void Push(T* pResource) {
+				int64_t iIndex = iBottom.load(std::memory_order_relaxed);
+				assert(iIndex - iTop.load(std::memory_order_relaxed) < MagazineCapacity);
+				Put(iIndex, pResource);
+				iBottom.store(iIndex + 1, std::memory_order_release);
+			}
+
+			/**
+			 * @brief Owner only. Pushes several resources with a single store, the last one is popped first.
+			*/
+			void PushBulk(T** ppResources, int iCount) {
+				int64_t iIndex = iBottom.load(std::memory_order_relaxed);
+				for (int i = 0; i < iCount; i++)
+					Put(iIndex + i, ppResources[i]);
+				iBottom.store(iIndex + iCount, std::memory_order_release);
+			}
+
+			/**
+			 * @brief Owner only. The most recently released resource, or nullptr if empty.
+			*/
+			T* Pop() {
+				int64_t iIndex = iBottom.load(std::memory_order_relaxed) - 1;
+				iBottom.store(iIndex, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t iFirst = iTop.load(std::memory_order_relaxed);
+
+				T* pResource = nullptr;
+				if (iFirst <= iIndex) {
+					pResource = Get(iIndex);
+
+					// Last one, race any Scavenge() for it
+					if (iFirst == iIndex) {
+						if (!iTop.compare_exchange_strong(iFirst, iFirst + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+							pResource = nullptr;
+						iBottom.store(iIndex + 1, std::memory_order_relaxed);
+					}
+				}
+				else {
+					iBottom.store(iIndex + 1, std::memory_order_relaxed);
+				}
+
+				return pResource;
+			}
+
+			/**
+			 * @brief Any thread. The least recently released resource, or nullptr if empty or another thread won it.
+			*/
+			T* Steal() {
+				int64_t iFirst = iTop.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t iEnd = iBottom.load(std::memory_order_acquire);
+
+				if (iFirst < iEnd) {
+					T* pResource = Get(iFirst);
+					if (iTop.compare_exchange_strong(iFirst, iFirst + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						return pResource;
+				}
+
+				return nullptr;
+			}
+		};
+
+		/**
+		 * @brief The calling thread's magazine, or nullptr if it couldn't get a ThreadSlot. Allocates the magazines
+		 * for the slot's chunk the first time one of them is needed.
+		*/
+		Magazine* GetMagazine() {
+			int iSlot = ThreadSlot::Get();
+			if (iSlot < 0)
+				return nullptr;
+
+			std::atomic<Magazine*>& chunk = m_MagazineChunks[iSlot / MagazineChunkSize];
+			Magazine* pMagazines = chunk.load(std::memory_order_acquire);
+			if (pMagazines == nullptr) {
+				Magazine* pNew = new Magazine[MagazineChunkSize];
+				if (chunk.compare_exchange_strong(pMagazines, pNew, std::memory_order_acq_rel))
+					pMagazines = pNew;
+				else
+					delete[] pNew;
+			}
+
+			return &pMagazines[iSlot % MagazineChunkSize];
+		}
+
+		/**
+		 * @brief Move a batch from the shared free list into an empty magazine. The oldest ends up on top, so
+		 * a single thread still gets resources back in the order they were freed.
+		*/
+		void Refill(Magazine* pMagazine) {
+
+			T* pResources[MagazineBatch];
+			int iCount = (int)m_FreeResources.PopBulk(pResources, MagazineBatch);
+			std::reverse(pResources, pResources + iCount);
+			pMagazine->PushBulk(pResources, iCount);
+		}
 
 		/**
-		 * @brief Fetch the highest number of outstanding items requested from the pool. Only available in debug builds.
-		 * @return Highest number of items resuqested by the application
+		 * @brief Take a free resource out of any thread's magazine. Used before growing the pool, so resources
+		 * parked in other threads' magazines don't make the pool grow (or, with no growth, run out) early.
+		 * @return The resource, or nullptr if every magazine is empty
 		*/
-		int GetHighWaterMark() {
-			int iHighWaterMark = 0;
-			m_StatsLock.Lock();
-			iHighWaterMark = m_iHighWaterMark;
-			m_StatsLock.Unlock();
-			return iHighWaterMark;
-		}
-#else 
+		T* Scavenge() {
+
+			for (auto& pChunk : m_MagazineChunks) {
+				Magazine* pMagazines = pChunk.load(std::memory_order_acquire);
+				for (int i = 0; pMagazines && i < MagazineChunkSize; i++) {
+
+					// Steal() only fails empty handed if it lost a race, so keep trying while there's something there
+					while (pMagazines[i].Size() > 0) {
+						T* pResource = pMagazines[i].Steal();
+						if (pResource)
+							return pResource;
+					}
+				}
+			}
+
+			return nullptr;
+		}
+
 		/**
-		 * @brief Not availbale in release mode.
-		 * @return N/A
+		 * @brief Hand the least recently released (so coldest) half of a full magazine back to the shared free list
 		*/
-		int GetHighWaterMark() { return 0; }
-#endif
+		void Flush(Magazine* pMagazine) {
+
+			T* pResources[MagazineBatch];
+			int iCount = 0;
+			while (iCount < MagazineBatch && pMagazine->Size() > 0) {
+				T* pResource = pMagazine->Steal();
+				if (pResource)
+					pResources[iCount++] = pResource;
+			}
 
-	private:
+			m_FreeResources.PushBulk(pResources, iCount);
+		}
+
+		// Storage for one resource, padded out to whole cache lines
+		struct alignas(Platform::CacheLineSize) Slot {
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
 
 		T* m_pPool;
-		int m_iResourcCount;
+		std::atomic<int> m_iResourcCount;	// Written by Grow() under the resize lock, read without it
 		float m_fGrowthFactor;
+		int m_iMaxCount;
 
 		std::vector<T*> m_Pool;				// Vector of every allocated resource
-		LockedQueue<T*> m_FreeResources;	// Holds all available resources
+		std::vector<Slot*> m_Slabs;			// One contiguous block per Grow() call
+		Constructor m_Constructor;			// Builds each resource, default constructs if empty
+		FreeList m_FreeResources;			// Holds available resources that aren't in a magazine
+		std::atomic<Magazine*> m_MagazineChunks[ThreadSlot::MaxSlots / MagazineChunkSize] = {};	// Per-thread caches in front of m_FreeResources
 		SpinLock m_ResizeLock;				// Taken when a pool resize is underway
 
-		// Performance metrics
-		SpinLock m_StatsLock;
-		int m_iHighWaterMark = { 0 };
-		std::atomic<int> m_iInUseCounter;		
-
-		// Performance methods that are only available/called if running in DEBUG mode
-#ifdef _DEBUG
-		void HighWaterCheck() {
-			// Only increment the lock if there was an available resource
-
-			// TODO: Is there a way to do this without locking?
-			m_StatsLock.Lock();
-			if (m_iInUseCounter > m_iHighWaterMark)
-				m_iHighWaterMark = m_iInUseCounter;
-			m_StatsLock.Unlock();			
-		}
-#else
-		void HighWaterCheck(void *pItem) {}
-#endif
+		// Performance metrics. Only written when resources leave the shared free list, and then only when it's a new high.
+		std::atomic<int> m_iHighWaterMark;
+
+		void UpdateHighWaterMark() {
+			int iInUse = m_iResourcCount.load(std::memory_order_relaxed) - (int)m_FreeResources.Size();
+			int iMark = m_iHighWaterMark.load(std::memory_order_relaxed);
+			while (iInUse > iMark && m_iHighWaterMark.compare_exchange_weak(iMark, iInUse, std::memory_order_relaxed) == false) {}
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+
+namespace Hustle {
+
+	/**
+	 * @brief Unsynchronized FIFO on a circular array. Grows by doubling when full and never shrinks, so once it
+	 * has reached its high water mark Push() and Pop() never touch the heap. T must be a pointer type.
+	*/
+	template<class T>
+	class RingBuffer {
+	public:
+
+		/**
+		 * @brief Create the buffer.
+		 * @param capacity - Initial number of slots, rounded up to a power of two
+		*/
+		RingBuffer(size_t capacity = 64) :
+			m_iHead(0),
+			m_iCount(0) {
+
+			size_t size = 1;
+			while (size < capacity)
+				size <<= 1;
+
+			m_iMask = size - 1;
+			m_pItems = new T[size];
+		}
+
+		~RingBuffer() {
+			delete[] m_pItems;
+		}
+
+		RingBuffer(const RingBuffer&) = delete;
+		RingBuffer& operator=(const RingBuffer&) = delete;
+
+		void Push(T val) {
+			if (m_iCount == m_iMask + 1)
+				Grow();
+
+			m_pItems[(m_iHead + m_iCount) & m_iMask] = val;
+			m_iCount++;
+		}
+
+		/**
+		 * @brief Remove the oldest item
+		 * @return The item, or nullptr if the buffer is empty
+		*/
+		T Pop() {
+			if (m_iCount == 0)
+				return nullptr;
+
+			T val = m_pItems[m_iHead];
+			m_iHead = (m_iHead + 1) & m_iMask;
+			m_iCount--;
+			return val;
+		}
+
+		size_t Size() const { return m_iCount; }
+		bool Empty() const { return m_iCount == 0; }
+		size_t Capacity() const { return m_iMask + 1; }
+
+	private:
+
+		void Grow() {
+			size_t oldSize = m_iMask + 1;
+			T* pItems = new T[oldSize * 2];
+
+			// Unwrap the items so the oldest is at index 0
+			for (size_t i = 0; i < m_iCount; i++)
+				pItems[i] = m_pItems[(m_iHead + i) & m_iMask];
+
+			delete[] m_pItems;
+			m_pItems = pItems;
+			m_iMask = oldSize * 2 - 1;
+			m_iHead = 0;
+		}
+
+		T* m_pItems;
+		size_t m_iMask;
+		size_t m_iHead;		// Index of the oldest item
+		size_t m_iCount;
+	};
+}
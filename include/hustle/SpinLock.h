@@ -5,7 +5,8 @@
 
 #include <atomic>
 
-#include <Windows.h>
+#include "Platform.h"
+
 namespace Hustle {
 
 	class SpinLock {
@@ -21,11 +22,10 @@ namespace Hustle {
 				while (m_Lock.load(std::memory_order_relaxed)) {
 					// Issue X86 PAUSE or ARM YIELD instruction to reduce contention between
 					// hyper-threads
-					// __builtin_ia32_pause(); on GCC or clang
 
 					// WARNING: It's noted here (https://graphitemaster.github.io/fibers/#avoid-the-pause-instruction) that 
 					// this may be a much larger CPU stall than we're hoping for due to recent Intel architecture changes
-					YieldProcessor();	// Under the hood will call _mm_pause()
+					Platform::CpuPause();
 				}
 			}
 		}
@@ -0,0 +1,136 @@
+#pragma once
+/**********************************************************************
+* Scheduler statistics. Every worker counts what it does in a block of
+* its own, with relaxed atomics that only it writes, so counting costs
+* a load and a store to a line no other thread writes. Dispatcher::
+* GetStats() adds the blocks up into a DispatcherStats snapshot on
+* demand. Always on.
+**********************************************************************/
+
+#include "Job.h"
+#include "Platform.h"
+
+#include <atomic>
+#include <stdint.h>
+
+namespace Hustle {
+
+	// Buckets in the queue wait histogram. Bucket 0 is a wait under 1 ns, bucket i (i > 0) a wait of at least
+	// 2^(i-1) and under 2^i ns. The last bucket takes everything from about a second up.
+	static const int QueueWaitBucketCount = 32;
+
+	/**
+	 * @brief Totals across every worker (and any thread helping out in a wait) since Init()
+	*/
+	struct DispatcherStats {
+		uint64_t iJobsExecuted = 0;		// Jobs run to completion, on a fiber or inline in WaitForJob()
+		uint64_t iFiberSwitches = 0;	// Switches into a fiber, to start or resume a job
+		uint64_t iFiberPoolExhaustions = 0;	// Jobs that found their fiber pool and its overflow reserve used up, and ran on the thread's own stack
+		uint64_t iFiberPoolOverruns = 0;	// Fibers added past a pool's overflow reserve, for jobs started by a wait on a thread's own stack
+		uint64_t iThreadStackCaps = 0;	// Waits that took no jobs because Dispatcher::MaxThreadStackDepth jobs were already nested on the thread's stack
+		uint64_t iSteals = 0;			// Jobs taken from another worker's deque
+		uint64_t iRemoteSteals = 0;		// The part of iSteals taken from a worker on another NUMA node
+
+		// Most jobs/fibers ever out of their pool at once (see ResourcePool::GetHighWaterMark()).
+		// Stack classes sharing a pool report the same number.
+		int iJobPoolHighWaterMark = 0;
+		int iFiberPoolHighWaterMark[StackClassCount] = {};
+
+		// Time from queueing a job to a worker starting it. Sampled, one job in QueueWaitSampleInterval.
+		uint64_t iQueueWaitHistogram[QueueWaitBucketCount] = {};
+
+		uint64_t GetQueueWaitSampleCount() const {
+			uint64_t iCount = 0;
+			for (int i = 0; i < QueueWaitBucketCount; i++)
+				iCount += iQueueWaitHistogram[i];
+			return iCount;
+		}
+
+		/**
+		 * @brief Upper bound of the queue wait bucket that holds a percentile of the samples
+		 * @param fPercentile - 0 to 100
+		 * @return Nanoseconds, or 0 if nothing has been sampled
+		*/
+		uint64_t GetQueueWaitPercentile(double fPercentile) const {
+			uint64_t iCount = GetQueueWaitSampleCount();
+			if (iCount == 0)
+				return 0;
+
+			uint64_t iRank = (uint64_t)(fPercentile / 100.0 * (double)iCount);
+			uint64_t iSeen = 0;
+			for (int i = 0; i < QueueWaitBucketCount; i++) {
+				iSeen += iQueueWaitHistogram[i];
+				if (iSeen > iRank)
+					return (uint64_t)1 << i;
+			}
+
+			return (uint64_t)1 << (QueueWaitBucketCount - 1);
+		}
+	};
+
+	/**
+	 * @brief One thread's counters. A worker's block is only ever written by the worker, so a count is a relaxed load
+	 * and store rather than a locked add. Blocks shared by several threads (bShared) pay for the fetch_add instead.
+	 * Readers see each counter on its own, not a consistent snapshot of all of them.
+	*/
+	class alignas(Platform::CacheLineSize) WorkerStats {
+	public:
+		explicit WorkerStats(bool bShared = false) : m_bShared(bShared) {}
+
+		WorkerStats(const WorkerStats&) = delete;
+		WorkerStats& operator=(const WorkerStats&) = delete;
+
+		void CountJob() { Add(m_iJobsExecuted); }
+		void CountFiberSwitch() { Add(m_iFiberSwitches); }
+		void CountFiberPoolExhaustion() { Add(m_iFiberPoolExhaustions); }
+		void CountFiberPoolOverrun() { Add(m_iFiberPoolOverruns); }
+		void CountThreadStackCap() { Add(m_iThreadStackCaps); }
+		void CountSteal() { Add(m_iSteals); }
+		void CountRemoteSteal() { Add(m_iRemoteSteals); }
+		void CountQueueWait(uint64_t iNs) { Add(m_iQueueWaitHistogram[GetQueueWaitBucket(iNs)]); }
+
+		uint64_t GetFiberSwitchCount() const { return m_iFiberSwitches.load(std::memory_order_relaxed); }
+
+		/**
+		 * @brief Add this block's counters onto a snapshot
+		*/
+		void AddTo(DispatcherStats& stats) const {
+			stats.iJobsExecuted += m_iJobsExecuted.load(std::memory_order_relaxed);
+			stats.iFiberSwitches += m_iFiberSwitches.load(std::memory_order_relaxed);
+			stats.iFiberPoolExhaustions += m_iFiberPoolExhaustions.load(std::memory_order_relaxed);
+			stats.iFiberPoolOverruns += m_iFiberPoolOverruns.load(std::memory_order_relaxed);
+			stats.iThreadStackCaps += m_iThreadStackCaps.load(std::memory_order_relaxed);
+			stats.iSteals += m_iSteals.load(std::memory_order_relaxed);
+			stats.iRemoteSteals += m_iRemoteSteals.load(std::memory_order_relaxed);
+			for (int i = 0; i < QueueWaitBucketCount; i++)
+				stats.iQueueWaitHistogram[i] += m_iQueueWaitHistogram[i].load(std::memory_order_relaxed);
+		}
+
+		static int GetQueueWaitBucket(uint64_t iNs) {
+			int iBucket = 0;
+			while (iNs != 0 && iBucket < QueueWaitBucketCount - 1) {
+				iNs >>= 1;
+				iBucket++;
+			}
+			return iBucket;
+		}
+
+	private:
+		void Add(std::atomic<uint64_t>& value) {
+			if (m_bShared)
+				value.fetch_add(1, std::memory_order_relaxed);
+			else
+				value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		std::atomic<uint64_t> m_iJobsExecuted = { 0 };
+		std::atomic<uint64_t> m_iFiberSwitches = { 0 };
+		std::atomic<uint64_t> m_iFiberPoolExhaustions = { 0 };
+		std::atomic<uint64_t> m_iFiberPoolOverruns = { 0 };
+		std::atomic<uint64_t> m_iThreadStackCaps = { 0 };
+		std::atomic<uint64_t> m_iSteals = { 0 };
+		std::atomic<uint64_t> m_iRemoteSteals = { 0 };
+		std::atomic<uint64_t> m_iQueueWaitHistogram[QueueWaitBucketCount] = {};
+		bool m_bShared;
+	};
+}
@@ -0,0 +1,284 @@
+#pragma once
+/**********************************************************************
+* C++20 coroutines on top of the Dispatcher.
+*
+* A Task<T> keeps its state in its coroutine frame rather than on a
+* fiber stack, so a suspended task costs its frame and nothing more.
+* Inside a task, co_await another Task, a JobHandle or a JobCounter
+* (CounterAwaiter for a target other than 0). Waiting on a job or a
+* counter suspends the task without holding a fiber or a thread. Once
+* the wait is over it's resumed through the Dispatcher's queues, as a
+* continuation (Dispatcher::AddContinuation()) on whichever thread
+* picks it up. Awaiting a task that hasn't been started runs it right
+* away on the same thread, then picks the awaiting task up where it left
+* off when it finishes.
+*
+* Outside of a task, Start() queues one and Get() waits for its result,
+* parking the fiber when called from a job.
+*
+* Only there when the compiler supports coroutines (C++20).
+**********************************************************************/
+
+#include "Dispatcher.h"
+#include "JobCounter.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <assert.h>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#define HUSTLE_HAS_COROUTINES 1
+
+namespace Hustle {
+
+	template<class T = void>
+	class Task;
+
+	/**
+	 * @brief co_await a counter until it drops to (or below) a target. The task is resumed by a continuation
+	 * queued at the given priority.
+	*/
+	class CounterAwaiter : private JobCounter::Waiter {
+	public:
+		CounterAwaiter(JobCounter& counter, int iTarget = 0, JobPriority ePriority = JobPriority::Normal) :
+			m_pCounter(&counter),
+			m_ePriority(ePriority) {
+			this->iTarget = iTarget;
+		}
+
+		bool await_ready() { return m_pCounter->HasReached(iTarget); }
+
+		bool await_suspend(std::coroutine_handle<> hCoroutine) {
+			m_hCoroutine = hCoroutine;
+			pfnWake = Wake;
+
+			// Reached in the meantime, carry straight on
+			return m_pCounter->AddWaiter(this);
+		}
+
+		void await_resume() {}
+
+	private:
+		static void Wake(JobCounter::Waiter* pWaiter) {
+
+			// The awaiter lives in the task's frame, which may be gone once the task resumes
+			CounterAwaiter* pThis = static_cast<CounterAwaiter*>(pWaiter);
+			Dispatcher::GetInstance().AddContinuation(Resume, pThis->m_hCoroutine.address(), pThis->m_ePriority);
+		}
+
+		static void Resume(void* pAddress) {
+			std::coroutine_handle<>::from_address(pAddress).resume();
+		}
+
+		JobCounter* m_pCounter;
+		JobPriority m_ePriority;
+		std::coroutine_handle<> m_hCoroutine;
+	};
+
+	namespace Detail {
+
+		class TaskPromiseBase {
+		public:
+			struct FinalAwaiter {
+				bool await_ready() noexcept { return false; }
+
+				template<class Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> hCoroutine) noexcept {
+
+					// Hand over to a task that's waiting on this one, on this thread. With nobody waiting yet, mark
+					// the task finished so a later co_await doesn't suspend. Anyone in Wait() may destroy the task as
+					// soon as the completion counter drops, so that's the last touch of the frame.
+					TaskPromiseBase& promise = hCoroutine.promise();
+					void* pContinuation = promise.m_pContinuation.exchange(&promise, std::memory_order_acq_rel);
+					if (pContinuation)
+						return std::coroutine_handle<>::from_address(pContinuation);
+
+					promise.m_Completion.Decrement();
+					return std::noop_coroutine();
+				}
+
+				void await_resume() noexcept {}
+			};
+
+			// Tasks don't run until they're started or awaited
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			FinalAwaiter final_suspend() noexcept { return {}; }
+
+			void unhandled_exception() { std::terminate(); }
+
+			// co_await a job or counter without spelling out the awaiter
+			CounterAwaiter await_transform(JobCounter& counter) { return CounterAwaiter(counter); }
+			CounterAwaiter await_transform(JobHandle hJob) { return CounterAwaiter(hJob->GetCompletion()); }
+
+			template<class Awaitable>
+			Awaitable&& await_transform(Awaitable&& awaitable) { return std::forward<Awaitable>(awaitable); }
+
+			/**
+			 * @brief Have the task resume hAwaiting when it finishes
+			 * @return false if it already has, so hAwaiting should carry on now
+			*/
+			bool SetContinuation(std::coroutine_handle<> hAwaiting) {
+				void* pExpected = nullptr;
+				return m_pContinuation.compare_exchange_strong(pExpected, hAwaiting.address(), std::memory_order_acq_rel);
+			}
+
+			JobCounter& GetCompletion() { return m_Completion; }
+
+		private:
+			// The awaiting task's frame, nullptr while nobody's waiting, or this promise once the task has finished
+			std::atomic<void*> m_pContinuation = { nullptr };
+
+			// 1 until the task finishes with nobody awaiting it, for Task::Wait()
+			JobCounter m_Completion = { 1 };
+		};
+
+		template<class T>
+		class TaskPromise : public TaskPromiseBase {
+		public:
+			Task<T> get_return_object();
+
+			template<class U>
+			void return_value(U&& value) { m_Result.emplace(std::forward<U>(value)); }
+
+			T TakeResult() {
+				assert(m_Result.has_value());
+				return std::move(*m_Result);
+			}
+
+		private:
+			std::optional<T> m_Result;
+		};
+
+		template<>
+		class TaskPromise<void> : public TaskPromiseBase {
+		public:
+			Task<void> get_return_object();
+
+			void return_void() {}
+			void TakeResult() {}
+		};
+	}
+
+	/**
+	 * @brief A coroutine returning T. Owns its frame, which is destroyed with it, so a started task must be
+	 * awaited or waited on before it goes away. Await a task or Wait() on it, not both.
+	*/
+	template<class T>
+	class [[nodiscard]] Task {
+	public:
+		using promise_type = Detail::TaskPromise<T>;
+
+		explicit Task(std::coroutine_handle<promise_type> hCoroutine) :
+			m_hCoroutine(hCoroutine),
+			m_bStarted(false) {
+		}
+
+		Task(Task&& other) noexcept :
+			m_hCoroutine(std::exchange(other.m_hCoroutine, nullptr)),
+			m_bStarted(other.m_bStarted) {
+		}
+
+		Task& operator=(Task&& other) noexcept {
+			if (this != &other) {
+				if (m_hCoroutine)
+					m_hCoroutine.destroy();
+				m_hCoroutine = std::exchange(other.m_hCoroutine, nullptr);
+				m_bStarted = other.m_bStarted;
+			}
+			return *this;
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		~Task() {
+			if (m_hCoroutine)
+				m_hCoroutine.destroy();
+		}
+
+		/**
+		 * @brief Queue the task to run on the Dispatcher, and return without waiting for it
+		*/
+		void Start(JobPriority ePriority = JobPriority::Normal) {
+			assert(m_hCoroutine && m_bStarted == false);
+			m_bStarted = true;
+			Dispatcher::GetInstance().AddContinuation(Resume, m_hCoroutine.address(), ePriority);
+		}
+
+		/**
+		 * @brief Wait for the task to finish, starting it first if need be. From a job, the fiber is parked meanwhile.
+		*/
+		void Wait() {
+			if (m_bStarted == false)
+				Start();
+			Dispatcher::GetInstance().WaitForCounter(&m_hCoroutine.promise().GetCompletion());
+		}
+
+		/**
+		 * @brief Wait() for the task, then take its result
+		*/
+		T Get() {
+			Wait();
+			return m_hCoroutine.promise().TakeResult();
+		}
+
+		class Awaiter {
+		public:
+			explicit Awaiter(Task& task) : m_Task(task) {}
+
+			bool await_ready() { return false; }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> hAwaiting) {
+
+				promise_type& promise = m_Task.m_hCoroutine.promise();
+
+				// Not running yet: run it here, it comes back to us when it's done
+				if (m_Task.m_bStarted == false) {
+					m_Task.m_bStarted = true;
+					promise.SetContinuation(hAwaiting);
+					return m_Task.m_hCoroutine;
+				}
+
+				// Running elsewhere. Either it picks us up when it finishes, or it already has.
+				if (promise.SetContinuation(hAwaiting))
+					return std::noop_coroutine();
+
+				return hAwaiting;
+			}
+
+			T await_resume() { return m_Task.m_hCoroutine.promise().TakeResult(); }
+
+		private:
+			Task& m_Task;
+		};
+
+		Awaiter operator co_await() & { return Awaiter(*this); }
+		Awaiter operator co_await() && { return Awaiter(*this); }
+
+	private:
+		static void Resume(void* pAddress) {
+			std::coroutine_handle<>::from_address(pAddress).resume();
+		}
+
+		std::coroutine_handle<promise_type> m_hCoroutine;
+		bool m_bStarted;
+	};
+
+	namespace Detail {
+
+		template<class T>
+		Task<T> TaskPromise<T>::get_return_object() {
+			return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+		}
+
+		inline Task<void> TaskPromise<void>::get_return_object() {
+			return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+namespace Hustle {
+
+	/**
+	 * @brief Small, dense per-thread indices for per-thread data kept in arrays, such as ResourcePool's magazines.
+	 * A thread claims a slot the first time it asks and hands it back when it exits, so no two running threads
+	 * ever share one. Once every slot is taken, further threads get -1 (and assert in debug builds).
+	*/
+	namespace ThreadSlot {
+
+		static const int MaxSlots = 4096;
+
+		/**
+		 * @brief The calling thread's slot
+		 * @return Index in [0, MaxSlots), or -1 if all of them are in use
+		*/
+		int Get();
+	}
+}
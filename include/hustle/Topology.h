@@ -0,0 +1,84 @@
+#pragma once
+/**********************************************************************
+* Which logical CPUs belong to which NUMA node and which physical core.
+* On Linux it's read from sysfs (/sys/devices/system/node and cpu), on
+* Windows from the NUMA and logical processor APIs. Where neither says
+* anything, the machine is one node and every CPU is a core of its own.
+**********************************************************************/
+
+#include <string>
+#include <vector>
+
+namespace Hustle {
+
+	class Topology {
+	public:
+
+		struct Node {
+			int iId;					// The OS's node number
+			std::vector<int> cpus;		// Logical CPUs on the node, ascending
+		};
+
+		/**
+		 * @brief Read the topology of the machine we're running on. Never fails: without anything better, every
+		 * CPU std::thread::hardware_concurrency() reports is put on one node.
+		*/
+		static Topology Detect();
+
+		/**
+		 * @brief Read a sysfs style tree: <root>/node/node<N>/cpulist for every node, then
+		 * <root>/cpu/cpu<N>/topology/thread_siblings_list for every CPU on them
+		 * @param root - Usually "/sys/devices/system"
+		 * @param topology - Receives the nodes and cores
+		 * @return false if no node could be read
+		*/
+		static bool ReadSysfs(const std::string& root, Topology& topology);
+
+		/**
+		 * @brief Parse a kernel CPU list, such as "0-3,8-11,16"
+		 * @return false if it's malformed
+		*/
+		static bool ParseCpuList(const std::string& text, std::vector<int>& cpus);
+
+		const std::vector<Node>& GetNodes() const { return m_Nodes; }
+		int GetNodeCount() const { return (int)m_Nodes.size(); }
+
+		/**
+		 * @brief Total logical CPUs across every node
+		*/
+		int GetCpuCount() const;
+
+		/**
+		 * @brief Index into GetNodes() of the node a CPU belongs to
+		 * @return -1 if the CPU isn't on any node
+		*/
+		int GetNodeOfCpu(int iCpu) const;
+
+		/**
+		 * @brief Physical cores, each the logical CPUs (SMT siblings) that share it, ascending, ordered by their first CPU
+		*/
+		const std::vector<std::vector<int>>& GetCores() const { return m_Cores; }
+
+		/**
+		 * @brief Index into GetCores() of the core a CPU belongs to
+		 * @return -1 if the CPU isn't on any core
+		*/
+		int GetCoreOfCpu(int iCpu) const;
+
+	private:
+
+		/**
+		 * @brief Group the CPUs on the nodes into cores from <root>/cpu/cpu<N>/topology/thread_siblings_list.
+		 * CPUs with no siblings list get a core to themselves.
+		*/
+		static void ReadSysfsCores(const std::string& root, Topology& topology);
+
+		/**
+		 * @brief One core per CPU on the nodes, for CPUs not on a core yet
+		*/
+		static void AddMissingCores(Topology& topology);
+
+		std::vector<Node> m_Nodes;					// Ordered by iId
+		std::vector<std::vector<int>> m_Cores;		// Ordered by first CPU
+	};
+}
@@ -0,0 +1,137 @@
+#pragma once
+/**********************************************************************
+* Optional scheduler tracing. Configure with HUSTLE_TRACING and every
+* thread the Dispatcher touches records when jobs run (including their
+* start and end), steals, idle periods and waits into a ring buffer of
+* its own. Dispatcher::DumpTrace() writes them out as Chrome trace
+* JSON, for chrome://tracing or ui.perfetto.dev. Without HUSTLE_TRACING
+* the HUSTLE_TRACE() macros compile to nothing.
+**********************************************************************/
+
+#include "Platform.h"
+
+#include <atomic>
+#include <stdint.h>
+
+// Events kept per thread before the oldest are overwritten, must be a power of two. 16 bytes each.
+#if !defined(HUSTLE_TRACE_BUFFER_SIZE)
+	#define HUSTLE_TRACE_BUFFER_SIZE (64 * 1024)
+#endif
+
+namespace Hustle {
+
+	enum class TraceEvent : uint8_t {
+		// A job starts or resumes running on this thread, usually by switching into its fiber.
+		// Recorded by the scheduler around the switch rather than in Fiber::Run(), so jobs run
+		// on a thread's stack show up too. Arg: the job, with the low bit set if this is the job starting.
+		JobRun,
+
+		// The job stops running on this thread, because it finished, yielded or parked.
+		// Arg: the job, with the low bit set if it finished.
+		JobStop,
+
+		Steal,		// Took a job from another worker's deque. Arg: the victim's index
+		IdleStart,	// A worker found nothing to run
+		IdleEnd,	// The worker found something again
+		WaitStart,	// A thread outside the Dispatcher started waiting on a counter. Arg: the counter
+		WaitEnd,	// The wait is over. Arg: the counter
+		Park,		// A job parked its fiber on a counter. Arg: the counter
+	};
+
+	/**
+	 * @brief One thread's events. Only the owning thread writes to it, and DumpTrace() may read it at any time:
+	 * entries the writer could have been overwriting while they were read are dropped.
+	*/
+	class TraceBuffer {
+	public:
+		static const uint64_t Capacity = HUSTLE_TRACE_BUFFER_SIZE;
+		static_assert((Capacity & (Capacity - 1)) == 0, "HUSTLE_TRACE_BUFFER_SIZE must be a power of two");
+
+		struct Record {
+			uint64_t iTicks;		// Platform::ReadTicks()
+			uint64_t iArg;
+			TraceEvent eEvent;
+		};
+
+		TraceBuffer(int iThreadIndex);
+		~TraceBuffer();
+
+		TraceBuffer(const TraceBuffer&) = delete;
+		TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+		void Push(TraceEvent eEvent, uint64_t iArg) {
+
+			// Entries are stored as relaxed atomics so a concurrent read is merely stale, never a data race
+			uint64_t iHead = m_iHead.load(std::memory_order_relaxed);
+			Entry& entry = m_pEntries[iHead & (Capacity - 1)];
+			entry.iTicks.store(Platform::ReadTicks(), std::memory_order_relaxed);
+			entry.iPacked.store((iArg << 8) | (uint64_t)eEvent, std::memory_order_relaxed);
+			m_iHead.store(iHead + 1, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Copy out the events still in the buffer, oldest first
+		 * @param pRecords - Room for Capacity records
+		 * @return Number of records copied
+		*/
+		uint64_t Read(Record* pRecords);
+
+		/**
+		 * @brief Forget every event recorded so far. Only safe while the owning thread isn't recording.
+		*/
+		void Clear() { m_iHead.store(0, std::memory_order_relaxed); }
+
+		void SetName(const char* szName);
+		const char* GetName() const { return m_szName; }
+		int GetThreadIndex() const { return m_iThreadIndex; }
+
+	private:
+		struct Entry {
+			std::atomic<uint64_t> iTicks;
+			std::atomic<uint64_t> iPacked;		// Arg in the top 56 bits, event in the bottom 8
+		};
+
+		Entry* m_pEntries;
+		std::atomic<uint64_t> m_iHead;		// Events ever recorded
+		int m_iThreadIndex;
+		char m_szName[32];
+	};
+
+	namespace Trace {
+
+		/**
+		 * @brief Record an event in the calling thread's buffer, creating the buffer on the thread's first event
+		*/
+		void Record(TraceEvent eEvent, uint64_t iArg = 0);
+
+		/**
+		 * @brief Name the calling thread's track in the trace. Unnamed threads show up as "Thread <n>".
+		*/
+		void SetThreadName(const char* szName);
+
+		/**
+		 * @brief Pause or resume recording at run time. On by default.
+		*/
+		void SetEnabled(bool bEnabled);
+		bool IsEnabled();
+
+		/**
+		 * @brief Forget everything recorded so far, on every thread. Only safe while no thread is recording.
+		*/
+		void Clear();
+
+		/**
+		 * @brief Write every thread's events to szPath as Chrome trace JSON
+		 * @return false if the file couldn't be written
+		*/
+		bool Dump(const char* szPath);
+	}
+}
+
+#if defined(HUSTLE_TRACING)
+	#define HUSTLE_TRACE(eEvent, iArg) ::Hustle::Trace::Record(::Hustle::TraceEvent::eEvent, (uint64_t)(iArg))
+	#define HUSTLE_TRACE_THREAD_NAME(szName) ::Hustle::Trace::SetThreadName(szName)
+#else
+	#define HUSTLE_TRACE(eEvent, iArg) ((void)0)
+	#define HUSTLE_TRACE_THREAD_NAME(szName) ((void)0)
+#endif
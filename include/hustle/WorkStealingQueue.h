@@ -0,0 +1,183 @@
+#pragma once
+/**********************************************************************
+* Chase-Lev work stealing deque, using the C11 memory model mapping from
+* "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.)
+*
+* A single owner thread pushes and pops at the bottom (LIFO), any number of
+* other threads steal from the top (FIFO). T must be a pointer type.
+**********************************************************************/
+
+#include <assert.h>
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+namespace Hustle {
+
+	template<class T>
+	class WorkStealingQueue {
+	public:
+
+		/**
+		 * @brief Create the deque.
+		 * @param iCapacity - Initial number of slots, rounded up to a power of two. The deque grows as needed.
+		*/
+		WorkStealingQueue(int64_t iCapacity = 1024) :
+			m_Top(0),
+			m_Bottom(0) {
+
+			int64_t iSize = 1;
+			while (iSize < iCapacity)
+				iSize <<= 1;
+
+			m_pBuffer.store(new Buffer(iSize), std::memory_order_relaxed);
+		}
+
+		~WorkStealingQueue() {
+			delete m_pBuffer.load(std::memory_order_relaxed);
+
+			for (auto pBuffer : m_RetiredBuffers)
+				delete pBuffer;
+		}
+
+		WorkStealingQueue(const WorkStealingQueue&) = delete;
+		WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+		/**
+		 * @brief Push an item onto the bottom of the deque. Owner thread only.
+		*/
+		void Push(T val) {
+			int64_t iBottom = m_Bottom.load(std::memory_order_relaxed);
+			int64_t iTop = m_Top.load(std::memory_order_acquire);
+			Buffer* pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+
+			// Full, double the size. Thieves may still be reading the old buffer so it is retired, not freed.
+			if (iBottom - iTop > pBuffer->iSize - 1) {
+				Buffer* pGrown = pBuffer->Grow(iTop, iBottom);
+				m_RetiredBuffers.push_back(pBuffer);
+				m_pBuffer.store(pGrown, std::memory_order_release);
+				pBuffer = pGrown;
+			}
+
+			pBuffer->Put(iBottom, val);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_Bottom.store(iBottom + 1, std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Push several items onto the bottom of the deque, publishing them to thieves with a single store.
+		 * The last item is the first one Pop() returns. Owner thread only.
+		*/
+		void PushBulk(T* pItems, size_t iCount) {
+			int64_t iBottom = m_Bottom.load(std::memory_order_relaxed);
+			int64_t iTop = m_Top.load(std::memory_order_acquire);
+			Buffer* pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+
+			while (iBottom - iTop + (int64_t)iCount > pBuffer->iSize) {
+				Buffer* pGrown = pBuffer->Grow(iTop, iBottom);
+				m_RetiredBuffers.push_back(pBuffer);
+				m_pBuffer.store(pGrown, std::memory_order_release);
+				pBuffer = pGrown;
+			}
+
+			for (size_t i = 0; i < iCount; i++)
+				pBuffer->Put(iBottom + (int64_t)i, pItems[i]);
+
+			std::atomic_thread_fence(std::memory_order_release);
+			m_Bottom.store(iBottom + (int64_t)iCount, std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Pop the most recently pushed item. Owner thread only.
+		 * @return The item, or nullptr if the deque is empty
+		*/
+		T Pop() {
+			int64_t iBottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+			Buffer* pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+			m_Bottom.store(iBottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t iTop = m_Top.load(std::memory_order_relaxed);
+
+			T val = nullptr;
+			if (iTop <= iBottom) {
+				val = pBuffer->Get(iBottom);
+
+				// Last item, race any thieves for it
+				if (iTop == iBottom) {
+					if (!m_Top.compare_exchange_strong(iTop, iTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						val = nullptr;
+					m_Bottom.store(iBottom + 1, std::memory_order_relaxed);
+				}
+			}
+			else {
+				m_Bottom.store(iBottom + 1, std::memory_order_relaxed);
+			}
+
+			return val;
+		}
+
+		/**
+		 * @brief Take the oldest item from the deque. Safe to call from any thread.
+		 * @return The item, or nullptr if the deque was empty or another thread won the race for it
+		*/
+		T Steal() {
+			int64_t iTop = m_Top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t iBottom = m_Bottom.load(std::memory_order_acquire);
+
+			if (iTop < iBottom) {
+				Buffer* pBuffer = m_pBuffer.load(std::memory_order_acquire);
+				T val = pBuffer->Get(iTop);
+				if (!m_Top.compare_exchange_strong(iTop, iTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return nullptr;
+				return val;
+			}
+
+			return nullptr;
+		}
+
+		/**
+		 * @brief Approximate number of items in the deque. Exact when called from the owner with no thieves active.
+		*/
+		size_t Size() {
+			int64_t iBottom = m_Bottom.load(std::memory_order_relaxed);
+			int64_t iTop = m_Top.load(std::memory_order_relaxed);
+			return iBottom > iTop ? (size_t)(iBottom - iTop) : 0;
+		}
+
+	private:
+
+		struct Buffer {
+			int64_t iSize;
+			int64_t iMask;
+			std::atomic<T>* pSlots;
+
+			Buffer(int64_t iCapacity) :
+				iSize(iCapacity),
+				iMask(iCapacity - 1),
+				pSlots(new std::atomic<T>[iCapacity]) {
+				assert((iCapacity & iMask) == 0);
+			}
+
+			~Buffer() { delete[] pSlots; }
+
+			T Get(int64_t i) { return pSlots[i & iMask].load(std::memory_order_relaxed); }
+			void Put(int64_t i, T val) { pSlots[i & iMask].store(val, std::memory_order_relaxed); }
+
+			Buffer* Grow(int64_t iTop, int64_t iBottom) {
+				Buffer* pGrown = new Buffer(iSize * 2);
+				for (int64_t i = iTop; i < iBottom; i++)
+					pGrown->Put(i, Get(i));
+				return pGrown;
+			}
+		};
+
+		// Top and bottom are written by different threads, keep them on separate cache lines
+		alignas(64) std::atomic<int64_t> m_Top;
+		alignas(64) std::atomic<int64_t> m_Bottom;
+		alignas(64) std::atomic<Buffer*> m_pBuffer;
+
+		// Buffers replaced by Grow(), kept alive until destruction since a thief may still hold one
+		std::vector<Buffer*> m_RetiredBuffers;
+	};
+}
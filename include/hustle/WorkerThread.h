@@ -1,9 +1,21 @@
 #pragma once
 
+#include "Job.h"
+#include "Platform.h"
+#include "RingBuffer.h"
+#include "Stats.h"
+#include "WorkStealingQueue.h"
+
 #include <atomic>
-#include <windows.h>
+#include <stdint.h>
+#include <string>
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+	#include <pthread.h>
+#endif
 
 namespace Hustle {
+	class Fiber;
 
 	class WorkerThread {
 	public:
@@ -27,20 +39,71 @@ namespace Hustle {
 		void Stop();
 
 		std::string GetLastError() { return m_LastError; }
+
+		/**
+		 * @brief This worker's deque of jobs for a priority. Only the worker itself may Push()/Pop(), other workers Steal().
+		*/
+		WorkStealingQueue<Job*>& GetJobQueue(JobPriority ePriority) { return m_Jobs[(int)ePriority]; }
+
+		/**
+		 * @brief Fibers that yielded, or were woken on this worker, waiting to be resumed. Only touched by the worker itself.
+		*/
+		RingBuffer<Fiber*>& GetReadyFibers() { return m_ReadyFibers; }
+
+		/**
+		 * @brief Number of times this worker's scheduler has switched into a fiber
+		*/
+		uint64_t GetFiberSwitchCount() { return m_Stats.GetFiberSwitchCount(); }
+		void CountFiberSwitch() { m_Stats.CountFiberSwitch(); }
+
+		/**
+		 * @brief Counters for Dispatcher::GetStats(). Only written by the worker itself.
+		*/
+		WorkerStats& GetStats() { return m_Stats; }
+
+		/**
+		 * @brief NUMA node the worker is placed on, in the Dispatcher's numbering (0 to its node count). Set before Start().
+		*/
+		void SetNode(int iNode) { m_iNode = iNode; }
+		int GetNode() { return m_iNode; }
+
 	private:
 
+		// OS thread entry point, hands off to Dispatcher::Scheduler()
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+		static DWORD WINAPI ThreadEntryPoint(LPVOID pData);
 		std::string GetLastErrorAsStr(DWORD dwError);
+#else
+		static void* ThreadEntryPoint(void* pData);
+		std::string GetLastErrorAsStr(int iError);
+#endif
 
 		// What core to run on. -1 means we don't care.
 		int m_iCoreAffinity;
 
+		int m_iNode;
+
 		// State of the thread
 		std::atomic<State>	m_eState;
 
 		// Thread handle & ID
+#if defined(HUSTLE_PLATFORM_WINDOWS)
 		HANDLE m_hThread;
 		DWORD  m_dwThreadID;
+#else
+		pthread_t m_hThread;
+		bool m_bThreadCreated;
+#endif
 
 		std::string m_LastError;
+
+		// Jobs spawned by fibers running on this worker, one deque per priority
+		WorkStealingQueue<Job*> m_Jobs[JobPriorityCount];
+
+		// Fibers ready to continue on this worker
+		RingBuffer<Fiber*> m_ReadyFibers;
+
+		// Only written by the worker, read by anyone
+		WorkerStats m_Stats;
 	};
 }
\ No newline at end of file
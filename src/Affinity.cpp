@@ -0,0 +1,162 @@
+#include "hustle/Affinity.h"
+#include "hustle/Platform.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+	#include <sched.h>
+#endif
+
+namespace Hustle {
+
+	std::vector<int> AffinityPolicy::GetPlacement(const Topology& topology, const std::vector<int>& allowedCpus, bool bNodeOrder) const {
+
+		std::vector<int> order;
+		for (auto& node : topology.GetNodes())
+			order.insert(order.end(), node.cpus.begin(), node.cpus.end());
+		if (bNodeOrder == false)
+			std::sort(order.begin(), order.end());
+
+		std::vector<bool> coreUsed(topology.GetCores().size(), false);
+		std::vector<int> placement;
+		for (int iCpu : order) {
+
+			if (allowedCpus.empty() == false && std::binary_search(allowedCpus.begin(), allowedCpus.end(), iCpu) == false)
+				continue;
+
+			if (eMode == Mode::PhysicalCores) {
+				// The first allowed sibling stands in for the core
+				int iCore = topology.GetCoreOfCpu(iCpu);
+				if (iCore != -1) {
+					if (coreUsed[iCore])
+						continue;
+					coreUsed[iCore] = true;
+				}
+			}
+			else if (eMode == Mode::CpuSet) {
+				if (std::find(cpus.begin(), cpus.end(), iCpu) == cpus.end())
+					continue;
+			}
+
+			placement.push_back(iCpu);
+		}
+
+		if (bReserveFirstCpu && placement.size() > 1)
+			std::rotate(placement.begin(), placement.begin() + 1, placement.end());
+
+		return placement;
+	}
+
+	int AffinityPolicy::GetDefaultWorkerCount(int iPlacementCount, int iCpuQuota) const {
+
+		int iCount = iPlacementCount;
+		if (bHonorCpuQuota && iCpuQuota > 0)
+			iCount = (std::min)(iCount, iCpuQuota);
+
+		if (bReserveFirstCpu)
+			iCount--;
+
+		return (std::max)(1, iCount);
+	}
+
+	std::vector<int> AffinityPolicy::GetAllowedCpus() {
+
+		std::vector<int> allowedCpus;
+
+#if defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0) {
+			for (int iCpu = 0; iCpu < CPU_SETSIZE; iCpu++) {
+				if (CPU_ISSET(iCpu, &cpuSet))
+					allowedCpus.push_back(iCpu);
+			}
+		}
+#elif defined(HUSTLE_PLATFORM_WINDOWS)
+		DWORD_PTR processMask = 0;
+		DWORD_PTR systemMask = 0;
+		if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+			for (int iCpu = 0; iCpu < (int)(sizeof(processMask) * 8); iCpu++) {
+				if (processMask & ((DWORD_PTR)1 << iCpu))
+					allowedCpus.push_back(iCpu);
+			}
+		}
+#endif
+
+		return allowedCpus;
+	}
+
+	int AffinityPolicy::GetCpuQuota() {
+
+		int iQuota = 0;
+
+#if defined(__linux__)
+		// Lines are hierarchy:controllers:path. v2 is "0::/path", v1 lists its controllers, and we want cpu.
+		std::ifstream file("/proc/self/cgroup");
+		std::string line;
+		while (std::getline(file, line)) {
+
+			size_t iFirstColon = line.find(':');
+			size_t iSecondColon = line.find(':', iFirstColon + 1);
+			if (iFirstColon == std::string::npos || iSecondColon == std::string::npos)
+				continue;
+
+			std::string controllers = "," + line.substr(iFirstColon + 1, iSecondColon - iFirstColon - 1) + ",";
+			std::string path = line.substr(iSecondColon + 1);
+
+			std::string mount;
+			if (controllers == ",,")
+				mount = "/sys/fs/cgroup";
+			else if (controllers.find(",cpu,") != std::string::npos)
+				mount = "/sys/fs/cgroup/cpu";
+			else
+				continue;
+
+			// A quota anywhere up the hierarchy applies. Inside a container the path may not exist,
+			// but the mount point is then the container's own cgroup.
+			while (true) {
+				int iDirQuota = ReadCgroupCpuQuota(mount + path);
+				if (iDirQuota > 0 && (iQuota == 0 || iDirQuota < iQuota))
+					iQuota = iDirQuota;
+
+				if (path.empty() || path == "/")
+					break;
+
+				size_t iSlash = path.find_last_of('/');
+				path = iSlash == std::string::npos ? "" : path.substr(0, iSlash);
+			}
+		}
+#endif
+
+		return iQuota;
+	}
+
+	int AffinityPolicy::ReadCgroupCpuQuota(const std::string& cgroupDir) {
+
+		long long iQuota = -1;
+		long long iPeriod = 0;
+
+		std::ifstream cpuMax(cgroupDir + "/cpu.max");
+		if (cpuMax) {
+			// "max 100000" or "<quota> <period>"
+			std::string quota;
+			if (!(cpuMax >> quota >> iPeriod) || quota == "max")
+				return 0;
+
+			std::istringstream(quota) >> iQuota;
+		}
+		else {
+			std::ifstream cfsQuota(cgroupDir + "/cpu.cfs_quota_us");
+			std::ifstream cfsPeriod(cgroupDir + "/cpu.cfs_period_us");
+			if (!(cfsQuota >> iQuota) || !(cfsPeriod >> iPeriod))
+				return 0;
+		}
+
+		if (iQuota <= 0 || iPeriod <= 0)
+			return 0;
+
+		return (int)((iQuota + iPeriod - 1) / iPeriod);
+	}
+}
@@ -1,31 +1,120 @@
 #include "hustle/Dispatcher.h"
 #include "hustle/Fiber.h"
+#include "hustle/Topology.h"
+#include "hustle/Trace.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <thread>
-#include <Windows.h>
+#include <vector>
 
 namespace Hustle {
+
+	// The worker whose scheduler is running on this thread, nullptr for any other thread
+	static thread_local WorkerThread* t_pCurrentWorker = nullptr;
+
+	// The fiber for this thread's own stack: the scheduler's on a worker, the one HelpUntil() made on any other thread
+	static thread_local Fiber* t_pThreadFiber = nullptr;
+
+	// Jobs running nested on this thread's own stack, see RunJobOnThreadStack()
+	static thread_local int t_iThreadStackDepth = 0;
+
+	// Jobs queued by this thread, picks which ones get their queue wait sampled
+	static thread_local uint32_t t_iQueuedJobs = 0;
+
+	static uint64_t NowNs() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
 	
 	bool Dispatcher::Init(int iFiberPoolSize, int iJobPoolSize, int iWorkerThreadCount) {
 
-		// Set a growth factor on the fiber pool
-		m_FiberPool.Grow(iFiberPoolSize);
-		m_FiberPool.SetGrowthFactor(10);
+		// A single pool of full size stacks, shared by both stack classes
+		DispatcherConfig config;
+		config.fiberPools[(int)StackClass::Small] = { iFiberPoolSize, Fiber::DefaultStackSize };
+		config.fiberPools[(int)StackClass::Large] = { 0, Fiber::DefaultStackSize };
+		config.iJobPoolSize = iJobPoolSize;
+		config.iWorkerThreadCount = iWorkerThreadCount;
+
+		return Init(config);
+	}
+
+	bool Dispatcher::Init(const DispatcherConfig& config) {
+
+		int iWorkerThreadCount = config.iWorkerThreadCount;
+		m_IdlePolicy = config.idlePolicy;
+		m_bHelpWhileWaiting = config.bHelpWhileWaiting;
+		m_bNumaAware = config.bNumaAware;
+		m_Config = config;
 
-		m_JobPool.Grow(iJobPoolSize);
-		m_JobPool.SetGrowthFactor(10);
+		for (int i = 0; i < StackClassCount; i++)
+			assert(config.fiberPools[i].iFiberCount > 0 || config.fiberPools[(i + 1) % StackClassCount].iFiberCount > 0);
 
 		bool bReturn = true;		
 
-		// Create a thread for each core, except on core 0
+		// The CPUs to put workers on, in order. NUMA aware, that's node by node, so neighbouring workers share a node.
+		// The policy decides which CPUs make the list, and by default keeps the first one back for this thread.
+		Topology topology = Topology::Detect();
+		std::vector<int> cores = config.affinity.GetPlacement(topology, AffinityPolicy::GetAllowedCpus(), m_bNumaAware);
+		if (cores.empty()) {
+			m_LastError = "The affinity policy leaves no CPU to run workers on";
+			return false;
+		}
+
 		if (iWorkerThreadCount == -1)
-			m_iWorkerThreadCount = std::thread::hardware_concurrency() - 1;
+			m_iWorkerThreadCount = config.affinity.GetDefaultWorkerCount((int)cores.size(), AffinityPolicy::GetCpuQuota());
 		else
 			m_iWorkerThreadCount = iWorkerThreadCount;
 
+		// Unpinned workers can end up anywhere, so they all count as one node
+		if (config.affinity.eMode == AffinityPolicy::Mode::Inherit)
+			cores.assign(1, -1);
+
+		// Wrap around if more threads than cores were requested
+		std::vector<int> workerCores(m_iWorkerThreadCount);
+		std::vector<int> workerTopologyNodes(m_iWorkerThreadCount);
+		std::vector<bool> nodeHasWorkers(topology.GetNodeCount(), false);
+		for (int i = 0; i < m_iWorkerThreadCount; i++) {
+			workerCores[i] = cores[i % cores.size()];
+			workerTopologyNodes[i] = (std::max)(0, topology.GetNodeOfCpu(workerCores[i]));
+			nodeHasWorkers[workerTopologyNodes[i]] = true;
+		}
+
+		// Number the nodes that got workers from 0, in the OS's order
+		std::vector<int> nodeIndex(topology.GetNodeCount(), -1);
+		m_iNodeCount = 0;
+		for (int i = 0; i < topology.GetNodeCount(); i++) {
+			if (nodeHasWorkers[i])
+				nodeIndex[i] = m_iNodeCount++;
+		}
+		m_iNodeCount = (std::max)(1, m_iNodeCount);
+
+		m_NodeOfCpu.clear();
+		for (int i = 0; i < topology.GetNodeCount(); i++) {
+			for (int iCpu : topology.GetNodes()[i].cpus) {
+				if ((int)m_NodeOfCpu.size() <= iCpu)
+					m_NodeOfCpu.resize(iCpu + 1, -1);
+				m_NodeOfCpu[iCpu] = nodeIndex[i];
+			}
+		}
+
 		m_pWorkerThreads = new WorkerThread[m_iWorkerThreadCount];
+		m_NodeWorkers.assign(m_iNodeCount, {});
+		for (int i = 0; i < m_iWorkerThreadCount; i++) {
+			int iNode = nodeIndex[workerTopologyNodes[i]];
+			m_pWorkerThreads[i].SetNode(iNode);
+			m_NodeWorkers[iNode].push_back(i);
+		}
+
+		// Each node's first worker creates its pools, before it reports in as running
+		m_NodePools.clear();
+		m_NodePools.resize(m_bNumaAware ? m_iNodeCount : 1);
+
+		// With no workers at all, there's nobody else to do it
+		if (m_iWorkerThreadCount == 0)
+			CreateNodePools(0);
 
 		// Start up each thread, setting CPU affinity for each one.
 		for (int i = 0; i < m_iWorkerThreadCount; i++) {
@@ -33,9 +122,7 @@ namespace Hustle {
 			// Creating this temp variable to avoid C6385
 			WorkerThread* pThread = &m_pWorkerThreads[i];
 
-			// m_iWorkerThreadCount is always the number of CPUs, less one. 
-			// We don't want any worker threads running on CPU 0, so always add 1 to i. 
-			if (pThread->Start(i + 1) == false) {
+			if (pThread->Start(workerCores[i]) == false) {
 				
 				m_LastError = pThread->GetLastError();
 				bReturn = false;
@@ -57,7 +144,7 @@ namespace Hustle {
 
 					if (pWorkerThread->GetState() != WorkerThread::State::Running) {
 						bAllThreadsReady = false;
-						Yield();
+						Platform::ThreadYield();
 						break;
 					}
 				}
@@ -67,56 +154,590 @@ namespace Hustle {
 		return bReturn;
 	}
 	
+	void Dispatcher::CreateNodePools(int iNode) {
+
+		std::unique_ptr<NodePools> pPools(new NodePools());
+
+		for (int i = 0; i < StackClassCount; i++) {
+
+			const FiberPoolConfig& poolConfig = m_Config.fiberPools[i];
+			if (poolConfig.iFiberCount > 0)
+				pPools->pFiberPoolForClass[i] = &pPools->fiberPools[i];
+			else
+				pPools->pFiberPoolForClass[i] = &pPools->fiberPools[(i + 1) % StackClassCount];
+
+			// Past iFiberCount the pool only grows into the overflow reserve, a step at a time
+			int iOverflowCount = poolConfig.iOverflowCount;
+			if (iOverflowCount < 0)
+				iOverflowCount = poolConfig.iFiberCount * DefaultFiberOverflowFactor;
+
+			// Every fiber in the pool, including any it grows by, gets this class's stack size
+			size_t stackSize = poolConfig.stackSize;
+			pPools->fiberPools[i].SetConstructor([stackSize, iNode](void* pStorage) {
+				Fiber* pFiber = new (pStorage) Fiber(stackSize);
+				pFiber->SetNode(iNode);
+				return pFiber;
+			});
+
+			pPools->fiberPools[i].Grow(poolConfig.iFiberCount);
+			pPools->fiberPools[i].SetGrowthFactor(FiberPoolGrowthFactor);
+			pPools->fiberPools[i].SetMaxCount(poolConfig.iFiberCount + iOverflowCount);
+		}
+
+		pPools->jobPool.SetConstructor([iNode](void* pStorage) {
+			Job* pJob = new (pStorage) Job();
+			pJob->SetNode(iNode);
+			return pJob;
+		});
+		pPools->jobPool.Grow(m_Config.iJobPoolSize);
+		pPools->jobPool.SetGrowthFactor(10);
+
+		m_NodePools[iNode] = std::move(pPools);
+	}
+
+	int Dispatcher::GetThreadNode() {
+
+		if (t_pCurrentWorker)
+			return t_pCurrentWorker->GetNode();
+
+		int iCpu = Platform::GetCurrentCpu();
+		if (iCpu >= 0 && iCpu < (int)m_NodeOfCpu.size() && m_NodeOfCpu[iCpu] >= 0)
+			return m_NodeOfCpu[iCpu];
+
+		return 0;
+	}
+
 	void Dispatcher::Shutdown() {
 
+		// Flag every thread first, then wake any that are asleep so they see it
+		for (int i = 0; i < m_iWorkerThreadCount; i++)
+			m_pWorkerThreads[i].SetState(WorkerThread::State::Stopping);
+
+		m_iWakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+		Platform::WakeAddress(&m_iWakeEpoch, INT32_MAX);
+
 		// Stop all of the threads
 		for (int i = 0; i < m_iWorkerThreadCount; i++)
 			m_pWorkerThreads[i].Stop();
 
 		if (m_pWorkerThreads)
 			delete[] m_pWorkerThreads;
+
+		m_pWorkerThreads = nullptr;
+		m_iWorkerThreadCount = 0;
+
+		// Destroy the pools
+		m_NodePools.clear();
 	}
 	
-	JobHandle Dispatcher::AddJob(JobEntryPoint entryPoint, void* pUserData) {
+	JobHandle Dispatcher::AddJob(JobEntryPoint entryPoint, void* pUserData, JobCounter* pCounter, JobPriority ePriority, StackClass eStackClass) {
+
+		Job* pJob = AcquireJob();
+
+		pJob->SetEntryPoint(std::move(entryPoint));
+		pJob->SetUserData(pUserData);
+
+		return QueueJob(pJob, pCounter, ePriority, eStackClass);
+	}
+
+	void Dispatcher::AddContinuation(JobEntryPoint entryPoint, void* pUserData, JobPriority ePriority) {
+
+		Job* pJob = AcquireJob();
+
+		pJob->SetEntryPoint(std::move(entryPoint));
+		pJob->SetUserData(pUserData);
+		pJob->SetContinuation(true);
+
+		QueueJob(pJob, nullptr, ePriority, StackClass::Small);
+	}
+
+	Job* Dispatcher::AcquireJob() {
 
 		Job* pJob;
 
 		// Poll until we get something from the pool		
-		pJob = m_JobPool.Get();
+		pJob = GetJobPool().Get();
 
 		// There are no available jobs! 
 		assert(pJob != nullptr);
-		
 
-		// When the job finishes, it will be unlocked. Until then, calls to WaitForJob() will wait.
-		pJob->Lock();
+		return pJob;
+	}
+
+	JobHandle Dispatcher::QueueJob(Job* pJob, JobCounter* pCounter, JobPriority ePriority, StackClass eStackClass) {
 
-		// TODO: handle this better
-		assert(pJob != nullptr);
+		// When the job finishes, this drops to 0. Until then, calls to WaitForJob() will wait.
+		pJob->GetCompletion().SetValue(1);
+		pJob->GetRunState().store(Job::RunState::Queued, std::memory_order_relaxed);
 
-		pJob->SetEntryPoint(entryPoint);
-		pJob->SetUserData(pUserData);
+		pJob->SetCounter(pCounter);
+		pJob->SetPriority(ePriority);
+		pJob->SetStackClass(eStackClass);
+		StampQueuedTime(pJob);
+
+		// Jobs spawned from a worker stay local (and hot in cache) until someone steals them
+		if (t_pCurrentWorker)
+			t_pCurrentWorker->GetJobQueue(ePriority).Push(pJob);
+		else
+			m_InjectedJobs[(int)ePriority].Push(pJob);
+
+		WakeWorkers(1);
 
-		m_Jobs.Push(pJob);
 		return pJob;
 	}
+
+	void Dispatcher::AddJobs(const JobDecl* pJobs, int iCount, JobCounter* pCounter) {
+
+		// Raise the counter up front so a waiter can't see it hit zero before the last job is queued
+		if (pCounter)
+			pCounter->Increment(iCount);
+
+		// Jobs are taken from the pool and queued a chunk at a time, so the scratch space lives on the stack
+		Job* pAcquired[BulkChunkSize];
+		Job* pByPriority[JobPriorityCount][BulkChunkSize];
+
+		for (int iChunk = 0; iChunk < iCount; iChunk += BulkChunkSize) {
+
+			int iChunkCount = (std::min)(BulkChunkSize, iCount - iChunk);
+
+			int iAcquired = GetJobPool().GetBulk(pAcquired, iChunkCount);
+
+			// There are no available jobs!
+			assert(iAcquired == iChunkCount);
+
+			int iPriorityCount[JobPriorityCount] = {};
+			for (int i = 0; i < iAcquired; i++) {
+				const JobDecl& decl = pJobs[iChunk + i];
+				Job* pJob = pAcquired[i];
+
+				pJob->SetEntryPoint(decl.entryPoint);
+				pJob->SetUserData(decl.pUserData);
+				pJob->GetCompletion().SetValue(1);
+				pJob->GetRunState().store(Job::RunState::Queued, std::memory_order_relaxed);
+				pJob->SetCounter(pCounter);
+				pJob->SetPriority(decl.ePriority);
+				pJob->SetStackClass(decl.eStackClass);
+				StampQueuedTime(pJob);
+
+				int iPriority = (int)decl.ePriority;
+				pByPriority[iPriority][iPriorityCount[iPriority]++] = pJob;
+			}
+
+			// One push per priority, under one lock (or one deque publish) each
+			for (int iPriority = 0; iPriority < JobPriorityCount; iPriority++) {
+				if (iPriorityCount[iPriority] == 0)
+					continue;
+
+				if (t_pCurrentWorker)
+					t_pCurrentWorker->GetJobQueue((JobPriority)iPriority).PushBulk(pByPriority[iPriority], iPriorityCount[iPriority]);
+				else
+					m_InjectedJobs[iPriority].PushBulk(pByPriority[iPriority], iPriorityCount[iPriority]);
+			}
+
+			WakeWorkers(iAcquired);
+		}
+	}
+
+	bool Dispatcher::RunGraph(JobGraph& graph, JobCounter* pCounter) {
+
+		// A cycle would never finish. Prepare() has already worked it out, so this is free after the first run.
+		if (graph.IsAcyclic() == false)
+			return false;
+
+		if (graph.GetNodeCount() == 0)
+			return true;
+
+		// Every node lowers the counter once, so raise it for all of them before anything can run
+		if (pCounter)
+			pCounter->Increment(graph.GetNodeCount());
+
+		graph.Reset();
+		for (auto root : graph.m_Roots)
+			QueueGraphNode(&graph, root, pCounter);
+
+		return true;
+	}
+
+	void Dispatcher::QueueGraphNode(JobGraph* pGraph, JobGraph::NodeId node, JobCounter* pCounter) {
+
+		const JobGraph::Node& graphNode = pGraph->m_Nodes[node];
+
+		Job* pJob = AcquireJob();
+		pJob->SetEntryPoint([this, pGraph, node, pCounter](void*) { RunGraphNodes(pGraph, node, pCounter); });
+		pJob->SetUserData(nullptr);
+
+		QueueJob(pJob, pCounter, graphNode.ePriority, graphNode.eStackClass);
+	}
+
+	void Dispatcher::RunGraphNodes(JobGraph* pGraph, JobGraph::NodeId node, JobCounter* pCounter) {
+
+		// What the job was queued with. Only successors that match can carry on in this job.
+		JobPriority ePriority = pGraph->m_Nodes[node].ePriority;
+		StackClass eStackClass = pGraph->m_Nodes[node].eStackClass;
+
+		for (;;) {
+			const JobGraph::Node& current = pGraph->m_Nodes[node];
+			current.entryPoint(current.pUserData);
+
+			JobGraph::NodeId next = -1;
+			for (int i = 0; i < current.iSuccessorCount; i++) {
+				JobGraph::NodeId successor = pGraph->m_Successors[current.iFirstSuccessor + i];
+				if (pGraph->Release(successor) == false)
+					continue;
+
+				const JobGraph::Node& ready = pGraph->m_Nodes[successor];
+				if (next < 0 && ready.ePriority == ePriority && ready.eStackClass == eStackClass)
+					next = successor;
+				else
+					QueueGraphNode(pGraph, successor, pCounter);
+			}
+
+			// The job's own completion accounts for the last node it runs
+			if (next < 0)
+				return;
+
+			// Still holding next's count, so this can't take the counter to zero
+			if (pCounter)
+				pCounter->Decrement();
+
+			node = next;
+		}
+	}
+
+	size_t Dispatcher::GetJobQueueDepth() {
+
+		size_t depth = 0;
+		for (int i = 0; i < JobPriorityCount; i++)
+			depth += GetJobQueueDepth((JobPriority)i);
+
+		return depth;
+	}
+
+	size_t Dispatcher::GetJobQueueDepth(JobPriority ePriority) {
+
+		size_t depth = m_InjectedJobs[(int)ePriority].Size();
+		for (int i = 0; i < m_iWorkerThreadCount; i++)
+			depth += m_pWorkerThreads[i].GetJobQueue(ePriority).Size();
+
+		return depth;
+	}
+
+	void Dispatcher::CompleteJob(Job* pJob) {
+
+		SignalJob(pJob);
+		ReleaseJob(pJob);
+	}
+
+	void Dispatcher::SignalJob(Job* pJob) {
+
+		// Grab the group counter before the job can be recycled
+		JobCounter* pCounter = pJob->GetCounter();
+
+		// Destroy the callable (and anything it captured) now, not whenever the pool hands the job out again
+		pJob->SetEntryPoint(nullptr);
+
+		// Release anyone in WaitForJob(), then anyone waiting on the group
+		pJob->GetCompletion().Decrement();
+		if (pCounter)
+			pCounter->Decrement();
+	}
+
+	bool Dispatcher::RunJob(Job* pJob, Fiber* pThisFiber, bool bGrowPastMax) {
+
+		Job::RunState eState = Job::RunState::Queued;
+		if (pJob->GetRunState().compare_exchange_strong(eState, Job::RunState::Started, std::memory_order_acquire) == false) {
+
+			// WaitForJob() got to it first. If it's still running there, the inline run releases the job when it's done.
+			if (eState == Job::RunState::Inline &&
+				pJob->GetRunState().compare_exchange_strong(eState, Job::RunState::InlinePopped, std::memory_order_acq_rel))
+				return false;
+
+			ReleaseJob(pJob);
+			return false;
+		}
+
+		WorkerStats& stats = GetThreadStats();
+		if (uint64_t iQueuedTime = pJob->GetQueuedTime())
+			stats.CountQueueWait(NowNs() - iQueuedTime);
+
+		if (pJob->IsContinuation()) {
+			RunJobOnThreadStack(pJob);
+			return false;
+		}
+
+		// Grab a new fiber, from this thread's node so the stack is local to where the job starts
+		FiberPool& fiberPool = GetFiberPool(GetThreadNode(), pJob->GetStackClass());
+		Fiber* pJobFiber = fiberPool.Get();
+		if (pJobFiber == nullptr && bGrowPastMax) {
+
+			// The caller is already a job on this thread's stack and can't have another one beneath it. The job may
+			// be what the caller is waiting on, and no fiber may ever come back, so make one.
+			stats.CountFiberPoolOverrun();
+			pJobFiber = fiberPool.GetPastMax();
+		}
+		if (pJobFiber == nullptr) {
+
+			// Every fiber, reserve included, is taken. They may well all be parked on jobs still in the queues, so
+			// waiting for one could wait forever. Run the job here instead. If it waits, WaitForCounter() and the
+			// FiberSync primitives have this thread run other jobs, each on a fiber of its own, until the wait is over.
+			stats.CountFiberPoolExhaustion();
+			RunJobOnThreadStack(pJob);
+			return false;
+		}
+
+		// Start running the fiber
+		HUSTLE_TRACE(JobRun, (uintptr_t)pJob | 1);
+		pJobFiber->Activate(pJob, pThisFiber);
+		HUSTLE_TRACE(JobStop, (uintptr_t)pJob | (pJobFiber->GetState() == Fiber::State::Idle));
+		OnFiberSwitchedOut(pJobFiber);
+
+		return true;
+	}
+
+	void Dispatcher::RunJobOnThreadStack(Job* pJob) {
+
+		// Every job nested here is waiting on the one above it, and each level costs a job's worth of stack
+		assert(t_iThreadStackDepth < MaxThreadStackDepth);
+
+		HUSTLE_TRACE(JobRun, (uintptr_t)pJob | 1);
+		t_iThreadStackDepth++;
+		pJob->GetEntryPoint()(pJob->GetUserData());
+		t_iThreadStackDepth--;
+		HUSTLE_TRACE(JobStop, (uintptr_t)pJob | 1);
+		GetThreadStats().CountJob();
+		CompleteJob(pJob);
+	}
+
+	bool Dispatcher::RunJobInline(Job* pJob) {
+
+		// The job runs on whatever stack the caller is on. A thread's own stack is taken to be big enough for anything.
+		Fiber* pCurrentFiber = Fiber::GetCurrentFiber();
+		if (pCurrentFiber && (int)pJob->GetStackClass() > (int)pCurrentFiber->CurrentJob()->GetStackClass())
+			return false;
+
+		Job::RunState eState = Job::RunState::Queued;
+		if (pJob->GetRunState().compare_exchange_strong(eState, Job::RunState::Inline, std::memory_order_acquire) == false)
+			return false;
+
+		HUSTLE_TRACE(JobRun, (uintptr_t)pJob | 1);
+		pJob->GetEntryPoint()(pJob->GetUserData());
+		HUSTLE_TRACE(JobStop, (uintptr_t)pJob | 1);
+		GetThreadStats().CountJob();
+		SignalJob(pJob);
+
+		// The job is still in a queue. Whichever of us and the worker that pops it finishes last releases it.
+		eState = Job::RunState::Inline;
+		if (pJob->GetRunState().compare_exchange_strong(eState, Job::RunState::InlineDone, std::memory_order_acq_rel) == false)
+			ReleaseJob(pJob);
+
+		return true;
+	}
+
+	Job* Dispatcher::GetNextJob(WorkerThread* pWorkerThread, uint32_t& uRandomState, uint32_t& iDispatchCount) {
+
+		// Normally take the highest priority work available. Periodically start the search at a lower
+		// priority instead so a steady stream of higher priority jobs can't starve it.
+		iDispatchCount++;
+		JobPriority eFirst = JobPriority::High;
+		if (iDispatchCount % LowPriorityInterval == 0)
+			eFirst = JobPriority::Low;
+		else if (iDispatchCount % NormalPriorityInterval == 0)
+			eFirst = JobPriority::Normal;
+
+		Job* pJob = GetNextJob(pWorkerThread, uRandomState, eFirst);
+		if (pJob)
+			return pJob;
+
+		for (int i = 0; i < JobPriorityCount; i++) {
+			if ((JobPriority)i == eFirst)
+				continue;
+
+			pJob = GetNextJob(pWorkerThread, uRandomState, (JobPriority)i);
+			if (pJob)
+				return pJob;
+		}
+
+		return nullptr;
+	}
+
+	Job* Dispatcher::GetNextJob(WorkerThread* pWorkerThread, uint32_t& uRandomState, JobPriority ePriority) {
+
+		// Newest local work first, it's the most likely to be in cache
+		Job* pJob = pWorkerThread ? pWorkerThread->GetJobQueue(ePriority).Pop() : nullptr;
+		if (pJob)
+			return pJob;
+
+		pJob = m_InjectedJobs[(int)ePriority].Pop();
+		if (pJob)
+			return pJob;
+
+		// Nobody else to steal from
+		if (m_iWorkerThreadCount < (pWorkerThread ? 2 : 1))
+			return nullptr;
+
+		// Start at a random victim so thieves don't all pile onto the same worker
+		uRandomState ^= uRandomState << 13;
+		uRandomState ^= uRandomState >> 17;
+		uRandomState ^= uRandomState << 5;
+
+		// Workers on our own node first: whatever the job touches is more likely to be in that node's memory and caches
+		int iNode = pWorkerThread ? pWorkerThread->GetNode() : GetThreadNode();
+		if (m_bNumaAware && m_iNodeCount > 1) {
+
+			const std::vector<int>& nodeWorkers = m_NodeWorkers[iNode];
+			int iCount = (int)nodeWorkers.size();
+			int iVictim = (int)(uRandomState % (uint32_t)iCount);
+			for (int i = 0; i < iCount; i++) {
+
+				int iIndex = nodeWorkers[(iVictim + i) % iCount];
+				WorkerThread* pVictim = &m_pWorkerThreads[iIndex];
+				if (pVictim == pWorkerThread)
+					continue;
+
+				pJob = pVictim->GetJobQueue(ePriority).Steal();
+				if (pJob) {
+					HUSTLE_TRACE(Steal, iIndex);
+					GetThreadStats().CountSteal();
+					return pJob;
+				}
+			}
+		}
+
+		int iVictim = (int)(uRandomState % (uint32_t)m_iWorkerThreadCount);
+		for (int i = 0; i < m_iWorkerThreadCount; i++) {
+
+			int iIndex = (iVictim + i) % m_iWorkerThreadCount;
+			WorkerThread* pVictim = &m_pWorkerThreads[iIndex];
+			if (pVictim == pWorkerThread || (m_bNumaAware && m_iNodeCount > 1 && pVictim->GetNode() == iNode))
+				continue;
+
+			pJob = pVictim->GetJobQueue(ePriority).Steal();
+			if (pJob) {
+				HUSTLE_TRACE(Steal, iIndex);
+				WorkerStats& stats = GetThreadStats();
+				stats.CountSteal();
+				if (pVictim->GetNode() != iNode)
+					stats.CountRemoteSteal();
+				return pJob;
+			}
+		}
+
+		return nullptr;
+	}
 	
-	void Dispatcher::WaitForJob(JobHandle hJob) {
+	void Dispatcher::WaitForJob(JobHandle hJob, bool bRunInline) {
+
+		// The job may be released as soon as the inline run is over, so don't touch it again
+		if (bRunInline && RunJobInline(hJob))
+			return;
+
+		WaitForCounter(&hJob->GetCompletion(), 0);
+	}
+
+	void Dispatcher::WaitForCounter(JobCounter* pCounter, int iTarget) {
+
+		if (pCounter->HasReached(iTarget))
+			return;
+
+		// Inside a job, park the fiber on the counter. The scheduler won't look at it again until the counter wakes it.
+		auto currentFiber = Fiber::GetCurrentFiber();
+		if (currentFiber) {
+			HUSTLE_TRACE(Park, pCounter);
+			currentFiber->WaitForCounter(pCounter, iTarget);
+			return;
+		}
+
+		HUSTLE_TRACE(WaitStart, pCounter);
+
+		struct CounterTarget {
+			JobCounter* pCounter;
+			int iTarget;
+		} target = { pCounter, iTarget };
+
+		WaitUntil([](void* pWaitObject) {
+			CounterTarget* pTarget = (CounterTarget*)pWaitObject;
+			return pTarget->pCounter->HasReached(pTarget->iTarget);
+		}, &target);
+
+		HUSTLE_TRACE(WaitEnd, pCounter);
+	}
+
+	void Dispatcher::WaitUntil(WaitCondition pfnDone, void* pWaitObject) {
+
+		// Outside of the fiber system, lend a hand until the wait is over. Or just yield back to the os.
+		// A worker only gets here running a job on its own stack, and has to help: nothing else runs on it until
+		// the job returns.
+		if (m_bHelpWhileWaiting || t_pCurrentWorker) {
+			HelpUntil(pfnDone, pWaitObject);
+		}
+		else {
+			while (pfnDone(pWaitObject) == false)
+				Platform::ThreadYield();
+		}
+	}
+
+	void Dispatcher::HelpUntil(WaitCondition pfnDone, void* pWaitObject) {
 
-		// Poll on the job until it is done
-		while (hJob->TryLock() != true) {
+		// The thread becomes a fiber the first time it helps, so it can switch to job fibers, and stays one until it exits.
+		// Workers already are one.
+		static thread_local std::unique_ptr<Fiber> t_pHelperFiber;
+		if (t_pThreadFiber == nullptr) {
 
-			// In case this is being called from outside of the fiber system, just yield back to the os
-			auto currentFiber = Fiber::GetCurrentFiber();
-			if (currentFiber) {
-				currentFiber->GetParent()->SwitchTo();
-			} else {
-				Yield();
-			}			
+			void* pFiber = Fiber::ConvertCurrentThread();
+			if (pFiber == nullptr) {
+
+				// Already a fiber that isn't ours (ConvertThreadToFiber() fails then), so there's nothing to switch back to
+				while (pfnDone(pWaitObject) == false)
+					Platform::ThreadYield();
+				return;
+			}
+
+			t_pHelperFiber.reset(new Fiber(pFiber));
+			t_pThreadFiber = t_pHelperFiber.get();
 		}
 
-		// We got the lock, go ahead and unlock it...
-		hJob->Unlock();
+		// Seed for picking steal victims, must be non-zero
+		uint32_t uRandomState = (uint32_t)(uintptr_t)t_pThreadFiber | 1;
+		uint32_t iDispatchCount = 0;
+
+		// Same as a pass of the scheduler. Off a worker there's no deque or ready list of our own, and fibers that
+		// yield or are parked here go to the global ready list. The condition is checked between jobs, so the wait
+		// can run on for as long as the job picked up last takes.
+		WorkerThread* pWorkerThread = t_pCurrentWorker;
+		WorkerStats& stats = GetThreadStats();
+
+		// With the nest on this thread's stack as deep as it goes, a job taken now couldn't run here. Putting it back
+		// would only have this loop take it again, so leave the queues to other threads and wait for woken fibers.
+		bool bTakeJobs = t_iThreadStackDepth < MaxThreadStackDepth;
+		if (bTakeJobs == false)
+			stats.CountThreadStackCap();
+
+		// Waiting in a job that's on this thread's stack already. Another job started beneath it could never get
+		// back to it, so if that one waited on something the first holds (a FiberMutex, say) neither would finish.
+		// Every job started here gets a fiber of its own, growing the pool past its reserve if it has to.
+		bool bNested = t_iThreadStackDepth > 0;
+
+		while (pfnDone(pWaitObject) == false) {
+
+			Fiber* pReadyFiber = pWorkerThread ? pWorkerThread->GetReadyFibers().Pop() : nullptr;
+			if (pReadyFiber == nullptr)
+				pReadyFiber = m_ReadyFibers.Pop();
+
+			if (pReadyFiber) {
+				stats.CountFiberSwitch();
+				HUSTLE_TRACE(JobRun, pReadyFiber->CurrentJob());
+				pReadyFiber->Resume(t_pThreadFiber);
+				HUSTLE_TRACE(JobStop, (uintptr_t)pReadyFiber->CurrentJob() | (pReadyFiber->GetState() == Fiber::State::Idle));
+				OnFiberSwitchedOut(pReadyFiber);
+			}
+			else if (Job* pJob = bTakeJobs ? GetNextJob(pWorkerThread, uRandomState, iDispatchCount) : nullptr) {
+				if (RunJob(pJob, t_pThreadFiber, bNested))
+					stats.CountFiberSwitch();
+			}
+			else {
+				Platform::ThreadYield();
+			}
+		}
 	}
 	
 	void Dispatcher::YieldToScheduler() {
@@ -127,23 +748,154 @@ namespace Hustle {
 			currentFiber->GetParent()->SwitchTo();
 		}
 		else {
-			Yield();
+			Platform::ThreadYield();
+		}
+	}
+
+	void Dispatcher::ReadyFiber(Fiber* pFiber) {
+
+		// The current worker will get to it on its next pass, anywhere else a sleeping worker may need waking
+		if (t_pCurrentWorker) {
+			t_pCurrentWorker->GetReadyFibers().Push(pFiber);
+		}
+		else {
+			m_ReadyFibers.Push(pFiber);
+			WakeWorkers(1);
+		}
+	}
+
+	void Dispatcher::WakeWorkers(int iCount) {
+
+		// Pairs with the fence in Idle(). Either the sleeper sees the new work when it re-checks the queues,
+		// or we see it counted in m_iSleepingWorkers here.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_iSleepingWorkers.load(std::memory_order_relaxed) == 0)
+			return;
+
+		m_iWakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+		Platform::WakeAddress(&m_iWakeEpoch, iCount);
+	}
+
+	void Dispatcher::Idle(WorkerThread* pWorkerThread, uint32_t iIdlePasses) {
+
+		uint64_t iYieldEnd = (uint64_t)m_IdlePolicy.iSpinCount + m_IdlePolicy.iYieldCount;
+
+		if (iIdlePasses < m_IdlePolicy.iSpinCount) {
+			Platform::CpuPause();
+		}
+		else if (iIdlePasses < iYieldEnd || m_IdlePolicy.bSleep == false) {
+			Platform::ThreadYield();
+		}
+		else {
+
+			// Announce that we're going to sleep, then look one last time. Anything submitted after the
+			// look sees us in m_iSleepingWorkers and bumps the epoch, so the wait below returns right away.
+			m_iSleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			uint32_t iEpoch = m_iWakeEpoch.load(std::memory_order_seq_cst);
+
+			if (pWorkerThread->GetState() == WorkerThread::State::Running && HasQueuedWork() == false)
+				Platform::WaitOnAddress(&m_iWakeEpoch, iEpoch);
+
+			m_iSleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
 		}
 	}
 
+	bool Dispatcher::HasQueuedWork() {
+
+		if (m_ReadyFibers.Size() > 0)
+			return true;
+
+		return GetJobQueueDepth() > 0;
+	}
+
+	void Dispatcher::OnFiberSwitchedOut(Fiber* pFiber) {
+
+		switch (pFiber->GetState()) {
+		case Fiber::State::Running:
+			// Yielded, go to the back of the line
+			ReadyFiber(pFiber);
+			break;
+		case Fiber::State::Waiting:
+			// Park on whatever it's waiting for. If the wait ended while we were switching out, run it again.
+			if (pFiber->FinishParking() == false)
+				ReadyFiber(pFiber);
+			break;
+		case Fiber::State::Idle:
+		{
+			// Signal anyone waiting on the job, then put the fiber and job back into their respective free queues.
+			// The fiber goes back to the pool it came from, which its node and the job's stack class picked.
+			FiberPool& fiberPool = GetFiberPool(pFiber->GetNode(), pFiber->CurrentJob()->GetStackClass());
+			GetThreadStats().CountJob();
+			CompleteJob(pFiber->CurrentJob());
+			fiberPool.Release(pFiber);
+			break;
+		}
+		default:
+			assert(false);
+		}
+	}
+
+	bool Dispatcher::DumpTrace(const std::string& path) {
+
+#if defined(HUSTLE_TRACING)
+		if (Trace::Dump(path.c_str()))
+			return true;
+
+		m_LastError = "Couldn't write the trace to " + path;
+		return false;
+#else
+		(void)path;
+		m_LastError = "Tracing is compiled out, configure with HUSTLE_TRACING";
+		return false;
+#endif
+	}
+
+	uint64_t Dispatcher::GetFiberSwitchCount() {
+
+		uint64_t iCount = 0;
+		for (int i = 0; i < m_iWorkerThreadCount; i++)
+			iCount += m_pWorkerThreads[i].GetFiberSwitchCount();
+
+		return iCount;
+	}
+
+	DispatcherStats Dispatcher::GetStats() {
+
+		DispatcherStats stats;
+		for (int i = 0; i < m_iWorkerThreadCount; i++)
+			m_pWorkerThreads[i].GetStats().AddTo(stats);
+		m_HelperStats.AddTo(stats);
+
+		// Summed over the nodes, so it's at least the true peak
+		for (auto& pPools : m_NodePools) {
+			if (pPools == nullptr)
+				continue;
+
+			stats.iJobPoolHighWaterMark += pPools->jobPool.GetHighWaterMark();
+			for (int i = 0; i < StackClassCount; i++)
+				stats.iFiberPoolHighWaterMark[i] += pPools->pFiberPoolForClass[i]->GetHighWaterMark();
+		}
+
+		return stats;
+	}
+
+	WorkerStats& Dispatcher::GetThreadStats() {
+		return t_pCurrentWorker ? t_pCurrentWorker->GetStats() : m_HelperStats;
+	}
+
+	void Dispatcher::StampQueuedTime(Job* pJob) {
+		pJob->SetQueuedTime(t_iQueuedJobs++ % QueueWaitSampleInterval == 0 ? NowNs() : 0);
+	}
+
 	/**
 	 * @brief Entrypoint for each worker thread. 
-	 * @param pData Pointer to a WorkerThread object
-	 * @return - Should always be 0
+	 * @param pWorkerThread The WorkerThread object that started this scheduler
 	*/
-	DWORD WINAPI Dispatcher::Scheduler(LPVOID pData) {
+	void Dispatcher::Scheduler(WorkerThread* pWorkerThread) {
 
 		// Convert the thread to a fiber
-		void* pFiber = ConvertThreadToFiber(nullptr);
-		Fiber* pJobFiber = nullptr;
-
-		// Snag a pointer to the worker thread that started this scheduler
-		WorkerThread* pWorkerThread = (WorkerThread*)pData;
+		void* pFiber = Fiber::ConvertCurrentThread();
 
 		Job* pJob;
 
@@ -151,98 +903,182 @@ namespace Hustle {
 		Fiber thisFiber(pFiber);
 		auto &dispatcher = Dispatcher::GetInstance();
 
-		// Vector for fibers that have yieled back and are still in the running state
+		// Jobs added by fibers running on this thread go to our own deque
+		t_pCurrentWorker = pWorkerThread;
+		t_pThreadFiber = &thisFiber;
+
+		// Claim our pool magazine slot now, registering its thread exit hook allocates
+		ThreadSlot::Get();
+		HUSTLE_TRACE_THREAD_NAME(("Worker " + std::to_string(pWorkerThread - dispatcher.m_pWorkerThreads)).c_str());
+
+		// Seed for picking steal victims, must be non-zero
+		uint32_t uRandomState = (uint32_t)(pWorkerThread - dispatcher.m_pWorkerThreads) * 2654435761u + 1;
+
+		// Number of job searches, for the anti-starvation passes in GetNextJob()
+		uint32_t iDispatchCount = 0;
+
+		// Fibers that yielded or were woken on this worker. Blocked fibers are parked on whatever they're
+		// waiting for and never show up here, so the cost of the loop tracks the amount of runnable work.
 		// NOTE: This does not need to be read/write protected since it will only be used by this thread/fiber
-		std::vector<Fiber*>	pendingFibers;
+		RingBuffer<Fiber*>& readyFibers = pWorkerThread->GetReadyFibers();
 
 		// TODO: Add barrier to not start until all threads are spun up
 
+		// The first worker on a node sets up its pools. It's running on the node already, so that's where they end up.
+		int iWorkerIndex = (int)(pWorkerThread - dispatcher.m_pWorkerThreads);
+		int iNode = pWorkerThread->GetNode();
+		if (dispatcher.m_bNumaAware ? dispatcher.m_NodeWorkers[iNode][0] == iWorkerIndex : iWorkerIndex == 0)
+			dispatcher.CreateNodePools(dispatcher.GetPoolNode(iNode));
+
 		// Set the state to running
 		pWorkerThread->SetState(WorkerThread::State::Running);
 
+		// Empty passes in a row, drives the idle policy's backoff
+		uint32_t iIdlePasses = 0;
+
 		while (pWorkerThread->GetState() == WorkerThread::State::Running) {
 			
 			bool bDidWork = false;
 
-			// Go through the wait queue and process those jobs			
-			if (pendingFibers.size()) {
-				auto fiberIt = pendingFibers.begin();
-				while (fiberIt != pendingFibers.end()) {
+			// Resume everything that was ready at the top of the loop. Fibers that yield again land at the
+			// back of the list and wait for the next pass, so a spinning fiber can't starve new jobs.
+			size_t iReadyCount = readyFibers.Size();
+			for (size_t i = 0; i < iReadyCount; i++) {
+				Fiber* pReadyFiber = readyFibers.Pop();
 
-					bDidWork = true;
+				bDidWork = true;
+				pWorkerThread->CountFiberSwitch();
+				HUSTLE_TRACE(JobRun, pReadyFiber->CurrentJob());
+				pReadyFiber->Resume(&thisFiber);
+				HUSTLE_TRACE(JobStop, (uintptr_t)pReadyFiber->CurrentJob() | (pReadyFiber->GetState() == Fiber::State::Idle));
+				dispatcher.OnFiberSwitchedOut(pReadyFiber);
+			}
 
-					Fiber* pPendingFiber = *fiberIt;
-					pPendingFiber->SwitchTo();
+			// Fibers woken by other threads
+			if (Fiber* pReadyFiber = dispatcher.m_ReadyFibers.Pop()) {
 
-					switch (pPendingFiber->GetState()) {
-					case Fiber::State::Running:
-						// Don't do anything...we'll get to it later
-						fiberIt++;
-						break;
-					case Fiber::State::Idle:
-						// Remove the fiber from the pending list
-						fiberIt = pendingFibers.erase(fiberIt);
+				bDidWork = true;
+				pWorkerThread->CountFiberSwitch();
+				HUSTLE_TRACE(JobRun, pReadyFiber->CurrentJob());
+				pReadyFiber->Resume(&thisFiber);
+				HUSTLE_TRACE(JobStop, (uintptr_t)pReadyFiber->CurrentJob() | (pReadyFiber->GetState() == Fiber::State::Idle));
+				dispatcher.OnFiberSwitchedOut(pReadyFiber);
+			}
 
-						// Free the job's spinlock, in case there is a pending job on the wait queue
-						pPendingFiber->CurrentJob()->Unlock();
+			if ((pJob = dispatcher.GetNextJob(pWorkerThread, uRandomState, iDispatchCount))) {
 
-						// Put the fiber and job back into their respective free queues
-						dispatcher.m_FiberPool.Release(pPendingFiber);
-						dispatcher.m_JobPool.Release(pPendingFiber->CurrentJob());
-					}
-				}
+				bDidWork = true;
+				if (dispatcher.RunJob(pJob, &thisFiber))
+					pWorkerThread->CountFiberSwitch();
 			}
-			
-			if (pJob = dispatcher.m_Jobs.Pop()) {
 
-				bDidWork = true;
-				// Grab a new fiber
-				// TODO: Handle the case where there are no more fibers and every worker is waiting for one...
-				pJobFiber = nullptr;
-				do {
+			// We didn't do anything, take a breather. The longer there's nothing to do, the longer the breather.
+			if (bDidWork) {
+				if (iIdlePasses > 0)
+					HUSTLE_TRACE(IdleEnd, 0);
+				iIdlePasses = 0;
+			}
+			else {
+				if (iIdlePasses == 0)
+					HUSTLE_TRACE(IdleStart, 0);
+				dispatcher.Idle(pWorkerThread, iIdlePasses++);
+			}
+		}
 
-					pJobFiber = dispatcher.m_FiberPool.Get();
-				} while (pJobFiber == nullptr);
+		if (iIdlePasses > 0)
+			HUSTLE_TRACE(IdleEnd, 0);
 
-				// Start running the fiber
-				pJobFiber->Activate(pJob, &thisFiber);
+		t_pCurrentWorker = nullptr;
+		t_pThreadFiber = nullptr;
 
-				switch (pJobFiber->GetState()) {
+		// Set the current state to done so callers know we're...done. 
+		pWorkerThread->SetState(WorkerThread::State::Done);
+	}
 
-				case Fiber::State::Running:
-					// Toss the job onto the pending queue
-					pendingFibers.push_back(pJobFiber);
-					break;
-				case Fiber::State::Idle:
+	size_t Dispatcher::GetFreeJobCount() {
 
-					// Free the job's spinlock, in case there is a pending job on the wait queue
-					pJobFiber->CurrentJob()->Unlock();
+		size_t iFree = 0;
+		for (auto& pPools : m_NodePools) {
+			if (pPools)
+				iFree += pPools->jobPool.GetFreeCount();
+		}
 
-					// Put the fiber and job back into their respective free queues
-					dispatcher.m_FiberPool.Release(pJobFiber);
-					dispatcher.m_JobPool.Release(pJob);
-					break;
-				}
-			}
+		return iFree;
+	}
+
+	size_t Dispatcher::GetFreeJobTotal() {
 
-			// We didn't do anything, take a breather
-			if (bDidWork == false)
-				_mm_pause();
+		size_t iTotal = 0;
+		for (auto& pPools : m_NodePools) {
+			if (pPools)
+				iTotal += pPools->jobPool.GetTotalCount();
 		}
 
-		// Set the current state to done so callers know we're...done. 
-		pWorkerThread->SetState(WorkerThread::State::Done);
+		return iTotal;
+	}
 
-		return 0;
+	size_t Dispatcher::GetFiberPoolTotal() {
+
+		size_t iTotal = 0;
+		for (auto& pPools : m_NodePools) {
+			if (pPools == nullptr)
+				continue;
+
+			for (auto& pool : pPools->fiberPools)
+				iTotal += pool.GetTotalCount();
+		}
+
+		return iTotal;
+	}
+
+	size_t Dispatcher::GetFiberPoolFree() {
+
+		size_t iFree = 0;
+		for (auto& pPools : m_NodePools) {
+			if (pPools == nullptr)
+				continue;
+
+			for (auto& pool : pPools->fiberPools)
+				iFree += pool.GetFreeCount();
+		}
+
+		return iFree;
+	}
+
+	size_t Dispatcher::GetFiberPoolTotal(StackClass eStackClass) {
+
+		size_t iTotal = 0;
+		for (auto& pPools : m_NodePools) {
+			if (pPools)
+				iTotal += pPools->pFiberPoolForClass[(int)eStackClass]->GetTotalCount();
+		}
+
+		return iTotal;
+	}
+
+	size_t Dispatcher::GetFiberPoolFree(StackClass eStackClass) {
+
+		size_t iFree = 0;
+		for (auto& pPools : m_NodePools) {
+			if (pPools)
+				iFree += pPools->pFiberPoolForClass[(int)eStackClass]->GetFreeCount();
+		}
+
+		return iFree;
 	}
 
 	/**
 	 * @brief Default constructor, hidden behind the singleton pattern.
 	*/
 	Dispatcher::Dispatcher() :
-		m_RunningThreads(0),
 		m_iWorkerThreadCount(0),
-		m_pWorkerThreads(nullptr) {
-
+		m_pWorkerThreads(nullptr),
+		m_RunningThreads(0),
+		m_iNodeCount(0),
+		m_bNumaAware(true),
+		m_bHelpWhileWaiting(true),
+		m_HelperStats(true),
+		m_iWakeEpoch(0),
+		m_iSleepingWorkers(0) {
 	}
 }
\ No newline at end of file
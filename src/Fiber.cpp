@@ -1,47 +1,79 @@
 #include "hustle/Fiber.h"
 #include "hustle/Job.h"
 #include "hustle/Dispatcher.h"
+#include "FiberContext.h"
 
+#include <assert.h>
 #include <iostream>
-#include <Windows.h>
 
 namespace Hustle {
 
-	
+	// The job fiber running on this thread, nullptr while the thread runs its own (scheduler) fiber
+	static thread_local Fiber* t_pCurrentFiber = nullptr;
+
 	Fiber::Fiber() :
-		m_pJob(nullptr),
+		Fiber(DefaultStackSize) {
+	}
+
+	Fiber::Fiber(size_t stackSize) :
+		m_eState(State::None),
 		m_hFiber(nullptr),
 		m_pParent(nullptr),
-		m_eState(State::None) {
-
-		// TODO: Allow the stack size to be configured
-		m_hFiber = CreateFiber(0, Run, this);
-
-		// Add to the static fiber map
-		s_FiberMap[m_hFiber] = this;
+		m_pJob(nullptr),
+		m_pfnPark(nullptr),
+		m_pWaitObject(nullptr),
+		m_iWaitTarget(0),
+		m_pNextWaiter(nullptr),
+		m_bThreadFiber(false),
+		m_iNode(0) {
+
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+		// Reserve stackSize, commit on demand. Windows guards fiber stacks itself.
+		m_hFiber = CreateFiberEx(0, stackSize, FIBER_FLAG_FLOAT_SWITCH, Run, this);
+#else
+		m_hFiber = Context::Create(stackSize, Run, this);
+#endif
+		assert(m_hFiber != nullptr);
 	}
 
 	Fiber::Fiber(const Fiber& fiber) :
 		m_eState(fiber.m_eState),
-		m_pJob(fiber.m_pJob),
+		m_hFiber(fiber.m_hFiber),
 		m_pParent(fiber.m_pParent),
-		m_hFiber(fiber.m_hFiber) {
-
-		// Remove from the static fiber map
-		s_FiberMap.erase(m_hFiber);
-		
+		m_pJob(fiber.m_pJob),
+		m_pfnPark(fiber.m_pfnPark),
+		m_pWaitObject(fiber.m_pWaitObject),
+		m_iWaitTarget(fiber.m_iWaitTarget),
+		m_pNextWaiter(nullptr),
+		m_bThreadFiber(fiber.m_bThreadFiber),
+		m_iNode(fiber.m_iNode) {
 	}
 
 	Fiber::Fiber(void* pFiberHandle) :
 		m_eState(State::None),
-		m_pJob(nullptr),
+		m_hFiber(pFiberHandle),
 		m_pParent(nullptr),
-		m_hFiber(pFiberHandle) {
+		m_pJob(nullptr),
+		m_pfnPark(nullptr),
+		m_pWaitObject(nullptr),
+		m_iWaitTarget(0),
+		m_pNextWaiter(nullptr),
+		m_bThreadFiber(true),
+		m_iNode(0) {
 	}
 
 	Fiber::~Fiber() {
-		if (m_hFiber)
-			DeleteFiber(m_hFiber);
+		if (m_hFiber) {
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+			// Deleting the running fiber would end the thread, a converted thread just goes back to being a thread
+			if (m_bThreadFiber)
+				ConvertFiberToThread();
+			else
+				DeleteFiber(m_hFiber);
+#else
+			Context::Destroy((Context::FiberContext*)m_hFiber);
+#endif
+		}
 	}
 	
 	
@@ -54,26 +86,64 @@ namespace Hustle {
 		m_pJob = pJob;
 
 		// Enable the fiber
-		SwitchToFiber(m_hFiber);
+		SwitchTo();
 	}
 
-	Fiber* Fiber::GetCurrentFiber() {
+	void Fiber::Resume(Fiber* pParent) {
 
-		// OS handle of the current fiber
-		void* pCurrentFiber = ::GetCurrentFiber();
+		// Parked fibers can be woken by any worker, so always return to whoever resumed us
+		m_pParent = pParent;
+		m_eState = State::Running;
+		m_pWaitObject = nullptr;
+
+		SwitchTo();
+	}
+
+	void Fiber::Park(ParkFunction pfnPark, void* pWaitObject, int iWaitTarget) {
+
+		// The scheduler parks us once we've switched out. Doing it from here would let
+		// another worker resume this fiber before it had finished switching away.
+		m_pfnPark = pfnPark;
+		m_pWaitObject = pWaitObject;
+		m_iWaitTarget = iWaitTarget;
+		m_eState = State::Waiting;
+
+		m_pParent->SwitchTo();
+	}
+
+	void Fiber::WaitForCounter(JobCounter* pCounter, int iTarget) {
+		Park([](void* pWaitObject, Fiber* pFiber, int iWaitTarget) { return ((JobCounter*)pWaitObject)->AddWaiter(pFiber, iWaitTarget); },
+			 pCounter, iTarget);
+	}
+
+	void Fiber::SwitchTo() {
 
-		// Reach into the global map of Fiber objects, searching by the OS handle
-		auto fiberIt = s_FiberMap.find(pCurrentFiber);
-		if (fiberIt == s_FiberMap.end())
-			return nullptr;
-		else
-			return fiberIt->second;
+		// Set before leaving: whatever runs next on this thread, job or scheduler, reads it straight away.
+		// Nothing after the switch may use it, since this fiber may come back on a different thread.
+		t_pCurrentFiber = m_bThreadFiber ? nullptr : this;
+
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+		::SwitchToFiber(m_hFiber);
+#else
+		Context::SwitchTo((Context::FiberContext*)m_hFiber);
+#endif
+	}
 
+	void* Fiber::ConvertCurrentThread() {
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+		return ::ConvertThreadToFiber(nullptr);
+#else
+		return Context::ConvertThread();
+#endif
 	}
 
-	void __stdcall Fiber::Run(void* pData) {
+	Fiber* Fiber::GetCurrentFiber() {
+
+		// Kept out of line, so callers re-read the thread local after a switch rather than reusing its address
+		return t_pCurrentFiber;
+	}
 
-		JobEntryPoint fn;
+	void HUSTLE_FIBER_CALL Fiber::Run(void* pData) {
 
 		Fiber* pThis = (Fiber*)pData;
 
@@ -83,21 +153,18 @@ namespace Hustle {
 			// Set our state to running
 			pThis->m_eState = State::Running;
 
-			// Execute the entrypoint
-			fn = pThis->m_pJob->GetEntryPoint();
-			fn(pThis->m_pJob->GetUserData());
+			// Execute the entrypoint in place, it lives in the Job until the job is released
+			pThis->m_pJob->GetEntryPoint()(pThis->m_pJob->GetUserData());
 
 			// The entrypoint has completed. Setting our state to IDLE so that the scheduler
 			// knows to put the fiber back onto the available pool
 			pThis->m_eState = State::Idle;
 
 			// Switch back to the scheduler
-			SwitchToFiber(pThis->m_pParent->m_hFiber);
+			pThis->m_pParent->SwitchTo();
 		}
 
 		// We should never get here
 		assert(false);
 	}
-
-	std::map<void*, Fiber*>	Fiber::s_FiberMap;
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "FiberContext.h"
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+
+#include <assert.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(HUSTLE_FIBER_UCONTEXT)
+
+/**********************************************************************
+* x86-64 System V context switch.
+*
+* hustle_context_switch(void** ppFromStackPointer, void* pToStackPointer)
+*   Pushes the callee saved registers plus the MXCSR and x87 control words
+*   onto the current stack, stores the stack pointer in *ppFromStackPointer,
+*   then loads pToStackPointer and pops the same frame back off.
+*
+* hustle_context_trampoline
+*   First "return address" of a freshly created context. Create() seeds
+*   r12 with the user data and r13 with the entry point.
+**********************************************************************/
+asm(R"(
+	.text
+	.globl hustle_context_switch
+	.type hustle_context_switch,@function
+	.align 16
+hustle_context_switch:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size hustle_context_switch,.-hustle_context_switch
+
+	.globl hustle_context_trampoline
+	.type hustle_context_trampoline,@function
+	.align 16
+hustle_context_trampoline:
+	movq %r12, %rdi
+	callq *%r13
+	ud2
+	.size hustle_context_trampoline,.-hustle_context_trampoline
+)");
+
+extern "C" void hustle_context_switch(void** ppFromStackPointer, void* pToStackPointer);
+extern "C" void hustle_context_trampoline();
+
+#endif
+
+namespace Hustle {
+	namespace Context {
+
+		// Context currently executing on this thread. Equivalent of the Win32 GetCurrentFiber()
+		static thread_local FiberContext* t_pCurrentContext = nullptr;
+
+#if defined(HUSTLE_FIBER_UCONTEXT)
+		struct UContextStart {
+			EntryPoint entryPoint;
+			void* pData;
+		};
+
+		// makecontext() only passes int arguments, so the pointer is split in two
+		static void UContextTrampoline(unsigned int uHigh, unsigned int uLow) {
+			auto pStart = (UContextStart*)(((uintptr_t)uHigh << 32) | (uintptr_t)uLow);
+			EntryPoint entryPoint = pStart->entryPoint;
+			void* pData = pStart->pData;
+			delete pStart;
+
+			entryPoint(pData);
+
+			// Entry points must never return
+			assert(false);
+		}
+#endif
+
+		FiberContext* Create(size_t stackSize, EntryPoint entryPoint, void* pData) {
+
+			size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+			stackSize = (stackSize + pageSize - 1) & ~(pageSize - 1);
+
+			// Reserve the stack lazily, pages are only backed once they are touched. One extra page
+			// below the stack is left inaccessible, so an overflow faults instead of corrupting memory.
+			size_t mappingSize = stackSize + pageSize;
+			void* pMapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+								MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+			if (pMapping == MAP_FAILED)
+				return nullptr;
+
+			if (mprotect(pMapping, pageSize, PROT_NONE) != 0) {
+				munmap(pMapping, mappingSize);
+				return nullptr;
+			}
+
+			void* pStack = (char*)pMapping + pageSize;
+
+			FiberContext* pContext = new FiberContext();
+			pContext->pStack = pMapping;
+			pContext->stackSize = mappingSize;
+
+#if defined(HUSTLE_FIBER_UCONTEXT)
+			getcontext(&pContext->context);
+			pContext->context.uc_stack.ss_sp = pStack;
+			pContext->context.uc_stack.ss_size = stackSize;
+			pContext->context.uc_link = nullptr;
+
+			auto pStart = new UContextStart{ entryPoint, pData };
+			uintptr_t uStart = (uintptr_t)pStart;
+			makecontext(&pContext->context, (void (*)())UContextTrampoline, 2,
+						(unsigned int)(uStart >> 32), (unsigned int)(uStart & 0xffffffff));
+			pContext->pStackPointer = nullptr;
+#else
+			// Build the frame hustle_context_switch() expects to pop. The trampoline
+			// is entered with a 16 byte aligned stack, as the ABI requires before a call.
+			uintptr_t* pTop = (uintptr_t*)((uintptr_t)pStack + stackSize);
+			uintptr_t* pFrame = pTop - 8;
+			pFrame[0] = 0x037F00001F80ull;					// x87 control word : MXCSR defaults
+			pFrame[1] = 0;									// r15
+			pFrame[2] = 0;									// r14
+			pFrame[3] = (uintptr_t)entryPoint;				// r13
+			pFrame[4] = (uintptr_t)pData;					// r12
+			pFrame[5] = 0;									// rbx
+			pFrame[6] = 0;									// rbp
+			pFrame[7] = (uintptr_t)hustle_context_trampoline;	// return address
+			pContext->pStackPointer = pFrame;
+#endif
+
+			return pContext;
+		}
+
+		FiberContext* ConvertThread() {
+
+			// Threads already have a stack, the context only needs somewhere to save state
+			FiberContext* pContext = new FiberContext();
+			pContext->pStack = nullptr;
+			pContext->stackSize = 0;
+			pContext->pStackPointer = nullptr;
+
+			t_pCurrentContext = pContext;
+			return pContext;
+		}
+
+		void Destroy(FiberContext* pContext) {
+
+			if (pContext == nullptr)
+				return;
+
+			// A converted thread may release its own context, fibers with a stack can't
+			assert(pContext->pStack == nullptr || pContext != t_pCurrentContext);
+
+			if (pContext->pStack)
+				munmap(pContext->pStack, pContext->stackSize);
+
+			if (t_pCurrentContext == pContext)
+				t_pCurrentContext = nullptr;
+
+			delete pContext;
+		}
+
+		void SwitchTo(FiberContext* pTo) {
+
+			FiberContext* pFrom = t_pCurrentContext;
+			assert(pFrom != nullptr);
+
+			// Update the thread's current context before leaving. Nothing below the
+			// switch touches thread local storage, as we may resume on another thread.
+			t_pCurrentContext = pTo;
+
+#if defined(HUSTLE_FIBER_UCONTEXT)
+			swapcontext(&pFrom->context, &pTo->context);
+#else
+			hustle_context_switch(&pFrom->pStackPointer, pTo->pStackPointer);
+#endif
+		}
+
+		FiberContext* GetCurrent() {
+			return t_pCurrentContext;
+		}
+
+		const char* BackendName() {
+#if defined(HUSTLE_FIBER_UCONTEXT)
+			return "ucontext";
+#else
+			return "x86-64 assembly";
+#endif
+		}
+	}
+}
+
+#endif
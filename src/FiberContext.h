@@ -0,0 +1,79 @@
+#pragma once
+/**********************************************************************
+* POSIX execution contexts used to back the Fiber class on non-Windows
+* platforms. On x86-64 the switch is a hand written register save/restore
+* (callee saved registers, MXCSR/x87 control word and the stack pointer).
+* Everything else, or builds with HUSTLE_FIBER_UCONTEXT defined, falls
+* back to getcontext()/swapcontext().
+*
+* See https://graphitemaster.github.io/fibers/ for the background.
+**********************************************************************/
+
+#include "hustle/Platform.h"
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+
+#include <stddef.h>
+
+#if !defined(__x86_64__) && !defined(HUSTLE_FIBER_UCONTEXT)
+	#define HUSTLE_FIBER_UCONTEXT 1
+#endif
+
+#if defined(HUSTLE_FIBER_UCONTEXT)
+	#include <ucontext.h>
+#endif
+
+namespace Hustle {
+	namespace Context {
+
+		typedef void (*EntryPoint)(void* pData);
+
+		struct FiberContext {
+			void* pStackPointer;	// Saved stack pointer while switched out (assembly backend)
+			void* pStack;			// Base of the mmap()'d stack (its guard page), nullptr for converted threads
+			size_t stackSize;		// Size of the mapping at pStack, guard page included
+#if defined(HUSTLE_FIBER_UCONTEXT)
+			ucontext_t context;
+#endif
+		};
+
+		/**
+		 * @brief Create a new context with its own stack. The entry point runs on the first switch into it and must never return.
+		 * The stack has an inaccessible guard page below it, so overflowing it faults.
+		 * @param stackSize - Usable size of the stack, in bytes. Rounded up to the page size.
+		 * @param entryPoint - Function to run on the new stack
+		 * @param pData - Argument passed to the entry point
+		 * @return The new context, or nullptr if the stack could not be mapped
+		*/
+		FiberContext* Create(size_t stackSize, EntryPoint entryPoint, void* pData);
+
+		/**
+		 * @brief Create a context for the calling thread so it can switch into (and be switched back to from) other contexts.
+		 * @return The context representing the running thread
+		*/
+		FiberContext* ConvertThread();
+
+		/**
+		 * @brief Release a context and unmap its stack. A context with its own stack must not be the running context.
+		*/
+		void Destroy(FiberContext* pContext);
+
+		/**
+		 * @brief Save the running context and resume pTo. Returns when something switches back.
+		 * @param pTo - Context to resume
+		*/
+		void SwitchTo(FiberContext* pTo);
+
+		/**
+		 * @brief The context running on the calling thread, or nullptr if the thread was never converted.
+		*/
+		FiberContext* GetCurrent();
+
+		/**
+		 * @brief Name of the compiled in backend, for diagnostics and benchmarks.
+		*/
+		const char* BackendName();
+	}
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include "hustle/FiberSync.h"
+#include "hustle/Dispatcher.h"
+#include "hustle/Fiber.h"
+
+namespace Hustle {
+
+	void FiberWaitList::PushBack(Fiber* pFiber) {
+
+		pFiber->m_pNextWaiter = nullptr;
+		if (m_pTail)
+			m_pTail->m_pNextWaiter = pFiber;
+		else
+			m_pHead = pFiber;
+
+		m_pTail = pFiber;
+	}
+
+	Fiber* FiberWaitList::PopFront() {
+
+		Fiber* pFiber = m_pHead;
+		if (pFiber == nullptr)
+			return nullptr;
+
+		m_pHead = pFiber->m_pNextWaiter;
+		if (m_pHead == nullptr)
+			m_pTail = nullptr;
+
+		pFiber->m_pNextWaiter = nullptr;
+		return pFiber;
+	}
+
+	void FiberSemaphore::Acquire() {
+
+		if (TryAcquire())
+			return;
+
+		// Inside a job, park until Release() hands us a unit
+		auto currentFiber = Fiber::GetCurrentFiber();
+		if (currentFiber) {
+			currentFiber->Park(&FiberSemaphore::Park, this, 0);
+			return;
+		}
+
+		// Outside of the fiber system, including a job running on a worker's own stack, help out until a unit comes back
+		Dispatcher::GetInstance().WaitUntil([](void* pWaitObject) {
+			return ((FiberSemaphore*)pWaitObject)->TryAcquire();
+		}, this);
+	}
+
+	bool FiberSemaphore::Park(void* pWaitObject, Fiber* pFiber, int iWaitTarget) {
+
+		// Units are counted by the semaphore itself, there is no target to wait for
+		(void)iWaitTarget;
+
+		FiberSemaphore* pThis = (FiberSemaphore*)pWaitObject;
+
+		pThis->m_WaitLock.Lock();
+
+		// Pairs with the fence in Release(). Either it sees us counted here, or we see the unit it gave back.
+		pThis->m_iWaiterCount.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// A unit came back while we were switching out, resume right away
+		if (pThis->TryAcquire()) {
+			pThis->m_iWaiterCount.fetch_sub(1, std::memory_order_relaxed);
+			pThis->m_WaitLock.Unlock();
+			return false;
+		}
+
+		pThis->m_Waiters.PushBack(pFiber);
+		pThis->m_WaitLock.Unlock();
+		return true;
+	}
+
+	void FiberSemaphore::Release(int iCount) {
+
+		m_iCount.fetch_add(iCount, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// Uncontended, nobody to wake
+		if (m_iWaiterCount.load(std::memory_order_seq_cst) == 0)
+			return;
+
+		// Take a unit on behalf of each fiber we wake. Another thread may have beaten us to some of them,
+		// in which case those fibers stay parked until the units come back.
+		FiberWaitList ready;
+		m_WaitLock.Lock();
+		while (m_Waiters.Empty() == false && TryAcquire()) {
+			ready.PushBack(m_Waiters.PopFront());
+			m_iWaiterCount.fetch_sub(1, std::memory_order_relaxed);
+		}
+		m_WaitLock.Unlock();
+
+		while (Fiber* pFiber = ready.PopFront())
+			Dispatcher::GetInstance().ReadyFiber(pFiber);
+	}
+
+	void FiberEvent::Set() {
+
+		FiberWaitList ready;
+
+		m_WaitLock.Lock();
+		m_bSet.store(true, std::memory_order_release);
+		while (Fiber* pFiber = m_Waiters.PopFront())
+			ready.PushBack(pFiber);
+		m_WaitLock.Unlock();
+
+		// Unlock() was our last touch of the event, the woken fibers are free to destroy it
+		while (Fiber* pFiber = ready.PopFront())
+			Dispatcher::GetInstance().ReadyFiber(pFiber);
+	}
+
+	void FiberEvent::Wait() {
+
+		if (IsSet() == false) {
+
+			// Inside a job, park until Set()
+			auto currentFiber = Fiber::GetCurrentFiber();
+			if (currentFiber) {
+				currentFiber->Park(&FiberEvent::Park, this, 0);
+				return;
+			}
+
+			// Outside of the fiber system, including a job running on a worker's own stack, help out until Set()
+			Dispatcher::GetInstance().WaitUntil([](void* pWaitObject) {
+				return ((FiberEvent*)pWaitObject)->IsSet();
+			}, this);
+		}
+
+		// A Set() may still hold the event. Wait for it to let go, since the caller is free to destroy the event.
+		m_WaitLock.Lock();
+		m_WaitLock.Unlock();
+	}
+
+	bool FiberEvent::Park(void* pWaitObject, Fiber* pFiber, int iWaitTarget) {
+
+		// Events are only ever set or not, there is no target to wait for
+		(void)iWaitTarget;
+
+		FiberEvent* pThis = (FiberEvent*)pWaitObject;
+
+		pThis->m_WaitLock.Lock();
+
+		// Set while we were switching out, resume right away
+		if (pThis->m_bSet.load(std::memory_order_acquire)) {
+			pThis->m_WaitLock.Unlock();
+			return false;
+		}
+
+		pThis->m_Waiters.PushBack(pFiber);
+		pThis->m_WaitLock.Unlock();
+		return true;
+	}
+}
@@ -0,0 +1,143 @@
+#include "hustle/JobCounter.h"
+#include "hustle/Dispatcher.h"
+#include "hustle/Fiber.h"
+
+namespace Hustle {
+
+	int JobCounter::Decrement(int iCount) {
+
+		// Nothing waiting, so nothing to walk. The exchange is our last touch of the counter. It fails if AddWaiter()
+		// sets the flag first, and then we go the slow way.
+		int iState = m_iState.load(std::memory_order_relaxed);
+		while ((iState & WaitersFlag) == 0) {
+			if (m_iState.compare_exchange_weak(iState, iState - iCount * ValueStep, std::memory_order_acq_rel, std::memory_order_relaxed))
+				return ValueOf(iState) - iCount;
+		}
+
+		Fiber* pReady = nullptr;
+		Waiter* pWoken = nullptr;
+
+		// The decrement happens under the wait lock so a waiter can't see the final value, return, and
+		// destroy the counter while we're still walking the list. Unlock() is our last touch of the counter.
+		m_WaitLock.Lock();
+		int iValue = ValueOf(m_iState.fetch_sub(iCount * ValueStep, std::memory_order_acq_rel)) - iCount;
+
+		Fiber** ppLink = &m_pWaiters;
+		while (*ppLink) {
+			Fiber* pFiber = *ppLink;
+			if (iValue <= pFiber->m_iWaitTarget) {
+				*ppLink = pFiber->m_pNextWaiter;
+				pFiber->m_pNextWaiter = pReady;
+				pReady = pFiber;
+			}
+			else {
+				ppLink = &pFiber->m_pNextWaiter;
+			}
+		}
+
+		Waiter** ppWaiterLink = &m_pOtherWaiters;
+		while (*ppWaiterLink) {
+			Waiter* pWaiter = *ppWaiterLink;
+			if (iValue <= pWaiter->iTarget) {
+				*ppWaiterLink = pWaiter->pNext;
+				pWaiter->pNext = pWoken;
+				pWoken = pWaiter;
+			}
+			else {
+				ppWaiterLink = &pWaiter->pNext;
+			}
+		}
+		UpdateWaitersFlag();
+		m_WaitLock.Unlock();
+
+		// Hand the woken fibers back to the scheduler
+		while (pReady) {
+			Fiber* pFiber = pReady;
+			pReady = pFiber->m_pNextWaiter;
+			pFiber->m_pNextWaiter = nullptr;
+			Dispatcher::GetInstance().ReadyFiber(pFiber);
+		}
+
+		// The waiter may be gone as soon as it's woken, read the link first
+		while (pWoken) {
+			Waiter* pWaiter = pWoken;
+			pWoken = pWaiter->pNext;
+			pWaiter->pfnWake(pWaiter);
+		}
+
+		return iValue;
+	}
+
+	bool JobCounter::HasReached(int iTarget) {
+
+		if (GetValue() > iTarget)
+			return false;
+
+		// A Decrement() may still hold the counter. Wait for it to let go, since the caller is free to destroy the counter.
+		m_WaitLock.Lock();
+		m_WaitLock.Unlock();
+		return true;
+	}
+
+	bool JobCounter::AddWaiter(Fiber* pFiber, int iTarget) {
+
+		m_WaitLock.Lock();
+
+		// From here on every Decrement() takes the lock, so either we see its value now or it sees us on the list
+		int iValue = ValueOf(m_iState.fetch_or(WaitersFlag, std::memory_order_acq_rel));
+
+		// Reached while the fiber was switching out, resume it right away
+		if (iValue <= iTarget) {
+			UpdateWaitersFlag();
+			m_WaitLock.Unlock();
+			return false;
+		}
+
+		pFiber->m_pNextWaiter = m_pWaiters;
+		m_pWaiters = pFiber;
+
+		m_WaitLock.Unlock();
+		return true;
+	}
+
+	bool JobCounter::AddWaiter(Waiter* pWaiter) {
+
+		m_WaitLock.Lock();
+
+		int iValue = ValueOf(m_iState.fetch_or(WaitersFlag, std::memory_order_acq_rel));
+		if (iValue <= pWaiter->iTarget) {
+			UpdateWaitersFlag();
+			m_WaitLock.Unlock();
+			return false;
+		}
+
+		pWaiter->pNext = m_pOtherWaiters;
+		m_pOtherWaiters = pWaiter;
+
+		m_WaitLock.Unlock();
+		return true;
+	}
+
+	bool JobCounter::RemoveWaiter(Waiter* pWaiter) {
+
+		m_WaitLock.Lock();
+
+		for (Waiter** ppLink = &m_pOtherWaiters; *ppLink; ppLink = &(*ppLink)->pNext) {
+			if (*ppLink == pWaiter) {
+				*ppLink = pWaiter->pNext;
+				UpdateWaitersFlag();
+				m_WaitLock.Unlock();
+				return true;
+			}
+		}
+
+		m_WaitLock.Unlock();
+		return false;
+	}
+
+	void JobCounter::UpdateWaitersFlag() {
+
+		if (m_pWaiters == nullptr && m_pOtherWaiters == nullptr)
+			m_iState.fetch_and(~WaitersFlag, std::memory_order_relaxed);
+	}
+}
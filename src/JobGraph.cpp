@@ -0,0 +1,79 @@
+#include "hustle/JobGraph.h"
+
+namespace Hustle {
+
+	bool JobGraph::IsAcyclic() {
+
+		Prepare();
+		return m_bAcyclic;
+	}
+
+	void JobGraph::Prepare() {
+
+		if (m_bPrepared)
+			return;
+
+		for (auto& node : m_Nodes) {
+			node.iSuccessorCount = 0;
+			node.iPredecessorCount = 0;
+		}
+
+		for (auto& edge : m_Edges) {
+			m_Nodes[edge.first].iSuccessorCount++;
+			m_Nodes[edge.second].iPredecessorCount++;
+		}
+
+		// Lay the successor lists out back to back, in the order the edges were added
+		int iOffset = 0;
+		for (auto& node : m_Nodes) {
+			node.iFirstSuccessor = iOffset;
+			iOffset += node.iSuccessorCount;
+			node.iSuccessorCount = 0;
+		}
+
+		m_Successors.resize(m_Edges.size());
+		for (auto& edge : m_Edges) {
+			Node& node = m_Nodes[edge.first];
+			m_Successors[node.iFirstSuccessor + node.iSuccessorCount++] = edge.second;
+		}
+
+		m_Roots.clear();
+		for (size_t i = 0; i < m_Nodes.size(); i++) {
+			if (m_Nodes[i].iPredecessorCount == 0)
+				m_Roots.push_back((NodeId)i);
+		}
+
+		m_pPending.reset(new PendingCount[m_Nodes.size()]);
+
+		// Kahn's algorithm: repeatedly remove nodes with nothing left in front of them. If that doesn't
+		// get to every node, the rest are on (or behind) a cycle.
+		std::vector<int> predecessors(m_Nodes.size());
+		for (size_t i = 0; i < m_Nodes.size(); i++)
+			predecessors[i] = m_Nodes[i].iPredecessorCount;
+
+		std::vector<NodeId> ready = m_Roots;
+		size_t iVisited = 0;
+
+		while (ready.empty() == false) {
+			NodeId node = ready.back();
+			ready.pop_back();
+			iVisited++;
+
+			const Node& visited = m_Nodes[node];
+			for (int i = 0; i < visited.iSuccessorCount; i++) {
+				NodeId successor = m_Successors[visited.iFirstSuccessor + i];
+				if (--predecessors[successor] == 0)
+					ready.push_back(successor);
+			}
+		}
+
+		m_bAcyclic = iVisited == m_Nodes.size();
+		m_bPrepared = true;
+	}
+
+	void JobGraph::Reset() {
+
+		for (size_t i = 0; i < m_Nodes.size(); i++)
+			m_pPending[i].iValue.store(m_Nodes[i].iPredecessorCount, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,52 @@
+#include "hustle/ThreadSlot.h"
+
+#include <assert.h>
+#include <atomic>
+
+namespace Hustle {
+	namespace ThreadSlot {
+
+		static std::atomic<bool> s_SlotInUse[MaxSlots];
+
+		// -2 until the thread first asks, -1 if it couldn't get a slot (or has exited)
+		static thread_local int t_iSlot = -2;
+
+		// Gives the slot back when the thread exits
+		struct SlotReleaser {
+			bool bRegistered = false;
+
+			~SlotReleaser() {
+				if (t_iSlot >= 0)
+					s_SlotInUse[t_iSlot].store(false, std::memory_order_release);
+
+				t_iSlot = -1;
+			}
+		};
+
+		static thread_local SlotReleaser t_Releaser;
+
+		int Get() {
+
+			if (t_iSlot != -2)
+				return t_iSlot;
+
+			t_iSlot = -1;
+			for (int i = 0; i < MaxSlots; i++) {
+				bool bExpected = false;
+				if (s_SlotInUse[i].load(std::memory_order_relaxed) == false &&
+					s_SlotInUse[i].compare_exchange_strong(bExpected, true, std::memory_order_acquire)) {
+					t_iSlot = i;
+					break;
+				}
+			}
+
+			// Per-thread caches fall back to their shared paths, which works but quietly costs every call
+			assert(t_iSlot >= 0 && "Out of ThreadSlots, raise ThreadSlot::MaxSlots");
+
+			// Touching the releaser registers its destructor for this thread
+			t_Releaser.bRegistered = true;
+
+			return t_iSlot;
+		}
+	}
+}
@@ -0,0 +1,218 @@
+#include "hustle/Topology.h"
+#include "hustle/Platform.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdlib.h>
+#include <thread>
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+	#include <dirent.h>
+	#include <string.h>
+#endif
+
+namespace Hustle {
+
+	Topology Topology::Detect() {
+
+		Topology topology;
+
+#if defined(__linux__)
+		ReadSysfs("/sys/devices/system", topology);
+#elif defined(HUSTLE_PLATFORM_WINDOWS)
+		// Only processor group 0, the same CPUs SetThreadAffinityMask() can address
+		ULONG uHighestNode = 0;
+		if (GetNumaHighestNodeNumber(&uHighestNode)) {
+			for (USHORT uNode = 0; uNode <= (USHORT)uHighestNode; uNode++) {
+				GROUP_AFFINITY affinity = {};
+				if (GetNumaNodeProcessorMaskEx(uNode, &affinity) == FALSE || affinity.Group != 0 || affinity.Mask == 0)
+					continue;
+
+				Node node = { (int)uNode, {} };
+				for (int iCpu = 0; iCpu < (int)(sizeof(affinity.Mask) * 8); iCpu++) {
+					if (affinity.Mask & ((KAFFINITY)1 << iCpu))
+						node.cpus.push_back(iCpu);
+				}
+				topology.m_Nodes.push_back(node);
+			}
+		}
+
+		// SMT siblings, from the same group 0 the nodes came from
+		DWORD dwLength = 0;
+		GetLogicalProcessorInformation(nullptr, &dwLength);
+		std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> processors(dwLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		if (processors.empty() == false && GetLogicalProcessorInformation(processors.data(), &dwLength)) {
+			for (auto& processor : processors) {
+				if (processor.Relationship != RelationProcessorCore)
+					continue;
+
+				std::vector<int> siblings;
+				for (int iCpu = 0; iCpu < (int)(sizeof(processor.ProcessorMask) * 8); iCpu++) {
+					if (processor.ProcessorMask & ((ULONG_PTR)1 << iCpu))
+						siblings.push_back(iCpu);
+				}
+				topology.m_Cores.push_back(siblings);
+			}
+		}
+#endif
+
+		if (topology.m_Nodes.empty()) {
+			Node node = { 0, {} };
+			int iCpuCount = (std::max)(1, (int)std::thread::hardware_concurrency());
+			for (int i = 0; i < iCpuCount; i++)
+				node.cpus.push_back(i);
+			topology.m_Nodes.push_back(node);
+
+#if defined(__linux__)
+			// Kernels without NUMA have no node directory, but still list the siblings
+			ReadSysfsCores("/sys/devices/system", topology);
+#endif
+		}
+
+		AddMissingCores(topology);
+		return topology;
+	}
+
+	bool Topology::ReadSysfs(const std::string& root, Topology& topology) {
+
+		topology.m_Nodes.clear();
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+		std::string nodeDir = root + "/node";
+		DIR* pDir = opendir(nodeDir.c_str());
+		if (pDir == nullptr)
+			return false;
+
+		while (dirent* pEntry = readdir(pDir)) {
+
+			// node0, node1, ... alongside files like "online" and "possible"
+			const char* szName = pEntry->d_name;
+			if (strncmp(szName, "node", 4) != 0 || szName[4] < '0' || szName[4] > '9')
+				continue;
+
+			std::ifstream file(nodeDir + "/" + szName + "/cpulist");
+			std::string cpuList;
+			if (!std::getline(file, cpuList))
+				continue;
+
+			// Memory only nodes have no CPUs, and nothing to place a worker on
+			Node node = { atoi(szName + 4), {} };
+			if (ParseCpuList(cpuList, node.cpus) == false || node.cpus.empty())
+				continue;
+
+			topology.m_Nodes.push_back(node);
+		}
+		closedir(pDir);
+
+		std::sort(topology.m_Nodes.begin(), topology.m_Nodes.end(), [](const Node& a, const Node& b) { return a.iId < b.iId; });
+#endif
+
+		if (topology.m_Nodes.empty())
+			return false;
+
+		ReadSysfsCores(root, topology);
+		return true;
+	}
+
+	void Topology::ReadSysfsCores(const std::string& root, Topology& topology) {
+
+		topology.m_Cores.clear();
+
+		for (auto& node : topology.m_Nodes) {
+			for (int iCpu : node.cpus) {
+
+				// Each core is listed once per sibling, only keep it the first time
+				if (topology.GetCoreOfCpu(iCpu) != -1)
+					continue;
+
+				std::ifstream file(root + "/cpu/cpu" + std::to_string(iCpu) + "/topology/thread_siblings_list");
+				std::string siblingList;
+				std::vector<int> siblings;
+				if (!std::getline(file, siblingList) || ParseCpuList(siblingList, siblings) == false ||
+					std::find(siblings.begin(), siblings.end(), iCpu) == siblings.end())
+					siblings = { iCpu };
+
+				topology.m_Cores.push_back(siblings);
+			}
+		}
+
+		AddMissingCores(topology);
+	}
+
+	void Topology::AddMissingCores(Topology& topology) {
+
+		for (auto& node : topology.m_Nodes) {
+			for (int iCpu : node.cpus) {
+				if (topology.GetCoreOfCpu(iCpu) == -1)
+					topology.m_Cores.push_back({ iCpu });
+			}
+		}
+
+		std::sort(topology.m_Cores.begin(), topology.m_Cores.end(),
+				  [](const std::vector<int>& a, const std::vector<int>& b) { return a.front() < b.front(); });
+	}
+
+	bool Topology::ParseCpuList(const std::string& text, std::vector<int>& cpus) {
+
+		cpus.clear();
+
+		const char* p = text.c_str();
+		while (*p != '\0' && *p != '\n') {
+
+			char* pEnd = nullptr;
+			long iFirst = strtol(p, &pEnd, 10);
+			if (pEnd == p || iFirst < 0)
+				return false;
+
+			long iLast = iFirst;
+			p = pEnd;
+			if (*p == '-') {
+				iLast = strtol(p + 1, &pEnd, 10);
+				if (pEnd == p + 1 || iLast < iFirst)
+					return false;
+				p = pEnd;
+			}
+
+			for (long i = iFirst; i <= iLast; i++)
+				cpus.push_back((int)i);
+
+			if (*p == ',')
+				p++;
+			else if (*p != '\0' && *p != '\n')
+				return false;
+		}
+
+		std::sort(cpus.begin(), cpus.end());
+		cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+		return true;
+	}
+
+	int Topology::GetCpuCount() const {
+
+		int iCount = 0;
+		for (auto& node : m_Nodes)
+			iCount += (int)node.cpus.size();
+
+		return iCount;
+	}
+
+	int Topology::GetNodeOfCpu(int iCpu) const {
+
+		for (int i = 0; i < (int)m_Nodes.size(); i++) {
+			if (std::binary_search(m_Nodes[i].cpus.begin(), m_Nodes[i].cpus.end(), iCpu))
+				return i;
+		}
+
+		return -1;
+	}
+
+	int Topology::GetCoreOfCpu(int iCpu) const {
+
+		for (int i = 0; i < (int)m_Cores.size(); i++) {
+			if (std::binary_search(m_Cores[i].begin(), m_Cores[i].end(), iCpu))
+				return i;
+		}
+
+		return -1;
+	}
+}
@@ -0,0 +1,294 @@
+#include "hustle/Trace.h"
+#include "hustle/SpinLock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+namespace Hustle {
+
+	namespace {
+
+		// Every thread's buffer, kept after the thread exits so its events still make it into the dump
+		struct TraceRegistry {
+			SpinLock lock;
+			std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+			// Where the trace starts, in ticks and in real time, to work out the tick rate when dumping
+			uint64_t iStartTicks = Platform::ReadTicks();
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		};
+
+		TraceRegistry& GetRegistry() {
+			static TraceRegistry registry;
+			return registry;
+		}
+
+		// The calling thread's buffer, nullptr until it records its first event
+		thread_local TraceBuffer* t_pTraceBuffer = nullptr;
+
+		std::atomic<bool> s_bTraceEnabled = { true };
+
+		TraceBuffer* GetThreadBuffer() {
+
+			if (t_pTraceBuffer)
+				return t_pTraceBuffer;
+
+			TraceRegistry& registry = GetRegistry();
+			registry.lock.Lock();
+			registry.buffers.emplace_back(new TraceBuffer((int)registry.buffers.size()));
+			t_pTraceBuffer = registry.buffers.back().get();
+			registry.lock.Unlock();
+
+			return t_pTraceBuffer;
+		}
+	}
+
+	TraceBuffer::TraceBuffer(int iThreadIndex) :
+		m_pEntries(new Entry[Capacity]),
+		m_iHead(0),
+		m_iThreadIndex(iThreadIndex) {
+
+		snprintf(m_szName, sizeof(m_szName), "Thread %d", iThreadIndex);
+	}
+
+	TraceBuffer::~TraceBuffer() {
+		delete[] m_pEntries;
+	}
+
+	uint64_t TraceBuffer::Read(Record* pRecords) {
+
+		uint64_t iHead = m_iHead.load(std::memory_order_acquire);
+		uint64_t iFirst = iHead > Capacity ? iHead - Capacity : 0;
+
+		for (uint64_t i = iFirst; i < iHead; i++) {
+			Entry& entry = m_pEntries[i & (Capacity - 1)];
+			Record& record = pRecords[i - iFirst];
+
+			record.iTicks = entry.iTicks.load(std::memory_order_relaxed);
+			uint64_t iPacked = entry.iPacked.load(std::memory_order_relaxed);
+			record.iArg = iPacked >> 8;
+			record.eEvent = (TraceEvent)(iPacked & 0xff);
+		}
+
+		// Anything the writer has reached since, including the slot it may be halfway through, was overwritten under us
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t iNewHead = m_iHead.load(std::memory_order_relaxed);
+		uint64_t iValid = iNewHead + 1 > Capacity ? iNewHead + 1 - Capacity : 0;
+		if (iValid <= iFirst)
+			return iHead - iFirst;
+
+		if (iValid >= iHead)
+			return 0;
+
+		uint64_t iSkip = iValid - iFirst;
+		std::move(pRecords + iSkip, pRecords + (iHead - iFirst), pRecords);
+		return iHead - iValid;
+	}
+
+	void TraceBuffer::SetName(const char* szName) {
+		snprintf(m_szName, sizeof(m_szName), "%s", szName);
+	}
+
+	namespace Trace {
+
+		void Record(TraceEvent eEvent, uint64_t iArg) {
+
+			if (s_bTraceEnabled.load(std::memory_order_relaxed) == false)
+				return;
+
+			GetThreadBuffer()->Push(eEvent, iArg);
+		}
+
+		void SetThreadName(const char* szName) {
+			GetThreadBuffer()->SetName(szName);
+		}
+
+		void SetEnabled(bool bEnabled) {
+			s_bTraceEnabled.store(bEnabled, std::memory_order_relaxed);
+		}
+
+		bool IsEnabled() {
+			return s_bTraceEnabled.load(std::memory_order_relaxed);
+		}
+
+		void Clear() {
+
+			TraceRegistry& registry = GetRegistry();
+			registry.lock.Lock();
+			for (auto& pBuffer : registry.buffers)
+				pBuffer->Clear();
+			registry.lock.Unlock();
+		}
+
+		bool Dump(const char* szPath) {
+
+			std::ofstream file(szPath);
+			if (!file)
+				return false;
+
+			TraceRegistry& registry = GetRegistry();
+
+			// Ticks per microsecond, measured over the whole trace so far
+			double dElapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - registry.startTime).count();
+			uint64_t iElapsedTicks = Platform::ReadTicks() - registry.iStartTicks;
+			double dTicksPerUs = dElapsedUs > 0.0 ? iElapsedTicks / dElapsedUs : 1.0;
+
+			std::vector<TraceBuffer::Record> records(TraceBuffer::Capacity);
+			bool bFirst = true;
+
+			auto beginEvent = [&](const char* szName, const char* szPhase, int iThread, uint64_t iTicks) {
+				if (bFirst == false)
+					file << ",\n";
+				bFirst = false;
+
+				double dTs = (int64_t)(iTicks - registry.iStartTicks) / dTicksPerUs;
+				file << "{\"name\":\"" << szName << "\",\"ph\":\"" << szPhase << "\",\"pid\":1,\"tid\":" << iThread
+					<< ",\"ts\":" << std::fixed << std::setprecision(3) << dTs;
+			};
+
+			auto asyncEvent = [&](const char* szPhase, int iThread, uint64_t iTicks, uint64_t iJob) {
+				beginEvent("job", szPhase, iThread, iTicks);
+				file << ",\"cat\":\"job\",\"id\":\"0x" << std::hex << iJob << std::dec << "\"}";
+			};
+
+			// A job's async span can begin and end on different threads, so those are matched up once every thread has been read
+			struct AsyncEvent {
+				uint64_t iTicks;
+				uint64_t iJob;
+				int iThread;
+				bool bBegin;
+			};
+			std::vector<AsyncEvent> asyncEvents;
+			uint64_t iLastTicks = registry.iStartTicks;
+
+			file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+			// Threads recording their first event wait until we're done
+			registry.lock.Lock();
+			for (auto& pBuffer : registry.buffers) {
+
+				int iThread = pBuffer->GetThreadIndex();
+
+				if (bFirst == false)
+					file << ",\n";
+				bFirst = false;
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << iThread
+					<< ",\"args\":{\"name\":\"" << pBuffer->GetName() << "\"}}";
+
+				// Slices still open on this thread. Once the buffer has wrapped, the oldest ends may have lost their
+				// begins, and those are dropped. Whatever is still open at the end is closed at the thread's last event.
+				std::vector<const char*> openSlices;
+				auto closeSlice = [&](const char* szName) {
+					if (openSlices.empty() || strcmp(openSlices.back(), szName) != 0)
+						return false;
+
+					openSlices.pop_back();
+					return true;
+				};
+
+				uint64_t iCount = pBuffer->Read(records.data());
+				for (uint64_t i = 0; i < iCount; i++) {
+
+					const TraceBuffer::Record& record = records[i];
+
+					switch (record.eEvent) {
+					case TraceEvent::JobRun:
+					case TraceEvent::JobStop: {
+						// Each stretch a job runs on a thread is a slice on that thread's track. The job as a whole is an
+						// async span, since one that yields or parks can finish on a different thread than it started on.
+						bool bRun = record.eEvent == TraceEvent::JobRun;
+						uint64_t iJob = record.iArg & ~(uint64_t)1;
+
+						if (record.iArg & 1)
+							asyncEvents.push_back({ record.iTicks, iJob, iThread, bRun });
+
+						if (bRun)
+							openSlices.push_back("job");
+						else if (closeSlice("job") == false)
+							break;
+
+						beginEvent("job", bRun ? "B" : "E", iThread, record.iTicks);
+						file << ",\"args\":{\"job\":\"0x" << std::hex << iJob << std::dec << "\"}}";
+						break;
+					}
+					case TraceEvent::Steal:
+						beginEvent("steal", "i", iThread, record.iTicks);
+						file << ",\"s\":\"t\",\"args\":{\"victim\":" << std::dec << record.iArg << "}}";
+						break;
+					case TraceEvent::IdleStart:
+						openSlices.push_back("idle");
+						beginEvent("idle", "B", iThread, record.iTicks);
+						file << "}";
+						break;
+					case TraceEvent::IdleEnd:
+						if (closeSlice("idle")) {
+							beginEvent("idle", "E", iThread, record.iTicks);
+							file << "}";
+						}
+						break;
+					case TraceEvent::WaitStart:
+						openSlices.push_back("wait");
+						beginEvent("wait", "B", iThread, record.iTicks);
+						file << ",\"args\":{\"counter\":\"0x" << std::hex << record.iArg << std::dec << "\"}}";
+						break;
+					case TraceEvent::WaitEnd:
+						if (closeSlice("wait")) {
+							beginEvent("wait", "E", iThread, record.iTicks);
+							file << "}";
+						}
+						break;
+					case TraceEvent::Park:
+						beginEvent("park", "i", iThread, record.iTicks);
+						file << ",\"s\":\"t\",\"args\":{\"counter\":\"0x" << std::hex << record.iArg << std::dec << "\"}}";
+						break;
+					}
+				}
+
+				uint64_t iThreadLastTicks = iCount > 0 ? records[iCount - 1].iTicks : registry.iStartTicks;
+				iLastTicks = (std::max)(iLastTicks, iThreadLastTicks);
+				while (openSlices.empty() == false) {
+					beginEvent(openSlices.back(), "E", iThread, iThreadLastTicks);
+					file << "}";
+					openSlices.pop_back();
+				}
+			}
+
+			// Same for the async spans, across every thread in time order. Job addresses are reused, so a span
+			// begun again before it ended lost its end, and is closed where the next one starts.
+			std::stable_sort(asyncEvents.begin(), asyncEvents.end(), [](const AsyncEvent& a, const AsyncEvent& b) {
+				return a.iTicks < b.iTicks;
+			});
+
+			std::unordered_map<uint64_t, int> openSpans;
+			for (const AsyncEvent& event : asyncEvents) {
+				auto it = openSpans.find(event.iJob);
+				if (event.bBegin) {
+					if (it != openSpans.end())
+						asyncEvent("e", it->second, event.iTicks, event.iJob);
+
+					openSpans[event.iJob] = event.iThread;
+					asyncEvent("b", event.iThread, event.iTicks, event.iJob);
+				}
+				else if (it != openSpans.end()) {
+					asyncEvent("e", event.iThread, event.iTicks, event.iJob);
+					openSpans.erase(it);
+				}
+			}
+
+			for (auto& span : openSpans)
+				asyncEvent("e", span.second, iLastTicks, span.first);
+
+			registry.lock.Unlock();
+
+			file << "\n]}\n";
+			return file.good();
+		}
+	}
+}
@@ -3,20 +3,33 @@
 #include "hustle/Dispatcher.h"
 #include "hustle/WorkerThread.h"
 
+#include <assert.h>
 #include <iostream>
 #include <thread>
 #include <vector>
 
+#if defined(HUSTLE_PLATFORM_POSIX)
+	#include <string.h>
+#endif
+
 namespace Hustle {
 
 	WorkerThread::WorkerThread() :
-		m_dwThreadID(0),
-		m_hThread(nullptr),
 		m_iCoreAffinity(-1),
-		m_eState(State::None) {
+		m_iNode(0),
+		m_eState(State::None),
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+		m_hThread(nullptr),
+		m_dwThreadID(0) {
+#else
+		m_hThread(),
+		m_bThreadCreated(false) {
+#endif
 
 	}
 
+#if defined(HUSTLE_PLATFORM_WINDOWS)
+
 	WorkerThread::~WorkerThread() {
 		if (m_hThread) {
 			CloseHandle(m_hThread);
@@ -29,18 +42,19 @@ namespace Hustle {
 		// Worker thread needs to be in None or Done state in order to be started
 		auto currentState = GetState();
 		assert(currentState == WorkerThread::State::None || currentState == WorkerThread::State::Done);
+		(void)currentState;
 
 		// Change state to starting
 		m_eState.store(WorkerThread::State::Starting);
 
-		// Create the thread here
+		// Create the thread here. It starts suspended, so it's on the right core before it runs anything.
 		m_hThread = CreateThread(NULL,                   // default security attributes
-								 0,                      // use default stack size  
-								 Dispatcher::Scheduler,  // Thread entry point
-								 this,                   // argument to thread function 
-								 0,                      // use default creation flags 
-								 &m_dwThreadID);         // returns the thread identifier 
-		
+								 0,                      // use default stack size
+								 ThreadEntryPoint,       // Thread entry point
+								 this,                   // argument to thread function
+								 CREATE_SUSPENDED,       // don't run until the affinity is set
+								 &m_dwThreadID);         // returns the thread identifier
+
 		if (m_hThread == nullptr) {
 			m_eState.store(WorkerThread::State::None);
 			m_LastError = GetLastErrorAsStr(::GetLastError());
@@ -53,17 +67,22 @@ namespace Hustle {
 
 			if (SetThreadAffinityMask(m_hThread, 1i64 << iCoreAffinity) == 0) {
 
-				// If setting the thread affinity failed, the system is in an invalid state. 
+				DWORD dwError = ::GetLastError();
+
+				// If setting the thread affinity failed, the system is in an invalid state.
+				ResumeThread(m_hThread);
 				Stop();
 
 				// Stop() should set the state to DONE, but we'll flip it back to None since technically we're failing here
 				m_eState.store(WorkerThread::State::None);
 
-				m_LastError = GetLastErrorAsStr(::GetLastError());
+				m_LastError = GetLastErrorAsStr(dwError);
 				return false;
 			}
 		}
 
+		ResumeThread(m_hThread);
+
 		return true;
 	}
 
@@ -77,15 +96,20 @@ namespace Hustle {
 		m_hThread = nullptr;
 	}
 
+	DWORD WINAPI WorkerThread::ThreadEntryPoint(LPVOID pData) {
+		Dispatcher::Scheduler((WorkerThread*)pData);
+		return 0;
+	}
+
 	std::string WorkerThread::GetLastErrorAsStr(DWORD dwError) {
 
 		assert(dwError != 0);
 
 		LPSTR messageBuffer = nullptr;
 		size_t size = FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-									 NULL, 
+									 NULL,
 									 dwError,
-									 MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), 
+									 MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
 									 (LPSTR)&messageBuffer, 0, NULL);
 
 		//Copy the error message into a std::string.
@@ -96,4 +120,88 @@ namespace Hustle {
 
 		return message;
 	}
-}
\ No newline at end of file
+
+#else
+
+	WorkerThread::~WorkerThread() {
+		if (m_bThreadCreated) {
+			pthread_detach(m_hThread);
+			m_bThreadCreated = false;
+		}
+	}
+
+	bool WorkerThread::Start(int iCoreAffinity) {
+
+		// Worker thread needs to be in None or Done state in order to be started
+		auto currentState = GetState();
+		assert(currentState == WorkerThread::State::None || currentState == WorkerThread::State::Done);
+		(void)currentState;
+
+		// Change state to starting
+		m_eState.store(WorkerThread::State::Starting);
+
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+
+		// Set thread affinity. It's part of the attributes, so the thread is on the right core before it runs
+		// anything, and whatever it allocates on the way in is first touched on that core's NUMA node.
+		int iError = 0;
+		if (iCoreAffinity != -1) {
+			m_iCoreAffinity = iCoreAffinity;
+
+			cpu_set_t cpuSet;
+			CPU_ZERO(&cpuSet);
+			CPU_SET(iCoreAffinity, &cpuSet);
+
+			iError = pthread_attr_setaffinity_np(&attr, sizeof(cpuSet), &cpuSet);
+		}
+
+		// Create the thread here
+		if (iError == 0)
+			iError = pthread_create(&m_hThread, &attr, ThreadEntryPoint, this);
+
+		pthread_attr_destroy(&attr);
+
+		if (iError != 0) {
+			m_eState.store(WorkerThread::State::None);
+			m_LastError = GetLastErrorAsStr(iError);
+			return false;
+		}
+		m_bThreadCreated = true;
+
+		return true;
+	}
+
+	void WorkerThread::Stop() {
+		// Set the state to stopping. Once the ThreadEntryPoint completes, the state will progress to Done
+		m_eState.exchange(WorkerThread::State::Stopping);
+
+		// Wait for the thread to complete
+		if (m_bThreadCreated) {
+			pthread_join(m_hThread, nullptr);
+			m_bThreadCreated = false;
+		}
+	}
+
+	void* WorkerThread::ThreadEntryPoint(void* pData) {
+		Dispatcher::Scheduler((WorkerThread*)pData);
+		return nullptr;
+	}
+
+	std::string WorkerThread::GetLastErrorAsStr(int iError) {
+
+		assert(iError != 0);
+
+		char messageBuffer[256];
+
+		// GNU strerror_r may return a static string rather than filling in the buffer
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+		return std::string(strerror_r(iError, messageBuffer, sizeof(messageBuffer)));
+#else
+		strerror_r(iError, messageBuffer, sizeof(messageBuffer));
+		return std::string(messageBuffer);
+#endif
+	}
+
+#endif
+}
@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+#include "hustle/Affinity.h"
+#include "hustle/Platform.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+
+#include <unistd.h>
+
+static void WriteFile(const std::filesystem::path& path, const std::string& text) {
+	std::filesystem::create_directories(path.parent_path());
+	std::ofstream(path) << text;
+}
+
+/**
+ * @brief Two nodes of four cores, each core with two SMT siblings numbered 8 apart. Written to a directory named
+ * after the calling test and process, so tests run in parallel processes don't share it.
+*/
+static Topology MakeTwoSocketTopology() {
+
+	std::string testName = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+	std::filesystem::path root = std::filesystem::temp_directory_path() /
+		("hustle_affinity_test_" + testName + "_" + std::to_string(getpid()));
+	std::filesystem::remove_all(root);
+
+	WriteFile(root / "node" / "node0" / "cpulist", "0-3,8-11\n");
+	WriteFile(root / "node" / "node1" / "cpulist", "4-7,12-15\n");
+	for (int iCpu = 0; iCpu < 16; iCpu++) {
+		int iFirst = iCpu % 8;
+		WriteFile(root / "cpu" / ("cpu" + std::to_string(iCpu)) / "topology" / "thread_siblings_list",
+				  std::to_string(iFirst) + "," + std::to_string(iFirst + 8) + "\n");
+	}
+
+	Topology topology;
+	EXPECT_TRUE(Topology::ReadSysfs(root.string(), topology));
+	std::filesystem::remove_all(root);
+
+	return topology;
+}
+
+TEST(Affinity, LogicalCores) {
+
+	Topology topology = MakeTwoSocketTopology();
+	ASSERT_EQ(topology.GetCores().size(), 8u);
+
+	// Node by node, with the first CPU kept back until last
+	EXPECT_EQ(AffinityPolicy::LogicalCores().GetPlacement(topology, {}, true),
+			  std::vector<int>({ 1, 2, 3, 8, 9, 10, 11, 4, 5, 6, 7, 12, 13, 14, 15, 0 }));
+
+	// By number, and only where the process is allowed
+	EXPECT_EQ(AffinityPolicy::LogicalCores().GetPlacement(topology, { 2, 3, 20 }, false), std::vector<int>({ 3, 2 }));
+}
+
+TEST(Affinity, PhysicalCores) {
+
+	Topology topology = MakeTwoSocketTopology();
+
+	EXPECT_EQ(AffinityPolicy::PhysicalCores().GetPlacement(topology, {}, true), std::vector<int>({ 1, 2, 3, 4, 5, 6, 7, 0 }));
+
+	// A sibling stands in for a core whose first CPU isn't allowed
+	EXPECT_EQ(AffinityPolicy::PhysicalCores().GetPlacement(topology, { 4, 5, 6, 7, 8, 9, 10, 11, 12 }, true),
+			  std::vector<int>({ 9, 10, 11, 4, 5, 6, 7, 8 }));
+}
+
+TEST(Affinity, CpuSet) {
+
+	Topology topology = MakeTwoSocketTopology();
+
+	AffinityPolicy policy = AffinityPolicy::CpuSet({ 12, 5, 99 });
+	policy.bReserveFirstCpu = false;
+	EXPECT_EQ(policy.GetPlacement(topology, {}, false), std::vector<int>({ 5, 12 }));
+	EXPECT_EQ(policy.GetPlacement(topology, { 5 }, false), std::vector<int>({ 5 }));
+
+	EXPECT_TRUE(AffinityPolicy::CpuSet({ 99 }).GetPlacement(topology, {}, true).empty());
+}
+
+TEST(Affinity, ReadCgroupCpuQuota) {
+
+	std::filesystem::path root = std::filesystem::temp_directory_path() / "hustle_cgroup_test";
+	std::filesystem::remove_all(root);
+
+	WriteFile(root / "v2" / "cpu.max", "150000 100000\n");
+	WriteFile(root / "v2max" / "cpu.max", "max 100000\n");
+	WriteFile(root / "v1" / "cpu.cfs_quota_us", "50000\n");
+	WriteFile(root / "v1" / "cpu.cfs_period_us", "100000\n");
+	WriteFile(root / "v1max" / "cpu.cfs_quota_us", "-1\n");
+	WriteFile(root / "v1max" / "cpu.cfs_period_us", "100000\n");
+
+	EXPECT_EQ(AffinityPolicy::ReadCgroupCpuQuota((root / "v2").string()), 2);
+	EXPECT_EQ(AffinityPolicy::ReadCgroupCpuQuota((root / "v2max").string()), 0);
+	EXPECT_EQ(AffinityPolicy::ReadCgroupCpuQuota((root / "v1").string()), 1);
+	EXPECT_EQ(AffinityPolicy::ReadCgroupCpuQuota((root / "v1max").string()), 0);
+	EXPECT_EQ(AffinityPolicy::ReadCgroupCpuQuota((root / "missing").string()), 0);
+
+	std::filesystem::remove_all(root);
+}
+
+#endif
+
+TEST(Affinity, DefaultWorkerCount) {
+
+	AffinityPolicy policy;
+	EXPECT_EQ(policy.GetDefaultWorkerCount(16, 0), 15);
+	EXPECT_EQ(policy.GetDefaultWorkerCount(16, 4), 3);
+	EXPECT_EQ(policy.GetDefaultWorkerCount(1, 0), 1);
+
+	policy.bHonorCpuQuota = false;
+	EXPECT_EQ(policy.GetDefaultWorkerCount(16, 4), 15);
+
+	policy.bReserveFirstCpu = false;
+	EXPECT_EQ(policy.GetDefaultWorkerCount(16, 0), 16);
+}
+
+TEST(Affinity, AllowedCpusFitTheMachine) {
+
+	// Whatever the process is allowed, the default policy places on at least one of them
+	Topology topology = Topology::Detect();
+	std::vector<int> placement = AffinityPolicy::LogicalCores().GetPlacement(topology, AffinityPolicy::GetAllowedCpus(), true);
+	EXPECT_FALSE(placement.empty());
+}
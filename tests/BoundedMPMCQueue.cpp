@@ -0,0 +1,158 @@
+#include "gtest/gtest.h"
+#include "hustle/BoundedMPMCQueue.h"
+#include "hustle/ResourcePool.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+const int MaxMPMCQueueSize = 100;
+
+TEST(BoundedMPMCQueue, SizeCheck) {
+	BoundedMPMCQueue<int*> intQueue(MaxMPMCQueueSize);
+
+	int intData[MaxMPMCQueueSize];
+
+	for (auto i = 0; i < MaxMPMCQueueSize; i++)
+		intData[i] = i;
+
+	for (auto i = 0; i < MaxMPMCQueueSize; i++) {
+		intQueue.Push(&intData[i]);
+	}
+
+	EXPECT_EQ(intQueue.Size(), MaxMPMCQueueSize);
+
+	for (auto i = 0; i < MaxMPMCQueueSize / 2; i++) {
+		int* pInt = intQueue.Pop();
+		EXPECT_EQ(*pInt, i);
+	}
+
+	EXPECT_EQ(intQueue.Size(), MaxMPMCQueueSize / 2);
+}
+
+TEST(BoundedMPMCQueue, EmptyQueue) {
+
+	BoundedMPMCQueue<int*> intQueue;
+	EXPECT_EQ(intQueue.Pop(), nullptr);
+	EXPECT_EQ(intQueue.Size(), 0);
+}
+
+TEST(BoundedMPMCQueue, FullQueue) {
+
+	// Capacity rounds up to a power of two
+	BoundedMPMCQueue<int*> intQueue(5);
+	EXPECT_EQ(intQueue.Capacity(), 8);
+
+	int intData[8];
+	for (auto i = 0; i < 8; i++)
+		EXPECT_TRUE(intQueue.TryPush(&intData[i]));
+
+	EXPECT_FALSE(intQueue.TryPush(&intData[0]));
+
+	// Making room lets the next push through, wrapping around the ring
+	EXPECT_EQ(intQueue.Pop(), &intData[0]);
+	EXPECT_TRUE(intQueue.TryPush(&intData[0]));
+	EXPECT_EQ(intQueue.Size(), 8);
+}
+
+TEST(BoundedMPMCQueue, PushSpillsWhenFull) {
+
+	BoundedMPMCQueue<int*> intQueue(8);
+
+	int intData[20];
+	for (auto i = 0; i < 20; i++)
+		intQueue.Push(&intData[i]);
+
+	EXPECT_EQ(intQueue.Size(), 20u);
+
+	// The ring drains first, then the overflow list, which took everything after the spill
+	for (auto i = 0; i < 20; i++)
+		EXPECT_EQ(intQueue.Pop(), &intData[i]);
+
+	EXPECT_EQ(intQueue.Pop(), nullptr);
+	EXPECT_EQ(intQueue.Size(), 0u);
+}
+
+TEST(BoundedMPMCQueue, PushPastDefaultCapacity) {
+
+	const size_t DefaultCapacity = BoundedMPMCQueue<int*>::DefaultCapacity;
+	const int ItemCount = (int)DefaultCapacity * 3 + 7;
+
+	BoundedMPMCQueue<int*> intQueue;
+	EXPECT_EQ(intQueue.Capacity(), DefaultCapacity);
+
+	std::vector<int> intData(ItemCount);
+	for (auto i = 0; i < ItemCount; i++)
+		intQueue.Push(&intData[i]);
+
+	// Nothing is dropped or refused once the ring is full
+	EXPECT_EQ(intQueue.Size(), (size_t)ItemCount);
+
+	for (auto i = 0; i < ItemCount; i++)
+		EXPECT_EQ(intQueue.Pop(), &intData[i]);
+
+	EXPECT_EQ(intQueue.Pop(), nullptr);
+	EXPECT_EQ(intQueue.Size(), 0u);
+}
+
+TEST(BoundedMPMCQueue, ConcurrentProducersConsumers) {
+
+	const int ThreadCount = 4;
+	const int ItemsPerProducer = 25000;
+
+	BoundedMPMCQueue<int*> intQueue(1024);
+	std::vector<int> intData(ThreadCount * ItemsPerProducer);
+	std::vector<std::atomic<int>> takenCount(intData.size());
+	for (auto& taken : takenCount)
+		taken = 0;
+
+	std::atomic<int> iConsumed = { 0 };
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < ThreadCount; t++) {
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < ItemsPerProducer; i++)
+				intQueue.Push(&intData[t * ItemsPerProducer + i]);
+		});
+
+		threads.emplace_back([&]() {
+			while (iConsumed < (int)intData.size()) {
+				if (int* pInt = intQueue.Pop()) {
+					takenCount[pInt - intData.data()]++;
+					iConsumed++;
+				}
+				else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	// Every item must have been taken exactly once
+	for (size_t i = 0; i < intData.size(); i++)
+		ASSERT_EQ(takenCount[i], 1);
+}
+
+TEST(BoundedMPMCQueue, ResourcePoolFreeList) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	ResourcePool<TestResource, BoundedMPMCQueue<TestResource*>> testPool;
+	testPool.Grow(MaxMPMCQueueSize);
+	EXPECT_EQ(testPool.GetFreeCount(), MaxMPMCQueueSize);
+
+	TestResource* pResource = testPool.Get();
+	ASSERT_NE(pResource, nullptr);
+	EXPECT_EQ(testPool.GetFreeCount(), MaxMPMCQueueSize - 1);
+
+	testPool.Release(pResource);
+	EXPECT_EQ(testPool.GetFreeCount(), MaxMPMCQueueSize);
+	EXPECT_EQ(testPool.GetTotalCount(), MaxMPMCQueueSize);
+}
@@ -0,0 +1,718 @@
+#include "gtest/gtest.h"
+#include "hustle/Dispatcher.h"
+#include "hustle/JobFuture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+// Counts heap allocations, on any thread, while s_bCountAllocations is set
+static std::atomic<bool> s_bCountAllocations = { false };
+static std::atomic<int> s_iAllocationCount = { 0 };
+
+// Called through volatile pointers, so once the operators below are inlined the compiler doesn't take free() for
+// the wrong way to release what a new expression returned (-Wmismatched-new-delete)
+static void* (*volatile s_pfnMalloc)(size_t) = malloc;
+static void (*volatile s_pfnFree)(void*) = free;
+
+void* operator new(size_t size) {
+	if (s_bCountAllocations.load(std::memory_order_relaxed))
+		s_iAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* p = s_pfnMalloc(size ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	s_pfnFree(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	s_pfnFree(p);
+}
+
+const int FanOutCount = 1000;
+
+// Bring the job system up once for every test in this file
+class DispatcherEnvironment : public ::testing::Environment {
+public:
+	void SetUp() override {
+		ASSERT_TRUE(Dispatcher::GetInstance().Init(100, 100, 2));
+	}
+
+	void TearDown() override {
+		Dispatcher::GetInstance().Shutdown();
+	}
+};
+
+static ::testing::Environment* const s_pDispatcherEnvironment =
+	::testing::AddGlobalTestEnvironment(new DispatcherEnvironment);
+
+static void IncrementJob(void* pUserData) {
+	((std::atomic<int>*)pUserData)->fetch_add(1);
+}
+
+TEST(Dispatcher, WaitForJob) {
+
+	std::atomic<int> iRunCount = { 0 };
+
+	auto hJob = Dispatcher::GetInstance().AddJob(IncrementJob, &iRunCount);
+	Dispatcher::GetInstance().WaitForJob(hJob);
+
+	EXPECT_EQ(iRunCount, 1);
+}
+
+TEST(Dispatcher, CounterFanOut) {
+
+	std::atomic<int> iRunCount = { 0 };
+	JobCounter counter;
+
+	JobDecl jobs[FanOutCount];
+	for (int i = 0; i < FanOutCount; i++)
+		jobs[i] = { IncrementJob, &iRunCount };
+
+	Dispatcher::GetInstance().AddJobs(jobs, FanOutCount, &counter);
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	EXPECT_EQ(counter.GetValue(), 0);
+	EXPECT_EQ(iRunCount, FanOutCount);
+}
+
+struct FanInData {
+	std::atomic<int> iRunCount = { 0 };
+	int iSeenAfterWait = -1;
+};
+
+static void FanInJob(void* pUserData) {
+
+	FanInData* pData = (FanInData*)pUserData;
+	JobCounter counter;
+
+	JobDecl jobs[FanOutCount];
+	for (int i = 0; i < FanOutCount; i++)
+		jobs[i] = { IncrementJob, &pData->iRunCount };
+
+	// Waiting from inside a fiber hands the worker back to the scheduler
+	Dispatcher::GetInstance().AddJobs(jobs, FanOutCount, &counter);
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	pData->iSeenAfterWait = pData->iRunCount;
+}
+
+TEST(Dispatcher, CounterFanInFromJob) {
+
+	FanInData data;
+
+	auto hJob = Dispatcher::GetInstance().AddJob(FanInJob, &data);
+	Dispatcher::GetInstance().WaitForJob(hJob);
+
+	EXPECT_EQ(data.iSeenAfterWait, FanOutCount);
+}
+
+TEST(Dispatcher, CounterTarget) {
+
+	std::atomic<int> iRunCount = { 0 };
+
+	// An extra reference that no job owns keeps the counter from reaching zero
+	JobCounter counter(1);
+
+	JobDecl jobs[FanOutCount];
+	for (int i = 0; i < FanOutCount; i++)
+		jobs[i] = { IncrementJob, &iRunCount };
+
+	Dispatcher::GetInstance().AddJobs(jobs, FanOutCount, &counter);
+	Dispatcher::GetInstance().WaitForCounter(&counter, 1);
+
+	EXPECT_EQ(counter.GetValue(), 1);
+	EXPECT_EQ(iRunCount, FanOutCount);
+}
+
+TEST(Dispatcher, AddJobsMixedBatch) {
+
+	std::atomic<int> iRunCount = { 0 };
+	JobCounter counter;
+
+	// Bigger than the job pool and a few bulk chunks, spread over every priority and stack class
+	std::vector<JobDecl> jobs(FanOutCount);
+	for (int i = 0; i < FanOutCount; i++)
+		jobs[i] = { IncrementJob, &iRunCount, (JobPriority)(i % JobPriorityCount), (StackClass)(i % StackClassCount) };
+
+	Dispatcher::GetInstance().AddJobs(jobs, &counter);
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	EXPECT_EQ(iRunCount, FanOutCount);
+	EXPECT_EQ(Dispatcher::GetInstance().GetJobQueueDepth(), 0);
+}
+
+static void ChainJob(void* pUserData) {
+
+	intptr_t iDepth = (intptr_t)pUserData;
+	if (iDepth == 0)
+		return;
+
+	auto hChild = Dispatcher::GetInstance().AddJob(ChainJob, (void*)(iDepth - 1));
+	Dispatcher::GetInstance().WaitForJob(hChild);
+}
+
+TEST(Dispatcher, WaitingFibersAreParked) {
+
+	const int ChainDepth = 64;
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	uint64_t iSwitchesBefore = dispatcher.GetFiberSwitchCount();
+
+	auto hJob = dispatcher.AddJob(ChainJob, (void*)(intptr_t)ChainDepth);
+	dispatcher.WaitForJob(hJob);
+
+	// Each job is switched into once to start and at most once more when its child completes.
+	// Polling would cost a switch per waiting fiber per scheduler pass.
+	uint64_t iSwitches = dispatcher.GetFiberSwitchCount() - iSwitchesBefore;
+	EXPECT_LE(iSwitches, (uint64_t)(ChainDepth + 1) * 2);
+}
+
+struct PriorityData {
+	std::atomic<int> iLowRunCount = { 0 };
+	int iLowSeenByHigh = -1;
+};
+
+static void LowPriorityJob(void* pUserData) {
+	((PriorityData*)pUserData)->iLowRunCount++;
+}
+
+static void HighPriorityJob(void* pUserData) {
+	PriorityData* pData = (PriorityData*)pUserData;
+	pData->iLowSeenByHigh = pData->iLowRunCount;
+}
+
+static void PrioritySubmitJob(void* pUserData) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	JobCounter counter;
+
+	// Queue the low priority work first, the high priority job should still jump ahead of it
+	JobDecl jobs[FanOutCount + 1];
+	for (int i = 0; i < FanOutCount; i++)
+		jobs[i] = { LowPriorityJob, pUserData, JobPriority::Low };
+	jobs[FanOutCount] = { HighPriorityJob, pUserData, JobPriority::High };
+
+	dispatcher.AddJobs(jobs, FanOutCount + 1, &counter);
+	dispatcher.WaitForCounter(&counter);
+}
+
+TEST(Dispatcher, FiberPoolGrowsWhileJobsRun) {
+
+	// More parked jobs than the 100 fibers the pool starts with, so workers grow it mid-run
+	const int ParkedCount = 500;
+	const int SpinnerCount = 50;
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	size_t iFibersBefore = dispatcher.GetFiberPoolTotal();
+
+	std::atomic<bool> bStop = { false };
+	std::atomic<int> iWrongFiber = { 0 };
+
+	// Threads outside the Dispatcher creating and destroying fibers the whole time
+	std::vector<std::thread> builders;
+	for (int i = 0; i < 2; i++) {
+		builders.emplace_back([&]() {
+			while (bStop == false) {
+				ResourcePool<Fiber> pool;
+				pool.SetConstructor([](void* pStorage) { return new (pStorage) Fiber(64 * 1024); });
+				pool.Grow(16);
+				EXPECT_EQ(Fiber::GetCurrentFiber(), nullptr);
+			}
+		});
+	}
+
+	// Jobs that keep switching out and back in, possibly on the other worker, and check who they are each time
+	JobCounter spinners;
+	for (int i = 0; i < SpinnerCount; i++) {
+		spinners.Increment();
+		dispatcher.AddJob([&]() {
+			Fiber* pSelf = Fiber::GetCurrentFiber();
+			for (int j = 0; j < 100; j++) {
+				dispatcher.YieldToScheduler();
+				if (Fiber::GetCurrentFiber() != pSelf)
+					iWrongFiber++;
+			}
+		}, JobPriority::Normal, &spinners);
+	}
+
+	JobCounter gate(1), parked;
+	std::atomic<int> iArrived = { 0 };
+	for (int i = 0; i < ParkedCount; i++) {
+		parked.Increment();
+		dispatcher.AddJob([&]() {
+			Fiber* pSelf = Fiber::GetCurrentFiber();
+			iArrived++;
+			dispatcher.WaitForCounter(&gate);
+			if (Fiber::GetCurrentFiber() != pSelf || pSelf == nullptr)
+				iWrongFiber++;
+		}, JobPriority::Normal, &parked);
+	}
+
+	dispatcher.WaitForCounter(&spinners);
+
+	// Every parked job holds a fiber until the gate opens
+	while (iArrived < ParkedCount)
+		std::this_thread::yield();
+	gate.Decrement();
+	dispatcher.WaitForCounter(&parked);
+
+	bStop = true;
+	for (auto& builder : builders)
+		builder.join();
+
+	EXPECT_EQ(iWrongFiber, 0);
+	EXPECT_EQ(Fiber::GetCurrentFiber(), nullptr);
+	EXPECT_GT(dispatcher.GetFiberPoolTotal(), iFibersBefore);
+}
+
+TEST(Dispatcher, FiberPoolExhaustionRunsJobsInline) {
+
+	// More jobs than the 100 fibers of the pool and its whole overflow reserve hold. Once those are all parked, the
+	// next one on each worker has to run on the worker's own stack, still waiting on the gate, or it'd never get a
+	// fiber. The ones those workers start while they wait get fibers past the reserve.
+	auto& dispatcher = Dispatcher::GetInstance();
+	const int FiberLimit = 100 * (1 + DefaultFiberOverflowFactor);
+	const int ThreadStackCount = dispatcher.WorkerThreadCount();
+	const int ParkedCount = FiberLimit + 200;
+	DispatcherStats before = dispatcher.GetStats();
+
+	JobCounter gate(1), parked;
+	std::atomic<int> iArrived = { 0 };
+	for (int i = 0; i < ParkedCount; i++) {
+		parked.Increment();
+		dispatcher.AddJob([&]() {
+			iArrived++;
+			dispatcher.WaitForCounter(&gate);
+		}, JobPriority::Normal, &parked);
+	}
+
+	while (iArrived < FiberLimit + ThreadStackCount)
+		std::this_thread::yield();
+	gate.Decrement();
+	dispatcher.WaitForCounter(&parked);
+
+	DispatcherStats after = dispatcher.GetStats();
+	EXPECT_GE(after.iFiberPoolExhaustions - before.iFiberPoolExhaustions, 1u);
+	EXPECT_GE(dispatcher.GetFiberPoolTotal(), (size_t)FiberLimit);
+}
+
+// Yield until the condition holds, or give up after iSeconds so a stuck scheduler fails the test instead of hanging it
+template<class Condition>
+static bool WaitWithTimeout(Condition condition, int iSeconds) {
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(iSeconds);
+	while (condition() == false) {
+		if (std::chrono::steady_clock::now() > deadline)
+			return false;
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+TEST(Dispatcher, ThreadStackWaitsGrowFiberPool) {
+
+	// Every job is queued before the gate opens, more than the fibers and the workers' stacks can hold between them.
+	// Each worker runs one of them on its stack, and while that one waits it starts the rest on fibers added past the
+	// overflow reserve rather than beneath it. The main thread doesn't help, so only the workers run anything.
+	auto& dispatcher = Dispatcher::GetInstance();
+	const int FiberLimit = 100 * (1 + DefaultFiberOverflowFactor);
+	const int ParkedCount = FiberLimit + dispatcher.WorkerThreadCount() + 200;
+
+	// Leaked if the test gives up, so the jobs still waiting on it don't touch a dead stack frame
+	struct Shared {
+		JobCounter gate{ 1 };
+		JobCounter parked;
+		std::atomic<int> iArrived = { 0 };
+	};
+	Shared* pShared = new Shared();
+
+	DispatcherStats before = dispatcher.GetStats();
+	for (int i = 0; i < ParkedCount; i++) {
+		pShared->parked.Increment();
+		dispatcher.AddJob([pShared]() {
+			pShared->iArrived++;
+			Dispatcher::GetInstance().WaitForCounter(&pShared->gate);
+		}, JobPriority::Normal, &pShared->parked);
+	}
+
+	ASSERT_TRUE(WaitWithTimeout([&]() { return pShared->iArrived == ParkedCount; }, 30))
+		<< "Arrived " << pShared->iArrived << " of " << ParkedCount;
+
+	DispatcherStats after = dispatcher.GetStats();
+	EXPECT_GE(after.iFiberPoolExhaustions - before.iFiberPoolExhaustions, 1u);
+	EXPECT_GE(after.iFiberPoolOverruns - before.iFiberPoolOverruns, 1u);
+	EXPECT_GT(dispatcher.GetFiberPoolTotal(), (size_t)FiberLimit);
+	EXPECT_EQ(dispatcher.GetJobQueueDepth(JobPriority::Normal), 0u);
+
+	pShared->gate.Decrement();
+	ASSERT_TRUE(WaitWithTimeout([&]() { return pShared->parked.HasReached(0); }, 30));
+	dispatcher.WaitForCounter(&pShared->parked);
+	delete pShared;
+}
+
+// One link of a chain of jobs, each queueing the next and waiting for it
+static void RunWaitChain(int iDepth, int iChainDepth, std::atomic<int>* pReached) {
+
+	pReached->store(iDepth);
+	if (iDepth == iChainDepth)
+		return;
+
+	auto hNext = Dispatcher::GetInstance().AddJob([iDepth, iChainDepth, pReached]() {
+		RunWaitChain(iDepth + 1, iChainDepth, pReached);
+	});
+	Dispatcher::GetInstance().WaitForJob(hNext);
+}
+
+TEST(Dispatcher, NestedWaitChainPastFiberPool) {
+
+	// Deeper than every fiber the pool can hold, plus a stack full of nested jobs on each worker. Past the pool's
+	// limit, the job a waiter on a worker's stack depends on still has to start somewhere.
+	auto& dispatcher = Dispatcher::GetInstance();
+	const int FiberLimit = (std::max)(100 * (1 + DefaultFiberOverflowFactor), (int)dispatcher.GetFiberPoolTotal());
+	const int ChainDepth = FiberLimit + dispatcher.WorkerThreadCount() * Dispatcher::MaxThreadStackDepth + 20;
+
+	// Leaked if the test gives up, so the jobs still waiting on it don't touch a dead stack frame
+	struct Shared {
+		JobCounter done;
+		std::atomic<int> iReached = { 0 };
+	};
+	Shared* pShared = new Shared();
+
+	pShared->done.Increment();
+	dispatcher.AddJob([pShared, ChainDepth]() {
+		RunWaitChain(0, ChainDepth, &pShared->iReached);
+	}, JobPriority::Normal, &pShared->done);
+
+	ASSERT_TRUE(WaitWithTimeout([&]() { return pShared->done.HasReached(0); }, 30))
+		<< "Reached " << pShared->iReached << " of " << ChainDepth;
+	dispatcher.WaitForCounter(&pShared->done);
+
+	EXPECT_EQ(pShared->iReached, ChainDepth);
+	delete pShared;
+}
+
+TEST(Dispatcher, HighPriorityRunsFirst) {
+
+	PriorityData data;
+
+	auto hJob = Dispatcher::GetInstance().AddJob(PrioritySubmitJob, &data);
+	Dispatcher::GetInstance().WaitForJob(hJob);
+
+	EXPECT_EQ(data.iLowRunCount, FanOutCount);
+	EXPECT_GE(data.iLowSeenByHigh, 0);
+	EXPECT_LT(data.iLowSeenByHigh, FanOutCount / 2);
+	EXPECT_EQ(Dispatcher::GetInstance().GetJobQueueDepth(JobPriority::Low), 0);
+}
+
+TEST(Dispatcher, LambdaJob) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	std::atomic<int> iRunCount = { 0 };
+	int iValue = 0;
+
+	auto hJob = dispatcher.AddJob([&iRunCount, &iValue]() {
+		iValue = 42;
+		iRunCount++;
+	});
+	dispatcher.WaitForJob(hJob);
+
+	EXPECT_EQ(iRunCount, 1);
+	EXPECT_EQ(iValue, 42);
+}
+
+static void RunLambdaJobs(int iCount, std::atomic<int64_t>& iTotal) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	for (int i = 0; i < iCount; i++) {
+
+		// 40 bytes of captures, more than std::function's small buffer
+		int64_t a = i, b = 1, c = 2, d = 3;
+		auto hJob = dispatcher.AddJob([a, b, c, d, &iTotal]() {
+
+			// Spawn and park on a child too, so the worker side of the scheduler is exercised
+			auto hChild = Dispatcher::GetInstance().AddJob([a, &iTotal]() { iTotal += a; });
+			Dispatcher::GetInstance().WaitForJob(hChild);
+
+			iTotal += b + c + d;
+		});
+		dispatcher.WaitForJob(hJob);
+	}
+}
+
+TEST(Dispatcher, SteadyStateJobsDontAllocate) {
+
+	const int JobCount = 100;
+	std::atomic<int64_t> iTotal = { 0 };
+
+	// Let the pools and queues grow to what this workload needs
+	RunLambdaJobs(JobCount, iTotal);
+
+	iTotal = 0;
+	s_iAllocationCount = 0;
+	s_bCountAllocations = true;
+
+	RunLambdaJobs(JobCount, iTotal);
+
+	s_bCountAllocations = false;
+
+	EXPECT_EQ(iTotal, (int64_t)JobCount * (JobCount - 1) / 2 + JobCount * 6);
+	EXPECT_EQ(s_iAllocationCount, 0);
+}
+
+TEST(Dispatcher, GraphReRunDoesntAllocate) {
+
+	const int NodeCount = 100;
+	std::atomic<int> iRunCount = { 0 };
+
+	// A chain with a fan-out off every link
+	JobGraph graph;
+	for (int i = 0; i < NodeCount; i++) {
+		graph.AddNode(IncrementJob, &iRunCount);
+		if (i >= 2)
+			graph.AddEdge(i - 2, i);
+	}
+
+	// The first run sets the graph up
+	JobCounter counter;
+	Dispatcher::GetInstance().RunGraph(graph, &counter);
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	s_iAllocationCount = 0;
+	s_bCountAllocations = true;
+
+	for (int i = 0; i < 10; i++) {
+		Dispatcher::GetInstance().RunGraph(graph, &counter);
+		Dispatcher::GetInstance().WaitForCounter(&counter);
+	}
+
+	s_bCountAllocations = false;
+
+	EXPECT_EQ(iRunCount, NodeCount * 11);
+	EXPECT_EQ(s_iAllocationCount, 0);
+}
+
+static int64_t RunFutureJobs(int iCount) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	// Gathered from a job, with WhenAll() and with Get() on its own
+	auto root = dispatcher.AddJob<int64_t>([iCount, &dispatcher]() {
+		JobFuture<int64_t> parts[8];
+		int64_t iTotal = 0;
+		for (int i = 0; i < iCount; i++) {
+			for (int j = 0; j < 8; j++)
+				parts[j] = dispatcher.AddJob<int64_t>([i, j]() { return (int64_t)i * j; });
+
+			WhenAll(parts);
+			for (auto& part : parts)
+				iTotal += part.Get();
+		}
+		return iTotal;
+	});
+
+	return root.Get();
+}
+
+TEST(Dispatcher, FutureResultsDontAllocate) {
+
+	const int RoundCount = 100;
+	const int64_t Expected = (int64_t)RoundCount * (RoundCount - 1) / 2 * 28;
+
+	// Let the pools and queues grow to what this workload needs
+	EXPECT_EQ(RunFutureJobs(RoundCount), Expected);
+
+	s_iAllocationCount = 0;
+	s_bCountAllocations = true;
+
+	int64_t iTotal = RunFutureJobs(RoundCount);
+
+	s_bCountAllocations = false;
+
+	EXPECT_EQ(iTotal, Expected);
+	EXPECT_EQ(s_iAllocationCount, 0);
+}
+
+TEST(Dispatcher, LargeStackJob) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	// More stack than a small fiber would have. The future keeps the job out of the pool until we've looked at it.
+	auto future = dispatcher.AddJob<int>([]() {
+		volatile char buffer[256 * 1024];
+		for (size_t i = 0; i < sizeof(buffer); i += 4096)
+			buffer[i] = 1;
+
+		int iSum = 0;
+		for (size_t i = 0; i < sizeof(buffer); i += 4096)
+			iSum += buffer[i];
+		return iSum;
+	}, JobPriority::Normal, nullptr, StackClass::Large);
+	future.Wait();
+
+	EXPECT_EQ(future.GetHandle()->GetStackClass(), StackClass::Large);
+	EXPECT_EQ(future.Get(), 256 / 4);
+}
+
+// Wait (up to a few seconds) for every worker to run out of work and go to sleep
+static bool WaitForWorkersToSleep() {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	for (int i = 0; i < 5000; i++) {
+		if (dispatcher.GetSleepingWorkerCount() == dispatcher.WorkerThreadCount())
+			return true;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return false;
+}
+
+// WaitForCounter() would run the work on this thread, these tests need a worker to do it
+static void WaitWithoutHelping(JobCounter* pCounter) {
+	while (pCounter->HasReached(0) == false)
+		std::this_thread::yield();
+}
+
+TEST(Dispatcher, IdleWorkersSleep) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	ASSERT_TRUE(WaitForWorkersToSleep());
+
+	// Submitting a job wakes one up. Waited on through a counter of our own, the job is recycled once it's done.
+	std::atomic<int> iRunCount = { 0 };
+	JobCounter counter(1);
+	dispatcher.AddJob(IncrementJob, &iRunCount, &counter);
+	WaitWithoutHelping(&counter);
+	EXPECT_EQ(iRunCount, 1);
+}
+
+TEST(Dispatcher, SleepingWorkersWakeForReadyFibers) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	JobCounter gate(1), counter(1);
+	std::atomic<bool> bPassedGate = { false };
+
+	dispatcher.AddJob([&gate, &bPassedGate]() {
+		Dispatcher::GetInstance().WaitForCounter(&gate);
+		bPassedGate = true;
+	}, JobPriority::Normal, &counter);
+
+	// The job is parked on the gate and the workers have nothing left to do
+	ASSERT_TRUE(WaitForWorkersToSleep());
+	EXPECT_FALSE(bPassedGate);
+
+	// Opening the gate from this thread puts the fiber on the global ready list, which has to wake a worker
+	gate.Decrement();
+	WaitWithoutHelping(&counter);
+	EXPECT_TRUE(bPassedGate);
+}
+
+// Spins until flag is set, or gives up after a few seconds
+static bool SpinUntil(std::atomic<bool>& flag) {
+	auto giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (flag == false) {
+		if (std::chrono::steady_clock::now() > giveUp)
+			return false;
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+TEST(Dispatcher, WaitingThreadRunsJobs) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	std::thread::id mainThread = std::this_thread::get_id();
+	std::atomic<bool> bRanOnMain = { false };
+	std::atomic<int> iTimedOut = { 0 };
+
+	// One more job than there are workers. Each worker is stuck in whichever it took until one runs on this
+	// thread, so the last can only finish if WaitForCounter() runs it here.
+	JobCounter counter;
+	for (int i = 0; i < dispatcher.WorkerThreadCount() + 1; i++) {
+		counter.Increment();
+		dispatcher.AddJob([&]() {
+			if (std::this_thread::get_id() == mainThread)
+				bRanOnMain = true;
+			else if (SpinUntil(bRanOnMain) == false)
+				iTimedOut++;
+		}, JobPriority::Normal, &counter);
+	}
+
+	dispatcher.WaitForCounter(&counter);
+
+	EXPECT_TRUE(bRanOnMain);
+	EXPECT_EQ(iTimedOut, 0);
+}
+
+TEST(Dispatcher, WaitForJobRunsInline) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	std::thread::id mainThread = std::this_thread::get_id();
+
+	// Keep every worker busy, so nobody else can start the job
+	std::atomic<bool> bRelease = { false };
+	std::atomic<int> iBusy = { 0 };
+	JobCounter blockers;
+	for (int i = 0; i < dispatcher.WorkerThreadCount(); i++) {
+		blockers.Increment();
+		dispatcher.AddJob([&]() {
+			iBusy++;
+			SpinUntil(bRelease);
+		}, JobPriority::Normal, &blockers);
+	}
+
+	while (iBusy < dispatcher.WorkerThreadCount())
+		std::this_thread::yield();
+
+	std::thread::id ranOn;
+	dispatcher.WaitForJob(dispatcher.AddJob([&]() { ranOn = std::this_thread::get_id(); }), true);
+	EXPECT_EQ(ranOn, mainThread);
+
+	// The job is still queued. Whoever pops it has to skip it rather than run it again.
+	bRelease = true;
+	dispatcher.WaitForCounter(&blockers);
+
+	JobCounter after;
+	after.Increment();
+	dispatcher.AddJob([]() {}, JobPriority::Normal, &after);
+	dispatcher.WaitForCounter(&after);
+
+	EXPECT_EQ(dispatcher.GetJobQueueDepth(), 0u);
+}
+
+TEST(Dispatcher, StatsCountJobs) {
+
+	const int JobCount = 256;
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	DispatcherStats before = dispatcher.GetStats();
+
+	JobCounter counter;
+	dispatcher.AddJobs(std::vector<JobDecl>(JobCount, { [](void*) {}, nullptr }), &counter);
+	dispatcher.WaitForCounter(&counter);
+
+	DispatcherStats after = dispatcher.GetStats();
+
+	// Every job is counted before its counter is decremented, whichever thread ran it
+	EXPECT_GE(after.iJobsExecuted - before.iJobsExecuted, (uint64_t)JobCount);
+	EXPECT_GE(after.iFiberSwitches - before.iFiberSwitches, (uint64_t)JobCount);
+	EXPECT_GE(after.GetQueueWaitSampleCount() - before.GetQueueWaitSampleCount(), (uint64_t)(JobCount / Dispatcher::QueueWaitSampleInterval));
+	EXPECT_GT(after.GetQueueWaitPercentile(50), 0u);
+
+	EXPECT_GT(after.iJobPoolHighWaterMark, 0);
+	EXPECT_LE(after.iJobPoolHighWaterMark, (int)dispatcher.GetFreeJobTotal());
+	EXPECT_GT(after.iFiberPoolHighWaterMark[(int)StackClass::Small], 0);
+	EXPECT_LE(after.iFiberPoolHighWaterMark[(int)StackClass::Small], (int)dispatcher.GetFiberPoolTotal(StackClass::Small));
+}
@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+#include "hustle/Fiber.h"
+#include "FiberContext.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace Hustle;
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+
+// Permissions of the mapping that starts at pAddress, from /proc/self/maps. Empty if it can't be found.
+static std::string MappingPermissions(void* pAddress) {
+
+	std::ifstream maps("/proc/self/maps");
+	std::string line;
+	while (std::getline(maps, line)) {
+		std::istringstream fields(line);
+		std::string range, permissions;
+		fields >> range >> permissions;
+
+		if (std::stoull(range.substr(0, range.find('-')), nullptr, 16) == (uintptr_t)pAddress)
+			return permissions;
+	}
+
+	return "";
+}
+
+static void NeverRun(void*) {
+}
+
+TEST(Fiber, StackHasGuardPage) {
+
+	const size_t StackSize = 64 * 1024;
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+	Context::FiberContext* pContext = Context::Create(StackSize, NeverRun, nullptr);
+	ASSERT_NE(pContext, nullptr);
+	EXPECT_EQ(pContext->stackSize, StackSize + pageSize);
+
+#if defined(__linux__)
+	// The lowest page of the mapping is inaccessible, the stack above it is read/write
+	EXPECT_EQ(MappingPermissions(pContext->pStack).substr(0, 3), "---");
+	EXPECT_EQ(MappingPermissions((char*)pContext->pStack + pageSize).substr(0, 3), "rw-");
+#endif
+
+	Context::Destroy(pContext);
+}
+
+#endif
+
+TEST(Fiber, StackSize) {
+
+	// Neither fiber is ever switched into, so only address space is reserved
+	Fiber smallFiber(64 * 1024);
+	Fiber defaultFiber;
+
+	EXPECT_NE(smallFiber.GetFiberHandle(), nullptr);
+	EXPECT_NE(defaultFiber.GetFiberHandle(), nullptr);
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+	EXPECT_LT(((Context::FiberContext*)smallFiber.GetFiberHandle())->stackSize,
+			  ((Context::FiberContext*)defaultFiber.GetFiberHandle())->stackSize);
+#endif
+}
@@ -0,0 +1,272 @@
+#include "gtest/gtest.h"
+#include "hustle/Dispatcher.h"
+#include "hustle/FiberSync.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace Hustle;
+
+// The Dispatcher is brought up by the environment in Dispatcher.cpp, with 2 workers
+
+const int JobCount = 100;
+
+TEST(FiberSync, MutexProtectsData) {
+
+	FiberMutex mutex;
+	int iTotal = 0;
+	JobCounter counter;
+
+	for (int i = 0; i < JobCount; i++) {
+		counter.Increment();
+		Dispatcher::GetInstance().AddJob([&]() {
+			for (int j = 0; j < 10; j++) {
+				std::lock_guard<FiberMutex> lock(mutex);
+
+				// Give other jobs a chance to run into the held lock
+				int iValue = iTotal;
+				Dispatcher::GetInstance().YieldToScheduler();
+				iTotal = iValue + 1;
+			}
+		}, JobPriority::Normal, &counter);
+	}
+
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	EXPECT_EQ(iTotal, JobCount * 10);
+}
+
+TEST(FiberSync, ContendedLockFreesTheWorker) {
+
+	FiberMutex mutex;
+	std::atomic<int> iLocked = { 0 };
+	JobCounter lockers;
+
+	// Held by this thread, so every job below has to wait
+	mutex.Lock();
+
+	// More jobs than workers. If they spun, nothing else could run until the unlock.
+	for (int i = 0; i < 10; i++) {
+		lockers.Increment();
+		Dispatcher::GetInstance().AddJob([&]() {
+			mutex.Lock();
+			iLocked++;
+			mutex.Unlock();
+		}, JobPriority::Normal, &lockers);
+	}
+
+	std::atomic<bool> bRan = { false };
+	Dispatcher::GetInstance().WaitForJob(Dispatcher::GetInstance().AddJob([&]() { bRan = true; }));
+
+	EXPECT_TRUE(bRan);
+	EXPECT_EQ(iLocked, 0);
+
+	mutex.Unlock();
+	Dispatcher::GetInstance().WaitForCounter(&lockers);
+
+	EXPECT_EQ(iLocked, 10);
+}
+
+TEST(FiberSync, SemaphoreLimitsConcurrency) {
+
+	const int Units = 3;
+
+	FiberSemaphore semaphore(Units);
+	std::atomic<int> iInside = { 0 };
+	std::atomic<int> iMaxInside = { 0 };
+	JobCounter counter;
+
+	for (int i = 0; i < JobCount; i++) {
+		counter.Increment();
+		Dispatcher::GetInstance().AddJob([&]() {
+			semaphore.Acquire();
+
+			int iNow = ++iInside;
+			int iMax = iMaxInside;
+			while (iNow > iMax && iMaxInside.compare_exchange_weak(iMax, iNow) == false) {}
+
+			Dispatcher::GetInstance().YieldToScheduler();
+
+			iInside--;
+			semaphore.Release();
+		}, JobPriority::Normal, &counter);
+	}
+
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	EXPECT_LE(iMaxInside, Units);
+	EXPECT_GT(iMaxInside, 0);
+	EXPECT_EQ(semaphore.GetCount(), Units);
+}
+
+TEST(FiberSync, EventReleasesEveryWaiter) {
+
+	FiberEvent event;
+	std::atomic<int> iWoken = { 0 };
+	JobCounter counter;
+
+	for (int i = 0; i < JobCount; i++) {
+		counter.Increment();
+		Dispatcher::GetInstance().AddJob([&]() {
+			event.Wait();
+			iWoken++;
+		}, JobPriority::Normal, &counter);
+	}
+
+	// Let them all reach the event
+	while (Dispatcher::GetInstance().GetJobQueueDepth() > 0)
+		std::this_thread::yield();
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	EXPECT_EQ(iWoken, 0);
+
+	event.Set();
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	EXPECT_EQ(iWoken, JobCount);
+
+	// Stays set until Reset()
+	event.Wait();
+	event.Reset();
+	EXPECT_FALSE(event.IsSet());
+}
+
+// More jobs than the fiber pool and its overflow reserve hold (see FiberPoolExhaustionRunsJobsInline in
+// Dispatcher.cpp). The first extra one on each worker waits on the worker's own stack, and the rest on fibers added
+// past the reserve. There are more of them than the workers could nest on their stacks, and all have to get to run.
+const int FiberLimit = 100 * (1 + DefaultFiberOverflowFactor);
+
+TEST(FiberSync, EventWithFiberPoolExhausted) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	const int ThreadStackCount = dispatcher.WorkerThreadCount() * Dispatcher::MaxThreadStackDepth;
+
+	FiberEvent event;
+	JobCounter counter;
+	std::atomic<int> iArrived = { 0 };
+	for (int i = 0; i < FiberLimit + ThreadStackCount; i++) {
+		counter.Increment();
+		dispatcher.AddJob([&]() {
+			iArrived++;
+			event.Wait();
+		}, JobPriority::Normal, &counter);
+	}
+
+	while (iArrived < FiberLimit + ThreadStackCount)
+		std::this_thread::yield();
+	event.Set();
+	dispatcher.WaitForCounter(&counter);
+}
+
+TEST(FiberSync, MutexWithFiberPoolExhausted) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	const int ThreadStackCount = dispatcher.WorkerThreadCount() * Dispatcher::MaxThreadStackDepth;
+
+	FiberMutex mutex;
+	JobCounter counter;
+	std::atomic<int> iArrived = { 0 };
+	int iTotal = 0;
+
+	mutex.Lock();
+	for (int i = 0; i < FiberLimit + ThreadStackCount; i++) {
+		counter.Increment();
+		dispatcher.AddJob([&]() {
+			iArrived++;
+			std::lock_guard<FiberMutex> lock(mutex);
+			iTotal++;
+		}, JobPriority::Normal, &counter);
+	}
+
+	while (iArrived < FiberLimit + ThreadStackCount)
+		std::this_thread::yield();
+	mutex.Unlock();
+	dispatcher.WaitForCounter(&counter);
+
+	EXPECT_EQ(iTotal, FiberLimit + ThreadStackCount);
+}
+
+TEST(FiberSync, MutexHeldAcrossThreadStackWait) {
+
+	// With every fiber parked, a job on a worker's stack takes the mutex and waits. Jobs queued meanwhile that want
+	// the mutex mustn't start beneath it on the same stack, or it could never get back to unlock it.
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	// Leaked if the test gives up, so the jobs still waiting on it don't touch a dead stack frame
+	struct Shared {
+		FiberMutex mutex;
+		JobCounter gate{ 1 };
+		JobCounter release{ 1 };
+		JobCounter jobs;
+		std::atomic<int> iParked = { 0 };
+		std::atomic<bool> bHolding = { false };
+		int iTotal = 0;
+	};
+	Shared* pShared = new Shared();
+
+	auto waitFor = [](auto condition) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+		while (condition() == false) {
+			if (std::chrono::steady_clock::now() > deadline)
+				return false;
+			std::this_thread::yield();
+		}
+		return true;
+	};
+
+	for (int i = 0; i < FiberLimit; i++) {
+		pShared->jobs.Increment();
+		dispatcher.AddJob([pShared]() {
+			pShared->iParked++;
+			Dispatcher::GetInstance().WaitForCounter(&pShared->gate);
+		}, JobPriority::Normal, &pShared->jobs);
+	}
+	ASSERT_TRUE(waitFor([&]() { return pShared->iParked == FiberLimit; }));
+
+	pShared->jobs.Increment();
+	dispatcher.AddJob([pShared]() {
+		std::lock_guard<FiberMutex> lock(pShared->mutex);
+		pShared->bHolding = true;
+		Dispatcher::GetInstance().WaitForCounter(&pShared->release);
+		pShared->iTotal++;
+	}, JobPriority::Normal, &pShared->jobs);
+	ASSERT_TRUE(waitFor([&]() { return pShared->bHolding.load(); }));
+
+	// More than the other workers could take between them if they nested jobs on their stacks
+	const int LockerCount = dispatcher.WorkerThreadCount() * Dispatcher::MaxThreadStackDepth;
+	for (int i = 0; i < LockerCount; i++) {
+		pShared->jobs.Increment();
+		dispatcher.AddJob([pShared]() {
+			std::lock_guard<FiberMutex> lock(pShared->mutex);
+			pShared->iTotal++;
+		}, JobPriority::Normal, &pShared->jobs);
+	}
+
+	// Give the holder's worker time to take the lockers, then let it go
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	pShared->release.Decrement();
+	pShared->gate.Decrement();
+	ASSERT_TRUE(waitFor([&]() { return pShared->jobs.HasReached(0); }));
+	dispatcher.WaitForCounter(&pShared->jobs);
+
+	EXPECT_EQ(pShared->iTotal, LockerCount + 1);
+	delete pShared;
+}
+
+TEST(FiberSync, EventOutsideJobs) {
+
+	FiberEvent event;
+
+	std::thread setter([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		event.Set();
+	});
+
+	event.Wait();
+	EXPECT_TRUE(event.IsSet());
+
+	setter.join();
+}
@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+#include "hustle/InlineFunction.h"
+
+#include <memory>
+
+using namespace Hustle;
+
+typedef InlineFunction<int(int), 48> IntFunction;
+
+static int Double(int i) {
+	return i * 2;
+}
+
+TEST(InlineFunction, Empty) {
+
+	IntFunction fn;
+	EXPECT_FALSE(fn);
+
+	fn = Double;
+	EXPECT_TRUE(fn);
+
+	fn = nullptr;
+	EXPECT_FALSE(fn);
+}
+
+TEST(InlineFunction, FunctionPointer) {
+
+	IntFunction fn(Double);
+	EXPECT_EQ(fn(21), 42);
+}
+
+TEST(InlineFunction, Captures) {
+
+	// Bigger than std::function's small buffer on the common implementations
+	int64_t a = 1, b = 2, c = 3, d = 4, e = 5;
+	IntFunction fn([a, b, c, d, e](int i) { return (int)(a + b + c + d + e) + i; });
+
+	EXPECT_EQ(fn(0), 15);
+	EXPECT_LE(sizeof(IntFunction), (size_t)64);
+}
+
+TEST(InlineFunction, CopyAndMove) {
+
+	int iBase = 10;
+	IntFunction fn([iBase](int i) { return iBase + i; });
+
+	IntFunction copy(fn);
+	EXPECT_EQ(copy(1), 11);
+	EXPECT_EQ(fn(2), 12);
+
+	IntFunction moved(std::move(fn));
+	EXPECT_EQ(moved(3), 13);
+	EXPECT_FALSE(fn);
+
+	fn = moved;
+	EXPECT_EQ(fn(4), 14);
+}
+
+TEST(InlineFunction, DestroysCaptures) {
+
+	auto pShared = std::make_shared<int>(7);
+	{
+		IntFunction fn([pShared](int i) { return *pShared + i; });
+		EXPECT_EQ(pShared.use_count(), 2);
+
+		IntFunction copy(fn);
+		EXPECT_EQ(pShared.use_count(), 3);
+
+		copy = nullptr;
+		EXPECT_EQ(pShared.use_count(), 2);
+	}
+
+	EXPECT_EQ(pShared.use_count(), 1);
+}
+
+TEST(InlineFunction, MoveOnlyCaptureDoesntConvert) {
+
+	// Copying one would have nothing to copy the target with, so it's a compile error rather than a runtime one
+	auto pValue = std::make_unique<int>(5);
+	auto moveOnly = [pValue = std::move(pValue)](int i) { return *pValue + i; };
+	EXPECT_FALSE((std::is_constructible<IntFunction, decltype(moveOnly)>::value));
+
+	// Shared ownership is the way to hand one over
+	std::shared_ptr<int> pShared = std::make_shared<int>(5);
+	IntFunction fn([pShared](int i) { return *pShared + i; });
+	IntFunction moved(std::move(fn));
+	EXPECT_EQ(moved(1), 6);
+}
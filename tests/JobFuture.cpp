@@ -0,0 +1,172 @@
+#include "gtest/gtest.h"
+#include "hustle/JobFuture.h"
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+// The Dispatcher is brought up for the whole binary by the environment in tests/Dispatcher.cpp
+
+TEST(JobFuture, ReturnsValue) {
+
+	auto future = Dispatcher::GetInstance().AddJob<int>([]() { return 42; });
+	EXPECT_TRUE(future.IsValid());
+	EXPECT_EQ(future.Get(), 42);
+	EXPECT_FALSE(future.IsValid());
+}
+
+TEST(JobFuture, Void) {
+
+	std::atomic<int> iRunCount = { 0 };
+	auto future = Dispatcher::GetInstance().AddJob<void>([&iRunCount]() { iRunCount++; });
+	future.Get();
+	EXPECT_EQ(iRunCount, 1);
+}
+
+TEST(JobFuture, LargeResult) {
+
+	// Too big for the job, so it goes on the heap
+	typedef std::array<int, 64> Big;
+	static_assert(Job::IsInlineResult<Big> == false, "Expected a result that doesn't fit in the job");
+
+	auto future = Dispatcher::GetInstance().AddJob<Big>([]() {
+		Big big;
+		for (int i = 0; i < (int)big.size(); i++)
+			big[i] = i;
+		return big;
+	});
+
+	Big big = future.Get();
+	EXPECT_EQ(big[0], 0);
+	EXPECT_EQ(big[63], 63);
+}
+
+struct Counted {
+	explicit Counted(std::atomic<int>* pLive) : pLive(pLive) { (*pLive)++; }
+	Counted(Counted&& other) noexcept : pLive(other.pLive) { (*pLive)++; }
+	~Counted() { (*pLive)--; }
+	std::atomic<int>* pLive;
+};
+
+TEST(JobFuture, ResultIsDestroyed) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	std::atomic<int> iLive = { 0 };
+
+	// Taken with Get()
+	{
+		auto future = dispatcher.AddJob<Counted>([&iLive]() { return Counted(&iLive); });
+		Counted result = future.Get();
+		EXPECT_EQ(iLive, 1);
+	}
+	EXPECT_EQ(iLive, 0);
+
+	// Dropped before the job is done. Whichever of the job and the future lets go last destroys it.
+	JobCounter gate(1);
+	{
+		auto future = dispatcher.AddJob<Counted>([&dispatcher, &iLive, &gate]() {
+			dispatcher.WaitForCounter(&gate);
+			return Counted(&iLive);
+		});
+	}
+
+	JobCounter done;
+	done.Increment();
+	dispatcher.AddJob([&gate]() { gate.Decrement(); }, JobPriority::Normal, &done);
+	dispatcher.WaitForCounter(&done);
+
+	while (iLive != 0)
+		std::this_thread::yield();
+}
+
+TEST(JobFuture, GetFromJob) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	// Gathering inside a job parks its fiber until each result is in
+	auto future = dispatcher.AddJob<int>([&dispatcher]() {
+		std::vector<JobFuture<int>> parts;
+		for (int i = 0; i < 100; i++)
+			parts.push_back(dispatcher.AddJob<int>([i]() { return i; }));
+
+		int iSum = 0;
+		for (auto& part : parts)
+			iSum += part.Get();
+		return iSum;
+	});
+
+	EXPECT_EQ(future.Get(), 100 * 99 / 2);
+}
+
+TEST(JobFuture, WhenAll) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	auto number = dispatcher.AddJob<int>([]() { return 7; });
+	auto text = dispatcher.AddJob<std::string>([]() { return std::string("seven"); });
+	WhenAll(number, text);
+	EXPECT_TRUE(number.IsReady());
+	EXPECT_TRUE(text.IsReady());
+	EXPECT_EQ(number.Get(), 7);
+	EXPECT_EQ(text.Get(), "seven");
+
+	// More than fit on the stack, from inside a job
+	auto sum = dispatcher.AddJob<int>([&dispatcher]() {
+		std::vector<JobFuture<int>> parts;
+		for (int i = 0; i < 200; i++)
+			parts.push_back(dispatcher.AddJob<int>([i]() { return i; }));
+
+		WhenAll(parts);
+
+		int iSum = 0;
+		for (auto& part : parts) {
+			EXPECT_TRUE(part.IsReady());
+			iSum += part.Get();
+		}
+		return iSum;
+	});
+
+	EXPECT_EQ(sum.Get(), 200 * 199 / 2);
+}
+
+TEST(JobFuture, WhenAny) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	// The first job can't finish until after WhenAny() returns
+	JobCounter gate(1);
+	auto slow = dispatcher.AddJob<int>([&dispatcher, &gate]() {
+		dispatcher.WaitForCounter(&gate);
+		return 1;
+	});
+	auto fast = dispatcher.AddJob<int>([]() { return 2; });
+
+	EXPECT_EQ(WhenAny(slow, fast), 1);
+	EXPECT_EQ(fast.Get(), 2);
+
+	gate.Decrement();
+	EXPECT_EQ(slow.Get(), 1);
+
+	// Waiters left on unfinished jobs are taken back before WhenAny() returns
+	for (int iRound = 0; iRound < 20; iRound++) {
+
+		JobCounter roundGate(1);
+		std::vector<JobFuture<int>> futures;
+		for (int i = 0; i < 40; i++) {
+			futures.push_back(dispatcher.AddJob<int>([&dispatcher, &roundGate, i]() {
+				if (i != 0)
+					dispatcher.WaitForCounter(&roundGate);
+				return i;
+			}));
+		}
+
+		EXPECT_EQ(WhenAny(futures), 0);
+
+		roundGate.Decrement();
+		WhenAll(futures);
+	}
+}
@@ -0,0 +1,199 @@
+#include "gtest/gtest.h"
+#include "hustle/Dispatcher.h"
+#include "hustle/JobGraph.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace Hustle;
+
+// The Dispatcher is brought up by the environment in Dispatcher.cpp
+
+// Every node records when it started and finished, on one shared clock
+struct NodeTimes {
+	std::atomic<int>* pClock;
+	int iStart = -1;
+	int iFinish = -1;
+	int iRunCount = 0;
+};
+
+static void TimedNode(void* pUserData) {
+	NodeTimes* pTimes = (NodeTimes*)pUserData;
+	pTimes->iStart = pTimes->pClock->fetch_add(1);
+	pTimes->iRunCount++;
+	pTimes->iFinish = pTimes->pClock->fetch_add(1);
+}
+
+/**
+ * @brief Layers of nodes, each depending on a couple of nodes in the layer before
+*/
+struct LayeredGraph {
+	JobGraph graph;
+	std::atomic<int> clock = { 0 };
+	std::vector<NodeTimes> times;
+	std::vector<std::pair<int, int>> edges;
+
+	// bMixed spreads the nodes over every priority and stack class
+	LayeredGraph(int iWidth, int iDepth, bool bMixed = true) :
+		times(iWidth * iDepth) {
+
+		for (int i = 0; i < iWidth * iDepth; i++) {
+			times[i].pClock = &clock;
+			if (bMixed)
+				graph.AddNode(TimedNode, &times[i], (JobPriority)(i % JobPriorityCount), (StackClass)(i % StackClassCount));
+			else
+				graph.AddNode(TimedNode, &times[i]);
+		}
+
+		for (int iLayer = 1; iLayer < iDepth; iLayer++) {
+			for (int i = 0; i < iWidth; i++) {
+				int iNode = iLayer * iWidth + i;
+				int iBefore = (iLayer - 1) * iWidth;
+				AddEdge(iBefore + i, iNode);
+				if (iWidth > 1)
+					AddEdge(iBefore + (i * 7 + 3) % iWidth, iNode);
+			}
+		}
+	}
+
+	void AddEdge(int iBefore, int iAfter) {
+		for (auto& edge : edges) {
+			if (edge.first == iBefore && edge.second == iAfter)
+				return;
+		}
+
+		graph.AddEdge(iBefore, iAfter);
+		edges.push_back({ iBefore, iAfter });
+	}
+
+	void ExpectOrdered() {
+		for (auto& edge : edges)
+			EXPECT_LT(times[edge.first].iFinish, times[edge.second].iStart);
+	}
+};
+
+TEST(JobGraph, Diamond) {
+
+	std::atomic<int> clock = { 0 };
+	NodeTimes times[4];
+	for (auto& nodeTimes : times)
+		nodeTimes.pClock = &clock;
+
+	JobGraph graph;
+	auto top = graph.AddNode(TimedNode, &times[0]);
+	auto left = graph.AddNode(TimedNode, &times[1]);
+	auto right = graph.AddNode(TimedNode, &times[2]);
+	auto bottom = graph.AddNode(TimedNode, &times[3]);
+	graph.AddEdge(top, left);
+	graph.AddEdge(top, right);
+	graph.AddEdge(left, bottom);
+	graph.AddEdge(right, bottom);
+
+	JobCounter counter;
+	EXPECT_TRUE(Dispatcher::GetInstance().RunGraph(graph, &counter));
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	EXPECT_EQ(times[0].iStart, 0);
+	EXPECT_LT(times[0].iFinish, times[1].iStart);
+	EXPECT_LT(times[0].iFinish, times[2].iStart);
+	EXPECT_LT(times[1].iFinish, times[3].iStart);
+	EXPECT_LT(times[2].iFinish, times[3].iStart);
+	EXPECT_EQ(times[3].iFinish, 7);
+}
+
+TEST(JobGraph, ReRun) {
+
+	const int RunCount = 20;
+
+	LayeredGraph layered(16, 16);
+
+	for (int iRun = 0; iRun < RunCount; iRun++) {
+		JobCounter counter;
+		Dispatcher::GetInstance().RunGraph(layered.graph, &counter);
+		Dispatcher::GetInstance().WaitForCounter(&counter);
+
+		layered.ExpectOrdered();
+	}
+
+	for (auto& nodeTimes : layered.times)
+		EXPECT_EQ(nodeTimes.iRunCount, RunCount);
+}
+
+TEST(JobGraph, DeepChain) {
+
+	// Every node can carry on from the one before, so this runs as one long job
+	LayeredGraph layered(1, 1000, false);
+
+	JobCounter counter;
+	Dispatcher::GetInstance().RunGraph(layered.graph, &counter);
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+
+	layered.ExpectOrdered();
+	EXPECT_EQ(layered.clock, 2000);
+}
+
+static void RunGraphJob(void* pUserData) {
+
+	LayeredGraph* pLayered = (LayeredGraph*)pUserData;
+
+	JobCounter counter;
+	Dispatcher::GetInstance().RunGraph(pLayered->graph, &counter);
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+}
+
+TEST(JobGraph, RunFromJob) {
+
+	LayeredGraph layered(32, 4);
+
+	auto hJob = Dispatcher::GetInstance().AddJob(RunGraphJob, &layered);
+	Dispatcher::GetInstance().WaitForJob(hJob);
+
+	layered.ExpectOrdered();
+	for (auto& nodeTimes : layered.times)
+		EXPECT_EQ(nodeTimes.iRunCount, 1);
+}
+
+TEST(JobGraph, EmptyGraph) {
+
+	JobGraph graph;
+	JobCounter counter;
+	Dispatcher::GetInstance().RunGraph(graph, &counter);
+
+	EXPECT_EQ(counter.GetValue(), 0);
+	EXPECT_TRUE(graph.IsAcyclic());
+}
+
+TEST(JobGraph, Cycle) {
+
+	JobGraph graph;
+	auto first = graph.AddNode([]() {});
+	auto second = graph.AddNode([]() {});
+	auto third = graph.AddNode([]() {});
+	graph.AddEdge(first, second);
+	graph.AddEdge(second, third);
+	EXPECT_TRUE(graph.IsAcyclic());
+
+	graph.AddEdge(third, second);
+	EXPECT_FALSE(graph.IsAcyclic());
+}
+
+TEST(JobGraph, RunGraphRefusesCycle) {
+
+	std::atomic<int> iRunCount = { 0 };
+
+	// A root to start from, then a loop nothing can get into
+	JobGraph graph;
+	auto root = graph.AddNode([&iRunCount]() { iRunCount++; });
+	auto second = graph.AddNode([&iRunCount]() { iRunCount++; });
+	auto third = graph.AddNode([&iRunCount]() { iRunCount++; });
+	graph.AddEdge(root, second);
+	graph.AddEdge(second, third);
+	graph.AddEdge(third, second);
+
+	JobCounter counter;
+	EXPECT_FALSE(Dispatcher::GetInstance().RunGraph(graph, &counter));
+	EXPECT_EQ(counter.GetValue(), 0);
+
+	Dispatcher::GetInstance().WaitForCounter(&counter);
+	EXPECT_EQ(iRunCount, 0);
+}
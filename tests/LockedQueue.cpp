@@ -31,4 +31,28 @@ TEST(LockedQueue, EmptyQueue) {
 	LockedQueue<int*> intQueue;
 	EXPECT_EQ(intQueue.Pop(), nullptr);
 	EXPECT_EQ(intQueue.Size(), 0);
-}
\ No newline at end of file
+}
+
+TEST(LockedQueue, Bulk) {
+
+	LockedQueue<int*> intQueue;
+	int intData[MaxQueueSize];
+	int* pItems[MaxQueueSize];
+
+	for (auto i = 0; i < MaxQueueSize; i++) {
+		intData[i] = i;
+		pItems[i] = &intData[i];
+	}
+
+	intQueue.PushBulk(pItems, MaxQueueSize);
+	EXPECT_EQ(intQueue.Size(), MaxQueueSize);
+
+	// Oldest first, and never more than is in the queue
+	EXPECT_EQ(intQueue.PopBulk(pItems, 10), 10u);
+	for (auto i = 0; i < 10; i++)
+		EXPECT_EQ(*pItems[i], i);
+
+	EXPECT_EQ(intQueue.PopBulk(pItems, MaxQueueSize), (size_t)MaxQueueSize - 10);
+	EXPECT_EQ(*pItems[0], 10);
+	EXPECT_EQ(intQueue.Size(), 0);
+}
@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+#include "hustle/Parallel.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+// The Dispatcher is brought up by the environment in tests/Dispatcher.cpp
+
+TEST(Parallel, ForVisitsEveryIndexOnce) {
+
+	const int Count = 100000;
+	std::vector<std::atomic<int>> visits(Count);
+	for (auto& visit : visits)
+		visit = 0;
+
+	ParallelFor(0, Count, 64, [&visits](int i) { visits[i]++; });
+
+	for (int i = 0; i < Count; i++)
+		ASSERT_EQ(visits[i], 1) << "index " << i;
+}
+
+TEST(Parallel, ForEmptyAndTinyRanges) {
+
+	std::atomic<int> iCalls = { 0 };
+	ParallelFor(10, 10, 1, [&iCalls](int) { iCalls++; });
+	ParallelFor(10, 5, 1, [&iCalls](int) { iCalls++; });
+	EXPECT_EQ(iCalls, 0);
+
+	ParallelFor(0, 3, 1, [&iCalls](int) { iCalls++; });
+	EXPECT_EQ(iCalls, 3);
+
+	// Grain of 0 picks one
+	ParallelFor(0, 1000, 0, [&iCalls](int) { iCalls++; });
+	EXPECT_EQ(iCalls, 1003);
+}
+
+TEST(Parallel, ReduceSum) {
+
+	const int64_t Count = 1 << 20;
+
+	int64_t iSum = ParallelReduce((int64_t)0, Count, (int64_t)1000, (int64_t)0,
+		[](int64_t i) { return i; },
+		[](int64_t a, int64_t b) { return a + b; });
+
+	EXPECT_EQ(iSum, Count * (Count - 1) / 2);
+}
+
+TEST(Parallel, ReduceKeepsOrder) {
+
+	// String concatenation is associative but not commutative
+	for (int grain = 1; grain <= 7; grain++) {
+		std::string result = ParallelReduce(0, 26, grain, std::string(),
+			[](int i) { return std::string(1, (char)('a' + i)); },
+			[](const std::string& a, const std::string& b) { return a + b; });
+
+		EXPECT_EQ(result, "abcdefghijklmnopqrstuvwxyz") << "grain " << grain;
+	}
+}
+
+TEST(Parallel, ReduceBool) {
+
+	// Small chunks, so neighbouring partial results are written from different workers at once
+	const int Count = 100000;
+
+	bool bAny = ParallelReduce(0, Count, 4, false,
+		[](int i) { return i == 77777; },
+		[](bool a, bool b) { return a || b; });
+	EXPECT_TRUE(bAny);
+
+	bool bAll = ParallelReduce(0, Count, 4, true,
+		[](int i) { return i != 77777; },
+		[](bool a, bool b) { return a && b; });
+	EXPECT_FALSE(bAll);
+
+	bAll = ParallelReduce(0, Count, 4, true,
+		[](int i) { return i >= 0; },
+		[](bool a, bool b) { return a && b; });
+	EXPECT_TRUE(bAll);
+}
+
+TEST(Parallel, NestedInsideJob) {
+
+	auto& dispatcher = Dispatcher::GetInstance();
+	int64_t iSum = 0;
+
+	// Waiting inside a job parks the fiber rather than blocking the worker
+	auto hJob = dispatcher.AddJob([&iSum]() {
+		iSum = ParallelReduce(0, 10000, 16, (int64_t)0,
+			[](int) {
+				// An inner loop per element
+				std::atomic<int> iInner = { 0 };
+				ParallelFor(0, 4, 1, [&iInner](int) { iInner++; });
+				return (int64_t)iInner;
+			},
+			[](int64_t a, int64_t b) { return a + b; });
+	});
+	dispatcher.WaitForJob(hJob);
+
+	EXPECT_EQ(iSum, 40000);
+}
@@ -1,7 +1,12 @@
 #include "gtest/gtest.h"
+#include "hustle/BoundedMPMCQueue.h"
 #include "hustle/ResourcePool.h"
 
+#include <atomic>
 #include <queue>
+#include <set>
+#include <thread>
+#include <vector>
 
 using namespace Hustle;
 
@@ -119,4 +124,363 @@ TEST(ResourcePool, ArrayOperator) {
 		EXPECT_EQ(pResource->iIndex, i);
 	}
 	
-}
\ No newline at end of file
+}
+TEST(ResourcePool, CacheLineAligned) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	ResourcePool<TestResource> testPool;
+	testPool.Grow(MaxPoolSize);
+
+	// Every resource starts a cache line, and one Grow() is a single contiguous block
+	for (int i = 0; i < MaxPoolSize; i++) {
+		EXPECT_EQ((uintptr_t)testPool[i] % Platform::CacheLineSize, 0u);
+
+		if (i > 0) {
+			EXPECT_EQ((char*)testPool[i] - (char*)testPool[i - 1], (ptrdiff_t)Platform::CacheLineSize);
+		}
+	}
+}
+
+struct StressResource {
+	std::atomic<int> iOwner = { -1 };
+};
+
+TEST(ResourcePool, MultiThreadedStress) {
+
+	const int ThreadCount = 8;
+	const int Iterations = 100000;
+	const int MaxHeld = 48;
+
+	ResourcePool<StressResource> testPool;
+	testPool.Grow(MaxPoolSize);
+	testPool.SetGrowthFactor(1.0f);
+
+	std::atomic<int> iDoubleHandouts = { 0 };
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < ThreadCount; t++) {
+		threads.emplace_back([&, t]() {
+
+			std::vector<StressResource*> held;
+			uint32_t uRandom = 2463534242u + t;
+
+			for (int i = 0; i < Iterations; i++) {
+				uRandom ^= uRandom << 13;
+				uRandom ^= uRandom >> 17;
+				uRandom ^= uRandom << 5;
+
+				bool bGet = held.empty() || (held.size() < MaxHeld && (uRandom & 1));
+				if (bGet) {
+					StressResource* pResource = testPool.Get();
+					ASSERT_NE(pResource, nullptr);
+
+					// Nobody else may own it while we do
+					if (pResource->iOwner.exchange(t) != -1)
+						iDoubleHandouts++;
+
+					held.push_back(pResource);
+				}
+				else {
+					size_t iIndex = uRandom % held.size();
+					StressResource* pResource = held[iIndex];
+					held[iIndex] = held.back();
+					held.pop_back();
+
+					pResource->iOwner = -1;
+					testPool.Release(pResource);
+				}
+			}
+
+			for (auto pResource : held) {
+				pResource->iOwner = -1;
+				testPool.Release(pResource);
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(iDoubleHandouts, 0);
+	EXPECT_EQ(testPool.GetFreeCount(), (size_t)testPool.GetTotalCount());
+}
+
+TEST(ResourcePool, ReleaseOnOtherThread) {
+
+	const int ItemCount = 200000;
+	const int ConsumerCount = 4;
+
+	ResourcePool<StressResource> testPool;
+	testPool.Grow(MaxPoolSize);
+	testPool.SetGrowthFactor(1.0f);
+
+	// Resources are taken on one thread and released on others, like jobs completed by a thief
+	LockedQueue<StressResource*> handoff;
+	std::atomic<int> iReleased = { 0 };
+	std::vector<std::thread> threads;
+
+	threads.emplace_back([&]() {
+		for (int i = 0; i < ItemCount; i++) {
+			StressResource* pResource = testPool.Get();
+			ASSERT_NE(pResource, nullptr);
+			EXPECT_EQ(pResource->iOwner.exchange(0), -1);
+			handoff.Push(pResource);
+		}
+	});
+
+	for (int t = 0; t < ConsumerCount; t++) {
+		threads.emplace_back([&]() {
+			while (iReleased < ItemCount) {
+				StressResource* pResource = handoff.Pop();
+				if (pResource == nullptr) {
+					std::this_thread::yield();
+					continue;
+				}
+
+				pResource->iOwner = -1;
+				testPool.Release(pResource);
+				iReleased++;
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(testPool.GetFreeCount(), (size_t)testPool.GetTotalCount());
+}
+
+TEST(ResourcePool, Constructor) {
+
+	struct TestResource {
+		TestResource(int iValue) : iSomething(iValue) {}
+		int iSomething;
+	};
+
+	ResourcePool<TestResource> testPool;
+	testPool.SetConstructor([](void* pStorage) { return new (pStorage) TestResource(42); });
+	testPool.SetGrowthFactor(1.0f);
+	testPool.Grow(2);
+
+	// Including the ones added when the pool grows itself
+	for (int i = 0; i < 5; i++)
+		EXPECT_EQ(testPool.Get()->iSomething, 42);
+
+	EXPECT_EQ(testPool.GetTotalCount(), 8);
+}
+
+TEST(ResourcePool, ScavengesOtherThreads) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	const int PoolSize = 20;
+
+	// No growth, so every resource has to be found
+	ResourcePool<TestResource> testPool;
+	testPool.Grow(PoolSize);
+
+	// Leave every resource sitting in another thread's magazine
+	std::thread([&]() {
+		TestResource* pResources[PoolSize];
+		for (int i = 0; i < PoolSize; i++)
+			pResources[i] = testPool.Get();
+		for (int i = 0; i < PoolSize; i++)
+			testPool.Release(pResources[i]);
+	}).join();
+
+	for (int i = 0; i < PoolSize; i++)
+		EXPECT_NE(testPool.Get(), nullptr);
+
+	EXPECT_EQ(testPool.Get(), nullptr);
+	EXPECT_EQ(testPool.GetTotalCount(), PoolSize);
+}
+
+TEST(ResourcePool, MoreThreadsThanAMagazineChunk) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	const int ThreadCount = 100;
+	const int PoolSize = ThreadCount * 2;
+
+	ResourcePool<TestResource> testPool;
+	testPool.Grow(PoolSize);
+
+	// Every thread is alive at once, so they hold slots past the first chunk of magazines
+	std::atomic<int> iArrived(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < ThreadCount; t++) {
+		threads.emplace_back([&]() {
+			TestResource* pFirst = testPool.Get();
+			TestResource* pSecond = testPool.Get();
+			EXPECT_NE(pFirst, nullptr);
+			EXPECT_NE(pSecond, nullptr);
+
+			iArrived++;
+			while (iArrived.load() < ThreadCount)
+				std::this_thread::yield();
+
+			testPool.Release(pFirst);
+			testPool.Release(pSecond);
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(testPool.GetFreeCount(), (size_t)PoolSize);
+	for (int i = 0; i < PoolSize; i++)
+		EXPECT_NE(testPool.Get(), nullptr);
+
+	EXPECT_EQ(testPool.Get(), nullptr);
+}
+
+TEST(ResourcePool, GetBulk) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	const int PoolSize = 20;
+
+	ResourcePool<TestResource> testPool;
+	testPool.Grow(PoolSize);
+
+	// Put a few in this thread's magazine, so both places get used
+	TestResource* pResources[PoolSize * 2];
+	for (int i = 0; i < 5; i++)
+		pResources[i] = testPool.Get();
+	for (int i = 0; i < 5; i++)
+		testPool.Release(pResources[i]);
+
+	EXPECT_EQ(testPool.GetBulk(pResources, PoolSize), PoolSize);
+	EXPECT_EQ(testPool.GetFreeCount(), 0);
+
+	std::set<TestResource*> unique(pResources, pResources + PoolSize);
+	EXPECT_EQ(unique.size(), PoolSize);
+
+	// Nothing left and no growth
+	EXPECT_EQ(testPool.GetBulk(pResources, PoolSize), 0);
+
+	// With growth the whole request is met
+	testPool.SetGrowthFactor(1.0f);
+	EXPECT_EQ(testPool.GetBulk(pResources, PoolSize * 2), PoolSize * 2);
+	EXPECT_EQ(testPool.GetTotalCount(), PoolSize * 4);
+}
+
+TEST(ResourcePool, HighWaterMark) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	ResourcePool<TestResource> testPool;
+	testPool.Grow(MaxPoolSize);
+	EXPECT_EQ(testPool.GetHighWaterMark(), 0);
+
+	std::vector<TestResource*> resources;
+	for (int i = 0; i < 40; i++)
+		resources.push_back(testPool.Get());
+
+	// Whatever's left in this thread's magazine counts as in use, so it can be over by up to a batch
+	EXPECT_GE(testPool.GetHighWaterMark(), 40);
+	EXPECT_LE(testPool.GetHighWaterMark(), 40 + ResourcePool<TestResource>::MagazineBatch);
+
+	for (auto pResource : resources)
+		testPool.Release(pResource);
+
+	// The mark stays at the peak
+	int iMark = testPool.GetHighWaterMark();
+	for (int i = 0; i < 10; i++)
+		testPool.Release(testPool.Get());
+	EXPECT_EQ(testPool.GetHighWaterMark(), iMark);
+}
+
+TEST(ResourcePool, MaxCount) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	ResourcePool<TestResource> testPool;
+	testPool.SetGrowthFactor(0.5f);
+	testPool.SetMaxCount(8);
+	testPool.Grow(4);
+
+	// 4, then grown by 2 and by 3, which the cap trims to 2
+	std::vector<TestResource*> resources;
+	for (int i = 0; i < 8; i++) {
+		resources.push_back(testPool.Get());
+		ASSERT_NE(resources.back(), nullptr);
+	}
+	EXPECT_EQ(testPool.GetTotalCount(), 8);
+
+	// Full, so no more until one comes back
+	EXPECT_EQ(testPool.Get(), nullptr);
+	EXPECT_EQ(testPool.GetTotalCount(), 8);
+
+	testPool.Release(resources.back());
+	resources.back() = testPool.Get();
+	EXPECT_NE(resources.back(), nullptr);
+
+	for (auto pResource : resources)
+		testPool.Release(pResource);
+	EXPECT_EQ(testPool.GetFreeCount(), 8u);
+}
+
+TEST(ResourcePool, GetPastMax) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	ResourcePool<TestResource> testPool;
+	testPool.SetGrowthFactor(0.5f);
+	testPool.SetMaxCount(4);
+	testPool.Grow(4);
+
+	// Free ones first, then one more at a time past the cap
+	std::vector<TestResource*> resources;
+	for (int i = 0; i < 6; i++) {
+		resources.push_back(testPool.GetPastMax());
+		ASSERT_NE(resources.back(), nullptr);
+	}
+	EXPECT_EQ(testPool.GetTotalCount(), 6);
+	EXPECT_EQ(testPool.GetHighWaterMark(), 6);
+
+	// Get() still stops at the cap
+	EXPECT_EQ(testPool.Get(), nullptr);
+
+	for (auto pResource : resources)
+		testPool.Release(pResource);
+	EXPECT_EQ(testPool.GetFreeCount(), 6u);
+}
+
+TEST(ResourcePool, BoundedFreeListGrowsPastRing) {
+
+	struct TestResource {
+		int iSomething;
+	};
+
+	// The Dispatcher's job pool under HUSTLE_LOCKFREE_QUEUES: 1024, grown tenfold to 11264, then to 123904
+	ResourcePool<TestResource, BoundedMPMCQueue<TestResource*>> testPool;
+	testPool.SetGrowthFactor(10);
+	testPool.Grow(1024);
+
+	std::vector<TestResource*> resources;
+	for (int i = 0; i < 70000; i++) {
+		resources.push_back(testPool.Get());
+		ASSERT_NE(resources.back(), nullptr);
+	}
+	EXPECT_EQ(testPool.GetTotalCount(), 123904);
+
+	for (auto pResource : resources)
+		testPool.Release(pResource);
+	EXPECT_EQ(testPool.GetFreeCount(), 123904u);
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+#include "hustle/Task.h"
+
+#if defined(HUSTLE_HAS_COROUTINES)
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+// The Dispatcher is brought up for the whole binary by the environment in tests/Dispatcher.cpp
+
+static Task<int> Add(int a, int b) {
+	co_return a + b;
+}
+
+static Task<int> Fibonacci(int n) {
+	if (n < 2)
+		co_return n;
+
+	int a = co_await Fibonacci(n - 1);
+	int b = co_await Fibonacci(n - 2);
+	co_return a + b;
+}
+
+TEST(Task, ReturnsValue) {
+	EXPECT_EQ(Add(1, 2).Get(), 3);
+}
+
+TEST(Task, AwaitsTasks) {
+	EXPECT_EQ(Fibonacci(16).Get(), 987);
+}
+
+static Task<int> AwaitJob(std::atomic<int>* pValue) {
+
+	// A fiber job, waited on without the task holding a fiber
+	JobHandle hJob = Dispatcher::GetInstance().AddJob([pValue]() { pValue->store(42); });
+	co_await hJob;
+	co_return pValue->load();
+}
+
+TEST(Task, AwaitsJobHandle) {
+	std::atomic<int> iValue = { 0 };
+	EXPECT_EQ(AwaitJob(&iValue).Get(), 42);
+}
+
+static Task<> AwaitCounter(std::atomic<int>* pCount, int iJobs) {
+
+	JobCounter counter;
+	std::vector<JobDecl> jobs(iJobs, { [](void* pUserData) { ((std::atomic<int>*)pUserData)->fetch_add(1); }, pCount });
+	Dispatcher::GetInstance().AddJobs(jobs, &counter);
+
+	// Half way, then the rest
+	co_await CounterAwaiter(counter, iJobs / 2);
+	EXPECT_GE(pCount->load(), iJobs / 2);
+
+	co_await counter;
+	EXPECT_EQ(pCount->load(), iJobs);
+}
+
+TEST(Task, AwaitsCounter) {
+	std::atomic<int> iCount = { 0 };
+	AwaitCounter(&iCount, 256).Get();
+	EXPECT_EQ(iCount, 256);
+}
+
+static Task<int> WaitOnGate(JobCounter* pGate, std::atomic<int>* pArrived, int iValue) {
+	pArrived->fetch_add(1);
+	co_await *pGate;
+	co_return iValue;
+}
+
+static Task<int> SumStarted(JobCounter* pGate, std::atomic<int>* pArrived, int iCount) {
+
+	// Started tasks run at the same time, and may finish before or after they're awaited
+	std::vector<Task<int>> tasks;
+	for (int i = 0; i < iCount; i++) {
+		tasks.push_back(WaitOnGate(pGate, pArrived, i));
+		tasks.back().Start();
+	}
+
+	int iSum = 0;
+	for (auto& task : tasks)
+		iSum += co_await task;
+	co_return iSum;
+}
+
+TEST(Task, SuspendedTasksHoldNoFibers) {
+
+	const int TaskCount = 1000;
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	JobCounter gate(1);
+	std::atomic<int> iArrived = { 0 };
+	Task<int> sum = SumStarted(&gate, &iArrived, TaskCount);
+	sum.Start();
+
+	while (iArrived < TaskCount)
+		std::this_thread::yield();
+
+	// Every task is suspended on the gate, and not one of them is sitting on a fiber
+	EXPECT_EQ(dispatcher.GetFiberPoolFree(), dispatcher.GetFiberPoolTotal());
+
+	gate.Decrement();
+	EXPECT_EQ(sum.Get(), TaskCount * (TaskCount - 1) / 2);
+}
+
+TEST(Task, WaitFromFiberJob) {
+
+	// A fiber job parks on a task like on any counter
+	std::atomic<int> iResult = { 0 };
+	auto hJob = Dispatcher::GetInstance().AddJob([&iResult]() { iResult = Fibonacci(10).Get(); });
+	Dispatcher::GetInstance().WaitForJob(hJob);
+	EXPECT_EQ(iResult, 55);
+}
+
+#endif
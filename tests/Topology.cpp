@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+#include "hustle/Dispatcher.h"
+#include "hustle/Topology.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace Hustle;
+
+TEST(Topology, ParseCpuList) {
+
+	std::vector<int> cpus;
+	ASSERT_TRUE(Topology::ParseCpuList("0-3,8-9,16\n", cpus));
+	EXPECT_EQ(cpus, std::vector<int>({ 0, 1, 2, 3, 8, 9, 16 }));
+
+	ASSERT_TRUE(Topology::ParseCpuList("5", cpus));
+	EXPECT_EQ(cpus, std::vector<int>({ 5 }));
+
+	// Memory only nodes list nothing
+	ASSERT_TRUE(Topology::ParseCpuList("\n", cpus));
+	EXPECT_TRUE(cpus.empty());
+
+	EXPECT_FALSE(Topology::ParseCpuList("3-1", cpus));
+	EXPECT_FALSE(Topology::ParseCpuList("0-", cpus));
+	EXPECT_FALSE(Topology::ParseCpuList("a", cpus));
+}
+
+#if defined(HUSTLE_PLATFORM_POSIX)
+
+static void WriteCpuList(const std::filesystem::path& root, const char* szNode, const char* szCpuList) {
+	std::filesystem::create_directories(root / "node" / szNode);
+	std::ofstream(root / "node" / szNode / "cpulist") << szCpuList;
+}
+
+TEST(Topology, ReadSysfs) {
+
+	std::filesystem::path root = std::filesystem::temp_directory_path() / "hustle_topology_test";
+	std::filesystem::remove_all(root);
+
+	// Two sockets with interleaved SMT siblings, a memory only node, and the files that sit next to the nodes
+	WriteCpuList(root, "node0", "0-3,8-11\n");
+	WriteCpuList(root, "node10", "4-7,12-15\n");
+	WriteCpuList(root, "node2", "\n");
+	std::ofstream(root / "node" / "online") << "0,2,10\n";
+
+	Topology topology;
+	ASSERT_TRUE(Topology::ReadSysfs(root.string(), topology));
+	std::filesystem::remove_all(root);
+
+	ASSERT_EQ(topology.GetNodeCount(), 2);
+	EXPECT_EQ(topology.GetNodes()[0].iId, 0);
+	EXPECT_EQ(topology.GetNodes()[1].iId, 10);
+	EXPECT_EQ(topology.GetCpuCount(), 16);
+
+	EXPECT_EQ(topology.GetNodeOfCpu(0), 0);
+	EXPECT_EQ(topology.GetNodeOfCpu(9), 0);
+	EXPECT_EQ(topology.GetNodeOfCpu(4), 1);
+	EXPECT_EQ(topology.GetNodeOfCpu(15), 1);
+	EXPECT_EQ(topology.GetNodeOfCpu(16), -1);
+
+	// No siblings lists, so every CPU is a core of its own
+	EXPECT_EQ(topology.GetCores().size(), 16u);
+	EXPECT_EQ(topology.GetCoreOfCpu(12), 12);
+
+	EXPECT_FALSE(Topology::ReadSysfs((root / "missing").string(), topology));
+}
+
+TEST(Topology, ReadSysfsCores) {
+
+	std::filesystem::path root = std::filesystem::temp_directory_path() / "hustle_topology_cores_test";
+	std::filesystem::remove_all(root);
+
+	// Two cores with two siblings each, and one CPU whose list is missing
+	WriteCpuList(root, "node0", "0-4\n");
+	const char* siblings[] = { "0,2\n", "1,3\n", "0,2\n", "1,3\n" };
+	for (int iCpu = 0; iCpu < 4; iCpu++) {
+		std::filesystem::path dir = root / "cpu" / ("cpu" + std::to_string(iCpu)) / "topology";
+		std::filesystem::create_directories(dir);
+		std::ofstream(dir / "thread_siblings_list") << siblings[iCpu];
+	}
+
+	Topology topology;
+	ASSERT_TRUE(Topology::ReadSysfs(root.string(), topology));
+	std::filesystem::remove_all(root);
+
+	ASSERT_EQ(topology.GetCores().size(), 3u);
+	EXPECT_EQ(topology.GetCores()[0], std::vector<int>({ 0, 2 }));
+	EXPECT_EQ(topology.GetCores()[1], std::vector<int>({ 1, 3 }));
+	EXPECT_EQ(topology.GetCores()[2], std::vector<int>({ 4 }));
+	EXPECT_EQ(topology.GetCoreOfCpu(3), 1);
+	EXPECT_EQ(topology.GetCoreOfCpu(5), -1);
+}
+
+#endif
+
+TEST(Topology, DetectFindsEveryWorker) {
+
+	Topology topology = Topology::Detect();
+	ASSERT_GE(topology.GetNodeCount(), 1);
+	EXPECT_GE(topology.GetCpuCount(), 1);
+
+	// The Dispatcher numbers only the nodes it put workers on
+	auto& dispatcher = Dispatcher::GetInstance();
+	EXPECT_GE(dispatcher.GetNodeCount(), 1);
+	EXPECT_LE(dispatcher.GetNodeCount(), topology.GetNodeCount());
+}
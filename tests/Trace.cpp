@@ -0,0 +1,159 @@
+#include "gtest/gtest.h"
+#include "hustle/Dispatcher.h"
+#include "hustle/Trace.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+
+using namespace Hustle;
+
+// The Dispatcher is brought up by the environment in Dispatcher.cpp, with 2 workers
+
+// The value of a "key":"value" or "key":value field in one event, empty if the event doesn't have it
+static std::string FieldOf(const std::string& event, const std::string& key) {
+	size_t iStart = event.find("\"" + key + "\":");
+	if (iStart == std::string::npos)
+		return "";
+
+	iStart += key.size() + 3;
+	if (event[iStart] == '"')
+		return event.substr(iStart + 1, event.find('"', iStart + 1) - iStart - 1);
+
+	return event.substr(iStart, event.find_first_of(",}", iStart) - iStart);
+}
+
+static size_t CountOf(const std::string& text, const std::string& pattern) {
+	size_t iCount = 0;
+	for (size_t i = text.find(pattern); i != std::string::npos; i = text.find(pattern, i + 1))
+		iCount++;
+	return iCount;
+}
+
+// Every slice on a thread ends after it begins, and so does every job's span, wherever it ran. Dump() writes one event
+// per line, each thread's slices in order, then the spans in time order.
+static void ExpectBalanced(const std::string& trace) {
+
+	std::map<std::string, int> openSlices, openSpans;
+	std::istringstream lines(trace);
+	std::string event;
+	while (std::getline(lines, event)) {
+		std::string phase = FieldOf(event, "ph");
+		if (phase == "B" || phase == "E") {
+			int& iOpen = openSlices[FieldOf(event, "tid")];
+			iOpen += phase == "B" ? 1 : -1;
+			EXPECT_GE(iOpen, 0) << event;
+		}
+		else if (phase == "b" || phase == "e") {
+			int& iOpen = openSpans[FieldOf(event, "id")];
+			iOpen += phase == "b" ? 1 : -1;
+			EXPECT_GE(iOpen, 0) << event;
+			EXPECT_LE(iOpen, 1) << event;
+		}
+	}
+
+	for (auto& slices : openSlices)
+		EXPECT_EQ(slices.second, 0) << "tid " << slices.first;
+	for (auto& spans : openSpans)
+		EXPECT_EQ(spans.second, 0) << "id " << spans.first;
+}
+
+static std::string ReadAndRemove(const char* szPath) {
+	std::ifstream file(szPath);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	file.close();
+	remove(szPath);
+	return contents.str();
+}
+
+TEST(Trace, BufferKeepsNewestEvents) {
+
+	std::unique_ptr<TraceBuffer> pBuffer(new TraceBuffer(0));
+	std::unique_ptr<TraceBuffer::Record[]> pRecords(new TraceBuffer::Record[TraceBuffer::Capacity]);
+
+	for (uint64_t i = 0; i < 10; i++)
+		pBuffer->Push(TraceEvent::Steal, i);
+
+	ASSERT_EQ(pBuffer->Read(pRecords.get()), 10u);
+	EXPECT_EQ(pRecords[0].iArg, 0u);
+	EXPECT_EQ(pRecords[9].iArg, 9u);
+	EXPECT_EQ(pRecords[9].eEvent, TraceEvent::Steal);
+	EXPECT_LE(pRecords[0].iTicks, pRecords[9].iTicks);
+
+	// Once it wraps, the oldest slot could be mid-overwrite as far as a reader knows, so it's dropped too
+	for (uint64_t i = 10; i < TraceBuffer::Capacity + 10; i++)
+		pBuffer->Push(TraceEvent::JobRun, i);
+
+	uint64_t iCount = pBuffer->Read(pRecords.get());
+	ASSERT_EQ(iCount, TraceBuffer::Capacity - 1);
+	EXPECT_EQ(pRecords[0].iArg, 11u);
+	EXPECT_EQ(pRecords[iCount - 1].iArg, TraceBuffer::Capacity + 9);
+
+	pBuffer->Clear();
+	EXPECT_EQ(pBuffer->Read(pRecords.get()), 0u);
+}
+
+TEST(Trace, DumpDropsLostBeginsAndClosesOpenEvents) {
+
+	const char* szPath = "hustle_trace_balance_test.json";
+
+	// What a wrapped buffer starts with: the ends of a job and a wait whose begins were overwritten
+	Trace::Record(TraceEvent::JobStop, 0x1000 | 1);
+	Trace::Record(TraceEvent::WaitEnd, 0x2000);
+
+	// And what it ends with while they're still going
+	Trace::Record(TraceEvent::JobRun, 0x3000 | 1);
+	Trace::Record(TraceEvent::WaitStart, 0x4000);
+
+	ASSERT_TRUE(Trace::Dump(szPath));
+	std::string trace = ReadAndRemove(szPath);
+
+	ExpectBalanced(trace);
+	EXPECT_EQ(trace.find("\"job\":\"0x1000\""), std::string::npos);
+	EXPECT_EQ(trace.find("\"id\":\"0x1000\""), std::string::npos);
+	EXPECT_EQ(CountOf(trace, "\"id\":\"0x3000\""), 2u);
+}
+
+#if defined(HUSTLE_TRACING)
+
+TEST(Trace, DumpWritesChromeJson) {
+
+	const int JobCount = 100;
+	const char* szPath = "hustle_trace_test.json";
+
+	auto& dispatcher = Dispatcher::GetInstance();
+
+	JobCounter counter;
+	for (int i = 0; i < JobCount; i++) {
+		counter.Increment();
+		dispatcher.AddJob([]() { Dispatcher::GetInstance().YieldToScheduler(); }, JobPriority::Normal, &counter);
+	}
+	dispatcher.WaitForCounter(&counter);
+
+	ASSERT_TRUE(dispatcher.DumpTrace(szPath));
+
+	std::string trace = ReadAndRemove(szPath);
+
+	EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+	EXPECT_NE(trace.find("\"Worker 0\""), std::string::npos);
+	EXPECT_NE(trace.find("\"Worker 1\""), std::string::npos);
+
+	// Every job began a span, and everything that began ended
+	EXPECT_GE(CountOf(trace, "\"ph\":\"b\""), (size_t)JobCount);
+	ExpectBalanced(trace);
+
+	// This thread waited on the counter
+	EXPECT_GE(CountOf(trace, "\"name\":\"wait\",\"ph\":\"B\""), 1u);
+}
+
+#else
+
+TEST(Trace, DumpFailsWhenCompiledOut) {
+	EXPECT_FALSE(Dispatcher::GetInstance().DumpTrace("hustle_trace_test.json"));
+}
+
+#endif
@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+#include "hustle/WorkStealingQueue.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Hustle;
+
+const int MaxDequeSize = 100;
+
+TEST(WorkStealingQueue, OwnerIsLifo) {
+	WorkStealingQueue<int*> intQueue;
+
+	int intData[MaxDequeSize];
+	for (auto i = 0; i < MaxDequeSize; i++) {
+		intData[i] = i;
+		intQueue.Push(&intData[i]);
+	}
+
+	EXPECT_EQ(intQueue.Size(), MaxDequeSize);
+
+	for (auto i = MaxDequeSize - 1; i >= 0; i--) {
+		int* pInt = intQueue.Pop();
+		ASSERT_NE(pInt, nullptr);
+		EXPECT_EQ(*pInt, i);
+	}
+
+	EXPECT_EQ(intQueue.Pop(), nullptr);
+	EXPECT_EQ(intQueue.Size(), 0);
+}
+
+TEST(WorkStealingQueue, ThiefIsFifo) {
+	WorkStealingQueue<int*> intQueue;
+
+	int intData[MaxDequeSize];
+	for (auto i = 0; i < MaxDequeSize; i++) {
+		intData[i] = i;
+		intQueue.Push(&intData[i]);
+	}
+
+	for (auto i = 0; i < MaxDequeSize / 2; i++) {
+		int* pInt = intQueue.Steal();
+		ASSERT_NE(pInt, nullptr);
+		EXPECT_EQ(*pInt, i);
+	}
+
+	EXPECT_EQ(intQueue.Size(), MaxDequeSize / 2);
+}
+
+TEST(WorkStealingQueue, GrowPastCapacity) {
+
+	// Start tiny so Push() has to grow the buffer a few times
+	WorkStealingQueue<int*> intQueue(4);
+
+	int intData[MaxDequeSize];
+	for (auto i = 0; i < MaxDequeSize; i++) {
+		intData[i] = i;
+		intQueue.Push(&intData[i]);
+	}
+
+	EXPECT_EQ(*intQueue.Steal(), 0);
+	EXPECT_EQ(*intQueue.Pop(), MaxDequeSize - 1);
+	EXPECT_EQ(intQueue.Size(), MaxDequeSize - 2);
+}
+
+TEST(WorkStealingQueue, PushBulk) {
+
+	// Small enough that a single PushBulk() has to grow it more than once
+	WorkStealingQueue<int*> intQueue(4);
+
+	int intData[MaxDequeSize];
+	int* pItems[MaxDequeSize];
+	for (auto i = 0; i < MaxDequeSize; i++) {
+		intData[i] = i;
+		pItems[i] = &intData[i];
+	}
+
+	intQueue.Push(pItems[0]);
+	intQueue.PushBulk(pItems + 1, MaxDequeSize - 1);
+	EXPECT_EQ(intQueue.Size(), MaxDequeSize);
+
+	// Same order as pushing them one at a time
+	EXPECT_EQ(*intQueue.Steal(), 0);
+	EXPECT_EQ(*intQueue.Steal(), 1);
+	for (auto i = MaxDequeSize - 1; i >= 2; i--)
+		EXPECT_EQ(*intQueue.Pop(), i);
+
+	EXPECT_EQ(intQueue.Pop(), nullptr);
+}
+
+TEST(WorkStealingQueue, EmptyQueue) {
+	WorkStealingQueue<int*> intQueue;
+	EXPECT_EQ(intQueue.Pop(), nullptr);
+	EXPECT_EQ(intQueue.Steal(), nullptr);
+	EXPECT_EQ(intQueue.Size(), 0);
+}
+
+TEST(WorkStealingQueue, ConcurrentSteal) {
+
+	const int ItemCount = 100000;
+	const int ThiefCount = 3;
+
+	WorkStealingQueue<int*> intQueue(16);
+	std::vector<int> intData(ItemCount);
+	std::vector<std::atomic<int>> takenCount(ItemCount);
+	for (auto& taken : takenCount)
+		taken = 0;
+
+	std::atomic<bool> bOwnerDone = { false };
+	std::vector<std::thread> thieves;
+
+	for (int t = 0; t < ThiefCount; t++) {
+		thieves.emplace_back([&]() {
+			while (true) {
+				int* pInt = intQueue.Steal();
+				if (pInt)
+					takenCount[pInt - intData.data()]++;
+				else if (bOwnerDone && intQueue.Size() == 0)
+					break;
+			}
+		});
+	}
+
+	// Owner interleaves pushes and pops while the thieves work the other end
+	for (int i = 0; i < ItemCount; i++) {
+		intQueue.Push(&intData[i]);
+		if (i % 3 == 0) {
+			int* pInt = intQueue.Pop();
+			if (pInt)
+				takenCount[pInt - intData.data()]++;
+		}
+	}
+
+	while (int* pInt = intQueue.Pop())
+		takenCount[pInt - intData.data()]++;
+
+	bOwnerDone = true;
+	for (auto& thief : thieves)
+		thief.join();
+
+	// Every item must have been taken exactly once
+	for (int i = 0; i < ItemCount; i++)
+		ASSERT_EQ(takenCount[i], 1);
+}